@@ -0,0 +1,451 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*
+ * Benchmarks each stage of the event log path & log_event() end to end,
+ * reporting throughput & p50/p99 latency:
+ *
+ *   load_yaml      event_log_init() catalog load, parsing the yaml file
+ *                  & publishing the catalog in shared memory
+ *   load_shm       catalog load, mapping the shared memory catalog
+ *   load_compiled  catalog load, mapping the compiled catalog file
+ *   event_search   event name lookup
+ *   key_value      key_value_string() of one EV_KV()
+ *   render         description template rendering
+ *   log_event      log_event() end to end
+ *
+ * Stages are swept over the number of events in the catalog, the number
+ * of keys of the event logged & the length of its description template.
+ * The catalogs come from yaml files generated under a scratch
+ * OPENSWITCH_INSTALL_PATH.
+ *
+ * sd_journal_sendv() is the stub sink of the eventlog tests, so the
+ * numbers do not depend on journald.
+ *
+ * Usage: eventlog_bench [iterations]
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "eventlog.h"
+#include "event_catalog.h"
+#include "eventlog_test_util.h"
+
+#define BENCH_ITERATIONS 100000
+#define BENCH_SAMPLES 10000
+#define BENCH_LOADS 20
+
+extern int event_search(char *fmt);
+
+static const int table_sizes[] = { 16, 256, 4096 };
+static const int key_counts[] = { 0, 1, 4, 8 };
+static const int template_lengths[] = { 32, 128, 512 };
+
+#define N_ELEMS(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+static unsigned long journal_sends = 0;
+static unsigned long journal_bytes = 0;
+
+/* Counts the messages & bytes sent to the stub journal */
+static int
+count_hook(const struct iovec *iov, int n)
+{
+    int i = 0;
+    for(i = 0; i < n; i++)
+    {
+        journal_bytes += iov[i].iov_len;
+    }
+    journal_sends++;
+    return 0;
+}
+
+/* What a benchmarked operation gets to work on */
+struct bench_ctx {
+    const struct event_catalog *catalog;
+    char **names;                   /* Event names to look up */
+    int n_names;
+    int index;                      /* Event rendered or logged */
+    int n_keys;
+    char *kv[MAX_EVENT_KEYS];
+    char kv_buf[MAX_EVENT_KEYS][32];
+    char name[64];
+};
+
+typedef void bench_fn(struct bench_ctx *ctx, int i);
+
+static unsigned long long
+now_nsec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int
+compare_ull(const void *a, const void *b)
+{
+    unsigned long long x = *(const unsigned long long*)a;
+    unsigned long long y = *(const unsigned long long*)b;
+    return (x > y) - (x < y);
+}
+
+/* run_bench
+ * Runs fn iterations times back to back for the throughput, then times
+ * samples calls one by one for the latency percentiles. The cost of
+ * reading the clock is taken off each sample.
+ */
+static void
+run_bench(const char *stage, int table, int keys, int len,
+          bench_fn *fn, struct bench_ctx *ctx, int iterations, int samples)
+{
+    static unsigned long long overhead = 0;
+    unsigned long long *lat = NULL;
+    unsigned long long start = 0, elapsed = 0;
+    char keys_str[16] = "-", len_str[16] = "-";
+    int i = 0;
+
+    lat = (unsigned long long*)calloc(samples, sizeof(*lat));
+    if(lat == NULL) {
+        return;
+    }
+    if(overhead == 0) {
+        for(i = 0; i < samples; i++)
+        {
+            start = now_nsec();
+            lat[i] = now_nsec() - start;
+        }
+        qsort(lat, samples, sizeof(*lat), compare_ull);
+        overhead = lat[samples / 2];
+    }
+
+    /* Warm up */
+    for(i = 0; i < 100; i++)
+    {
+        fn(ctx, i);
+    }
+    start = now_nsec();
+    for(i = 0; i < iterations; i++)
+    {
+        fn(ctx, i);
+    }
+    elapsed = now_nsec() - start;
+    for(i = 0; i < samples; i++)
+    {
+        start = now_nsec();
+        fn(ctx, i);
+        lat[i] = now_nsec() - start;
+        lat[i] = (lat[i] > overhead) ? lat[i] - overhead : 0;
+    }
+    qsort(lat, samples, sizeof(*lat), compare_ull);
+
+    if(keys >= 0) {
+        snprintf(keys_str, sizeof(keys_str), "%d", keys);
+    }
+    if(len >= 0) {
+        snprintf(len_str, sizeof(len_str), "%d", len);
+    }
+    printf("%-14s %6d %5s %5s %14.0f %10llu %10llu\n", stage, table,
+           keys_str, len_str,
+           elapsed ? iterations * 1e9 / elapsed : 0.0,
+           lat[samples / 2], lat[(samples * 99) / 100]);
+    free(lat);
+}
+
+/* Name of the event logged with n_keys keys & a len byte template */
+static void
+probe_name(char *buf, size_t size, int n_keys, int len)
+{
+    snprintf(buf, size, "BENCH_K%d_L%d", n_keys, len);
+}
+
+/* write_yaml
+ * Writes a yaml file of n_events events in category BENCH: one probe
+ * event per key count & template length, filler events for the rest.
+ */
+static int
+write_yaml(const char *path, int n_events)
+{
+    char name[64];
+    char description[1024];
+    FILE *fp = fopen(path, "w");
+    int i = 0, k = 0, l = 0, n = 0, off = 0, id = 100000;
+    if(fp == NULL) {
+        return -1;
+    }
+    fprintf(fp, "---\nevent_definitions:\n");
+    for(k = 0; k < N_ELEMS(key_counts); k++)
+    {
+        for(l = 0; l < N_ELEMS(template_lengths); l++)
+        {
+            probe_name(name, sizeof(name), key_counts[k],
+                       template_lengths[l]);
+            fprintf(fp, "  - event_name: %s\n"
+                        "    event_category: BENCH\n"
+                        "    event_ID: %d\n"
+                        "    severity: LOG_INFO\n", name, id++);
+            off = snprintf(description, sizeof(description), "Bench");
+            if(key_counts[k]) {
+                fprintf(fp, "    keys: ");
+            }
+            for(i = 0; i < key_counts[k]; i++)
+            {
+                fprintf(fp, "%sk%d", i ? ", " : "", i);
+                off += snprintf(description + off, sizeof(description) - off,
+                                " {k%d}", i);
+            }
+            if(key_counts[k]) {
+                fprintf(fp, "\n");
+            }
+            while(off < template_lengths[l])
+            {
+                description[off++] = 'x';
+            }
+            description[off] = '\0';
+            fprintf(fp, "    event_description_template: '%s'\n",
+                    description);
+            n++;
+        }
+    }
+    for(; n < n_events; n++)
+    {
+        fprintf(fp, "  - event_name: BENCH_EVENT_%d\n"
+                    "    event_category: BENCH\n"
+                    "    event_ID: %d\n"
+                    "    severity: LOG_INFO\n"
+                    "    keys: value\n"
+                    "    event_description_template: "
+                    "'Bench filler event {value}'\n", n, id++);
+    }
+    return fclose(fp);
+}
+
+/* Writes the image of catalog as the compiled catalog file */
+static int
+write_compiled(const char *path, const struct event_catalog *catalog)
+{
+    FILE *fp = fopen(path, "w");
+    if(fp == NULL) {
+        return -1;
+    }
+    if(fwrite(catalog->hdr, catalog->hdr->size, 1, fp) != 1) {
+        fclose(fp);
+        return -1;
+    }
+    return fclose(fp);
+}
+
+static const char *shm_segment;
+
+static void
+bench_load_yaml(struct bench_ctx *ctx, int i)
+{
+    struct event_catalog *cat = NULL;
+    shm_unlink(shm_segment);
+    cat = event_catalog_reload();
+    if(cat) {
+        event_catalog_free(cat);
+    }
+}
+
+static void
+bench_load_mapped(struct bench_ctx *ctx, int i)
+{
+    struct event_catalog *cat = event_catalog_reload();
+    if(cat) {
+        event_catalog_free(cat);
+    }
+}
+
+static void
+bench_search(struct bench_ctx *ctx, int i)
+{
+    event_search(ctx->names[(i * 7919) % ctx->n_names]);
+}
+
+static void
+bench_key_value(struct bench_ctx *ctx, int i)
+{
+    key_value_string("value", "%d", i);
+}
+
+static void
+bench_render(struct bench_ctx *ctx, int i)
+{
+    char buf[MAX_LOG_STR];
+    event_catalog_render(ctx->catalog, ctx->index, ctx->kv, ctx->n_keys,
+                         buf, sizeof(buf));
+}
+
+static void
+bench_log_event(struct bench_ctx *ctx, int i)
+{
+    switch(ctx->n_keys) {
+    case 0:
+        log_event(ctx->name, NULL);
+        break;
+    case 1:
+        log_event(ctx->name, EV_KV("k0", "%d", i));
+        break;
+    case 4:
+        log_event(ctx->name, EV_KV("k0", "%d", i), EV_KV("k1", "%s", "eth0"),
+                  EV_KV("k2", "%d", 100), EV_KV("k3", "%s", "up"));
+        break;
+    case 8:
+        log_event(ctx->name, EV_KV("k0", "%d", i), EV_KV("k1", "%s", "eth0"),
+                  EV_KV("k2", "%d", 100), EV_KV("k3", "%s", "up"),
+                  EV_KV("k4", "%d", i), EV_KV("k5", "%s", "eth1"),
+                  EV_KV("k6", "%d", 200), EV_KV("k7", "%s", "down"));
+        break;
+    }
+}
+
+/* bench_table
+ * Runs every stage against a catalog of n_events events.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+static int
+bench_table(const char *root, int n_events, int iterations)
+{
+    static int initialized = FALSE;
+    struct bench_ctx ctx;
+    struct event_catalog *cat = NULL;
+    char yaml[512], compiled[512], segment[EVENT_CATALOG_SHM_NAME_SIZE];
+    const char *values[] = { "1234", "eth0", "100", "up",
+                             "5678", "eth1", "200", "down" };
+    int i = 0, k = 0, l = 0, loads = BENCH_LOADS, ret = -1;
+
+    memset(&ctx, 0, sizeof(ctx));
+    test_yaml_path(root, yaml, sizeof(yaml));
+    snprintf(compiled, sizeof(compiled), "%s%s", root, EVENT_CATALOG_FILE);
+    if((write_yaml(yaml, n_events) < 0) ||
+       (event_catalog_shm_name(yaml, segment, sizeof(segment)) < 0)) {
+        return -1;
+    }
+    shm_segment = segment;
+
+    run_bench("load_yaml", n_events, -1, -1, bench_load_yaml, &ctx,
+              loads, loads);
+    run_bench("load_shm", n_events, -1, -1, bench_load_mapped, &ctx,
+              loads, loads);
+    cat = event_catalog_reload();
+    if((cat == NULL) || (write_compiled(compiled, cat) < 0)) {
+        goto done;
+    }
+    run_bench("load_compiled", n_events, -1, -1, bench_load_mapped, &ctx,
+              loads, loads);
+    unlink(compiled);
+
+    /* Switch the live catalog to this table */
+    if(!initialized) {
+        if(event_log_init("BENCH") != 1) {
+            goto done;
+        }
+        initialized = TRUE;
+    }
+    else if(event_log_reload() < 0) {
+        goto done;
+    }
+
+    ctx.catalog = cat;
+    ctx.n_names = cat->hdr->n_events;
+    ctx.names = (char**)calloc(ctx.n_names, sizeof(char*));
+    if(ctx.names == NULL) {
+        goto done;
+    }
+    for(i = 0; i < ctx.n_names; i++)
+    {
+        ctx.names[i] = (char*)event_catalog_str(cat, cat->events[i].name);
+    }
+    run_bench("event_search", n_events, -1, -1, bench_search, &ctx,
+              iterations, BENCH_SAMPLES);
+    run_bench("key_value", n_events, 1, -1, bench_key_value, &ctx,
+              iterations, BENCH_SAMPLES);
+
+    for(k = 0; k < N_ELEMS(key_counts); k++)
+    {
+        ctx.n_keys = key_counts[k];
+        for(i = 0; i < ctx.n_keys; i++)
+        {
+            snprintf(ctx.kv_buf[i], sizeof(ctx.kv_buf[i]), "k%d=%s", i,
+                     values[i]);
+            ctx.kv[i] = ctx.kv_buf[i];
+        }
+        for(l = 0; l < N_ELEMS(template_lengths); l++)
+        {
+            probe_name(ctx.name, sizeof(ctx.name), ctx.n_keys,
+                       template_lengths[l]);
+            ctx.index = event_catalog_find(cat, ctx.name);
+            if(ctx.index < 0) {
+                goto done;
+            }
+            run_bench("render", n_events, ctx.n_keys, template_lengths[l],
+                      bench_render, &ctx, iterations, BENCH_SAMPLES);
+            run_bench("log_event", n_events, ctx.n_keys, template_lengths[l],
+                      bench_log_event, &ctx, iterations, BENCH_SAMPLES);
+        }
+    }
+    ret = 0;
+
+done:
+    unlink(compiled);
+    free(ctx.names);
+    /* The library may still use what is mapped, keep cat around */
+    shm_unlink(segment);
+    return ret;
+}
+
+int
+main(int argc, char *argv[])
+{
+    char root[64];
+    int iterations = BENCH_ITERATIONS;
+    int i = 0, ret = 0;
+
+    if(argc > 1) {
+        iterations = atoi(argv[1]);
+    }
+    if((argc > 2) || (iterations <= 0)) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 2;
+    }
+    if(test_setup_install_path(NULL, root, sizeof(root)) < 0) {
+        perror("setup");
+        return 2;
+    }
+    test_journal_hook = count_hook;
+    printf("%-14s %6s %5s %5s %14s %10s %10s\n", "stage", "events", "keys",
+           "len", "ops/s", "p50 ns", "p99 ns");
+    for(i = 0; i < N_ELEMS(table_sizes); i++)
+    {
+        if(bench_table(root, table_sizes[i], iterations) < 0) {
+            fprintf(stderr, "FAIL: benchmark of %d events\n", table_sizes[i]);
+            ret = 1;
+            break;
+        }
+    }
+    test_cleanup_install_path(root);
+    printf("%lu messages, %lu bytes sent to the stub journal\n",
+           journal_sends, journal_bytes);
+    return ret;
+}
@@ -0,0 +1,153 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/************************************************************************//**
+ * @ingroup ops_supportability
+ *
+ * @file
+ * Header for the event catalog used by the event log infra.
+ *
+ * The catalog holds every event defined in ops_events.yaml in one
+ * position independent image: a header followed by the event records,
+ * the category records, the event name hash buckets, the description
+ * template segments and the string arena, each section 8 byte aligned.
+ * All offsets are in bytes, string offsets are relative to the start of
+ * the string arena and 0 is the empty string.
+ *
+ * The image is either compiled at build time by ops_eventcatalog.py and
+ * mapped read-only, or built from the yaml file when the compiled catalog
+ * is missing or stale. The first process to build it publishes it in a
+ * POSIX shared memory segment which other daemons & ops_eventlog.py map
+ * instead of parsing the yaml file again. Bump EVENT_CATALOG_VERSION
+ * along with CATALOG_VERSION in ops_eventcatalog.py for any layout
+ * change.
+ ***************************************************************************/
+
+#ifndef __EVENT_CATALOG_H_
+#define __EVENT_CATALOG_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define EVENT_CATALOG_MAGIC "OPSEVCAT"
+#define EVENT_CATALOG_MAGIC_SIZE 8
+#define EVENT_CATALOG_VERSION 6
+#define EVENT_CATALOG_FILE "/etc/openswitch/supportability/ops_events.bin"
+#define EVENT_CATEGORY_FIELD "OPS_EVENT_CATEGORY="
+/* Shared memory segment a catalog built from the yaml file is published
+ * in, named after the catalog version & the yaml file hash */
+#define EVENT_CATALOG_SHM_NAME "/ops_events.v%d.%016llx"
+#define EVENT_CATALOG_SHM_NAME_SIZE 64
+/* Seconds an empty segment may wait for its publisher to lock it */
+#define EVENT_CATALOG_SHM_GRACE 2
+
+struct event_catalog_header {
+    char magic[EVENT_CATALOG_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t size;              /* Size of the whole image */
+    uint64_t yaml_hash;         /* FNV-1a of the yaml file it came from */
+    uint32_t n_events;
+    uint32_t n_categories;
+    uint32_t n_buckets;         /* Power of 2 */
+    uint32_t events_off;
+    uint32_t categories_off;
+    uint32_t buckets_off;       /* (event index + 1), 0 if empty */
+    uint32_t segments_off;
+    uint32_t n_segments;
+    uint32_t strings_off;
+    uint32_t strings_size;
+};
+
+/* Events are grouped by category, in the order they appear in yaml */
+struct event_catalog_event {
+    uint32_t name;
+    uint32_t severity;
+    uint32_t description;
+    int32_t event_id;
+    int32_t num_of_keys;
+    uint32_t category;          /* Index of the category record */
+    uint32_t first_segment;     /* Description template segments */
+    uint32_t n_segments;
+    int32_t priority;           /* Severity level, -1 if unknown */
+    /* Journal fields pre-rendered at build time, log_event() points
+     * its iovec straight at them */
+    uint32_t message_prefix;    /* "MESSAGE=ops-evt|<id>|<severity>|" */
+    uint32_t priority_field;    /* "PRIORITY=<level>" */
+    uint32_t id_field;          /* "OPS_EVENT_ID=<id>" */
+    uint32_t rate_limit;        /* Events per second, 0 if unlimited */
+    uint32_t rate_burst;        /* Events let through at once */
+    uint32_t coalesce_window;   /* Seconds duplicates are coalesced over,
+                                 * 0 if they are not */
+    uint32_t sample_rate;       /* Logged 1 in sample_rate times */
+};
+
+/* Description templates are split when the catalog is built in to
+ * literal text and {key} placeholders, both pointing in to the template
+ * string. For a placeholder off & len cover the key name without the
+ * braces. */
+enum {
+    EVENT_SEGMENT_LITERAL,
+    EVENT_SEGMENT_KEY
+};
+
+struct event_catalog_segment {
+    uint32_t kind;
+    uint32_t off;
+    uint32_t len;
+};
+
+struct event_catalog_category {
+    uint32_t name;
+    uint32_t first;             /* Index of its first event */
+    uint32_t n_events;
+    uint32_t field;             /* "OPS_EVENT_CATEGORY=<name>" */
+};
+
+struct event_catalog {
+    const struct event_catalog_header *hdr;
+    const struct event_catalog_event *events;
+    const struct event_catalog_category *categories;
+    const uint32_t *buckets;
+    const struct event_catalog_segment *segments;
+    const char *strings;
+    int mapped;                 /* Image is mmap'ed from the catalog file */
+};
+
+extern const struct event_catalog *event_catalog_load(void);
+extern struct event_catalog *event_catalog_reload(void);
+extern void event_catalog_free(struct event_catalog *catalog);
+extern void event_catalog_unpublish(const struct event_catalog *catalog);
+extern int event_catalog_shm_name(const char *yaml_path, char *name,
+                                  size_t size);
+extern int event_catalog_find(const struct event_catalog *catalog,
+                              const char *name);
+extern int event_catalog_find_category(const struct event_catalog *catalog,
+                                       const char *name);
+extern uint32_t event_name_hash(const char *name);
+extern int severity_level(char *arg);
+extern int event_catalog_render(const struct event_catalog *catalog,
+                                int index, char **kv, int n_kv,
+                                char *buf, size_t size);
+
+/* Returns the string at offset off of the catalog string arena */
+static inline const char *
+event_catalog_str(const struct event_catalog *catalog, uint32_t off)
+{
+    return catalog->strings + off;
+}
+
+#endif /* __EVENT_CATALOG_H_ */
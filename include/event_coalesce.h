@@ -0,0 +1,81 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/************************************************************************//**
+ * @ingroup ops_supportability
+ *
+ * @file
+ * Header for the duplicate coalescing of the event log infra.
+ *
+ * An event with a coalesce_window in ops_events.yaml opens a window of
+ * that many seconds when logged, keyed by a hash of its ID & key values.
+ * Exact repeats of it within the window are only counted. Once the
+ * window has closed the count is reported by a single
+ * EVENT_REPEATED_EVENT, & the next repeat is logged & opens a new
+ * window.
+ ***************************************************************************/
+
+#ifndef __EVENT_COALESCE_H_
+#define __EVENT_COALESCE_H_
+
+#include <stdint.h>
+#include <pthread.h>
+#include "event_catalog.h"
+
+#define EVENT_REPEATED_EVENT "SUPPORTABILITY_EVENT_REPEATED"
+#define EVENT_COALESCE_SLOTS 256            /* Power of 2 */
+/* Slots an event & key values hash may use, from its home slot on */
+#define EVENT_COALESCE_PROBES 8
+/* Repeat counts reported at most per call of event_coalesce_report_due */
+#define EVENT_COALESCE_REPORTS 8
+
+struct event_coalesce_slot {
+    uint64_t hash;              /* Of the event ID & key values */
+    uint64_t window_start;      /* Monotonic ns */
+    uint64_t window_end;        /* Monotonic ns, 0 if the slot is free */
+    int index;                  /* Catalog event */
+    unsigned long repeats;      /* Counted, not logged, in the window */
+};
+
+/* Windows of the events in the catalog, protected by mutex except
+ * next_due which log_event() peeks at to skip the lock */
+struct event_coalesce {
+    pthread_mutex_t mutex;
+    struct event_coalesce_slot *slots;
+    uint64_t next_due;          /* First window with repeats to close */
+};
+
+struct event_coalesce_report {
+    int index;
+    unsigned long repeats;
+    unsigned int seconds;       /* Span of the window */
+};
+
+extern int event_coalesce_init(struct event_coalesce *co);
+extern int event_coalesce_check(struct event_coalesce *co,
+                                const struct event_catalog *catalog,
+                                int index, char **kv, int n_kv,
+                                struct event_coalesce_report *report);
+extern int event_coalesce_report_due(struct event_coalesce *co,
+                                     struct event_coalesce_report *reports,
+                                     int max);
+extern void event_coalesce_carry(struct event_coalesce *co,
+                                 const struct event_catalog *catalog,
+                                 struct event_coalesce *old,
+                                 const struct event_catalog *old_catalog);
+
+#endif /* __EVENT_COALESCE_H_ */
@@ -0,0 +1,63 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/************************************************************************//**
+ * @ingroup ops_supportability
+ *
+ * @file
+ * Header for the per event rate limit of the event log infra.
+ *
+ * Every event with a rate_limit in ops_events.yaml gets a token bucket,
+ * kept as the theoretical arrival time of the generic cell rate
+ * algorithm so that one compare & swap updates it. Events over the
+ * limit are suppressed and counted, the count is reported by a single
+ * summary event once EVENT_SUPPRESSED_REPORT_INTERVAL has passed since
+ * the first of them.
+ ***************************************************************************/
+
+#ifndef __EVENT_RATELIMIT_H_
+#define __EVENT_RATELIMIT_H_
+
+#include <stdint.h>
+#include "event_catalog.h"
+
+#define EVENT_SUPPRESSED_EVENT "SUPPORTABILITY_EVENTS_SUPPRESSED"
+#define EVENT_SUPPRESSED_REPORT_INTERVAL 10     /* Seconds */
+
+struct event_rate_state {
+    uint64_t tat;               /* Theoretical arrival time, ns */
+    unsigned long suppressed;   /* Over the life time of the process */
+};
+
+struct event_ratelimit {
+    struct event_rate_state *events;    /* One per catalog event */
+    unsigned long pending;              /* Suppressed, not reported yet */
+    uint64_t first_pending;             /* When the first of them was */
+};
+
+extern int event_ratelimit_init(struct event_ratelimit *rl,
+                                const struct event_catalog *catalog);
+extern int event_ratelimit_throttled(struct event_ratelimit *rl,
+                                     const struct event_catalog *catalog,
+                                     int index);
+extern int event_ratelimit_check(struct event_ratelimit *rl,
+                                 const struct event_catalog *catalog,
+                                 int index);
+extern unsigned long event_ratelimit_report_due(struct event_ratelimit *rl,
+                                                unsigned int *seconds);
+
+#endif /* __EVENT_RATELIMIT_H_ */
@@ -0,0 +1,75 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/************************************************************************//**
+ * @ingroup ops_supportability
+ *
+ * @file
+ * Header for the event flight recorder of the event log infra.
+ *
+ * Every event a daemon logs is also stored, unrendered, in a ring of the
+ * last EVENT_RECORDER_RECORDS binary records: the event ID, when it was
+ * logged & its "key=value" strings. The ring is the ops_event_recorder
+ * global of the library, a header followed by the records, so that it
+ * can be found in a core file either by symbol or by scanning for
+ * EVENT_RECORDER_MAGIC, & read by ops_eventrecorder.py. Bump
+ * EVENT_RECORDER_VERSION along with RECORDER_VERSION there for any
+ * layout change.
+ ***************************************************************************/
+
+#ifndef __EVENT_RECORDER_H_
+#define __EVENT_RECORDER_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include "event_catalog.h"
+
+#define EVENT_RECORDER_MAGIC "OPSEVREC"
+#define EVENT_RECORDER_MAGIC_SIZE 8
+#define EVENT_RECORDER_VERSION 1
+#define EVENT_RECORDER_RECORDS 512          /* Power of 2 */
+#define EVENT_RECORDER_DATA_SIZE 104
+#define EVENT_RECORDER_BUSY UINT64_MAX      /* seq while being written */
+
+struct event_recorder_record {
+    uint64_t seq;               /* Sequence number + 1, 0 if never used */
+    uint64_t timestamp;         /* Microseconds since the epoch */
+    int32_t event_id;
+    uint16_t n_keys;
+    uint16_t size;              /* Bytes of data used */
+    /* "key=value" strings back to back, NUL terminated, the last one
+     * truncated if they don't all fit */
+    char data[EVENT_RECORDER_DATA_SIZE];
+};
+
+struct event_recorder {
+    char magic[EVENT_RECORDER_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t n_records;
+    uint32_t pid;
+    uint64_t next;              /* Sequence number of the next record */
+    struct event_recorder_record records[EVENT_RECORDER_RECORDS];
+};
+
+extern struct event_recorder ops_event_recorder;
+
+extern void event_recorder_init(void);
+extern void event_recorder_add(int event_id, char **kv, int n_kv);
+extern void event_recorder_dump(FILE *fp, const struct event_catalog *catalog);
+
+#endif /* __EVENT_RECORDER_H_ */
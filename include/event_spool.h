@@ -0,0 +1,89 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/************************************************************************//**
+ * @ingroup ops_supportability
+ *
+ * @file
+ * Header for the local spool of the event log infra.
+ *
+ * Events journal refuses, or which don't fit in the async ring, are
+ * appended as binary records to a memory mapped spool file of the
+ * daemon under EVENT_SPOOL_DIR. While the spool holds events every new
+ * one is appended behind them, & the spool is replayed in to journal
+ * before events are sent directly again, or by event_log_run() when
+ * no event is sent. Journal is retried after
+ * EVENT_SPOOL_RETRY_MIN, backing off up to EVENT_SPOOL_RETRY_MAX while
+ * it keeps refusing events. The spool is a ring of EVENT_SPOOL_SIZE
+ * bytes, events which don't fit are counted as dropped. It is kept
+ * across restarts of the daemon & replayed once journal takes events
+ * again. Daemons of the same name share the spool file, taking turns
+ * through record locks on it. Only events journal refused with a
+ * transient error are spooled, see event_spool_transient(), a spooled
+ * event journal refuses otherwise on replay is dropped.
+ ***************************************************************************/
+
+#ifndef __EVENT_SPOOL_H_
+#define __EVENT_SPOOL_H_
+
+#include <stdint.h>
+#include <sys/uio.h>
+#include "eventlog.h"
+
+#define EVENT_SPOOL_DIR "/var/diagnostics/logs"
+#define EVENT_SPOOL_SUFFIX ".evspool"
+#define EVENT_SPOOL_MAGIC "OPSEVSPL"
+#define EVENT_SPOOL_MAGIC_SIZE 8
+#define EVENT_SPOOL_VERSION 1
+#define EVENT_SPOOL_SIZE (1024*1024)        /* Multiple of 8 */
+#define EVENT_SPOOL_RETRY_MIN 1             /* Milliseconds */
+#define EVENT_SPOOL_RETRY_MAX 1000          /* Milliseconds */
+/* Added to replayed events, when they were logged */
+#define EVENT_SPOOL_TIME_FIELD "OPS_EVENT_TIME="
+
+/* The spool file, the header followed by the ring of records. head &
+ * tail are byte counts, records are at their offset modulo size. */
+struct event_spool_header {
+    char magic[EVENT_SPOOL_MAGIC_SIZE];
+    uint32_t version;
+    uint32_t size;              /* Bytes of the ring */
+    uint64_t head;              /* Where the next record is added */
+    uint64_t tail;              /* Next record to replay */
+    uint64_t spooled;           /* Events added since the file was made */
+    uint64_t replayed;
+    uint64_t dropped;           /* Spool full */
+    uint64_t rejected;          /* Refused for good on replay */
+};
+
+#define EVENT_SPOOL_PAD 0x1     /* Fills the end of the ring, skipped */
+
+/* One event, its journal fields stored back to back after the record */
+struct event_spool_record {
+    uint32_t size;              /* Bytes of the record, 8 byte aligned */
+    uint16_t n_fields;
+    uint16_t flags;
+    uint64_t timestamp;         /* Microseconds since the epoch */
+    uint16_t len[EVENT_JOURNAL_FIELDS];
+};
+
+extern void event_spool_init(void);
+extern int event_spool_transient(int err);
+extern int event_spool_pending(void);
+extern int event_spool_add(const struct iovec *iov, int n_iov, int refused);
+extern int event_spool_drain(int force);
+
+#endif /* __EVENT_SPOOL_H_ */
@@ -0,0 +1,43 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/************************************************************************//**
+ * @ingroup ops_supportability
+ *
+ * @file
+ * Header for the journal writer used by the event log infra.
+ *
+ * Rendered events are handed to journal either synchronously, or when
+ * the daemon enabled async mode with event_log_async_enable(), through a
+ * bounded ring of fixed size records drained by a background thread.
+ ***************************************************************************/
+
+#ifndef __EVENT_WRITER_H_
+#define __EVENT_WRITER_H_
+
+#include <sys/uio.h>
+
+/* Room for all journal fields of one event in a ring record */
+#define EVENT_RECORD_SIZE 4096
+/* Records the writer thread takes off the ring per wake up */
+#define EVENT_WRITER_BATCH 32
+/* Seconds the idle writer thread waits before calling event_log_run() */
+#define EVENT_WRITER_TICK 1
+
+extern int event_journal_send(const struct iovec *iov, int n_iov);
+
+#endif /* __EVENT_WRITER_H_ */
@@ -38,28 +38,93 @@
 #define TRUE 1
 #define FALSE 0
 #define MESSAGE_OPS_EVT "50c0fa81c2a545ec982a54293f1b1945"
+#define MESSAGE_ID_FIELD "MESSAGE_ID=" MESSAGE_OPS_EVT
 #define MAX_CATEGORIES_PER_DAEMON 99
 #define KEY_VALUE_SIZE 128
+#define MAX_EVENT_KEYS 16
+#define EVENT_FIELD_SIZE 32
+/* MESSAGE, PRIORITY, MESSAGE_ID, OPS_EVENT_ID, OPS_EVENT_CATEGORY,
+ * OPS_EVENT_SAMPLE_RATE & a field per key */
+#define EVENT_JOURNAL_FIELDS (6 + MAX_EVENT_KEYS)
+/* Sent with sampled events, each one stands for that many */
+#define EVENT_SAMPLE_RATE_FIELD "OPS_EVENT_SAMPLE_RATE="
+#define EVENT_KEY_FIELD_PREFIX "OPS_EVT_KEY_"
+#define EVENT_KEY_FIELD_SIZE (KEY_VALUE_SIZE + sizeof(EVENT_KEY_FIELD_PREFIX))
+#define MAX_JOURNAL_FIELD_NAME 64
 #define MAX_LOG_STR 480
 #define MAX_EVENT_NAME_SIZE 64
 #define MAX_SEV_NAME_SIZE 10
-#define MAX_EVENT_TABLE_SIZE 500
 #define EVENT_NAME_DELIMITER_STR "EV_TBD_TBD"
 #define EVENT_YAML_FILE "/etc/openswitch/supportability/ops_events.yaml"
 #define MAX_SEV_LEVELS 8
 #define EV_KV(...) key_value_string(__VA_ARGS__)
 
+/* Lazy form of log_event(), the EV_KV() arguments are only formatted
+ * when the event passes the severity threshold of the daemon */
+#define LOG_EVENT(ev_name, ...) \
+    do { \
+        if(event_log_enabled(ev_name)) { \
+            log_event(ev_name, __VA_ARGS__); \
+        } \
+    } while(0)
 
-typedef struct {
-    char *category;
-    int event_id;
-    char event_name[MAX_EVENT_NAME_SIZE];
-    char severity[MAX_SEV_NAME_SIZE];
-    int num_of_keys;
-    char event_description[MAX_LOG_STR];
-    } event;
+/* What happens to an event logged in async mode while the ring is full */
+enum event_log_overflow_policy {
+    EVENT_LOG_DROP_OLDEST,      /* Oldest queued event is dropped */
+    EVENT_LOG_DROP_NEW,         /* The new event is dropped */
+    EVENT_LOG_BLOCK,            /* Caller waits for room in the ring */
+    EVENT_LOG_SPOOL             /* The new event is spooled, see
+                                 * event_spool.h, dropped if the spool
+                                 * is full too */
+};
+
+struct event_log_async_stats {
+    unsigned long queued;
+    unsigned long written;
+    unsigned long failed;           /* Journal refused the event */
+    unsigned long dropped_oldest;
+    unsigned long dropped_new;
+    unsigned long pending;          /* Events in the ring right now */
+    unsigned long spooled;          /* Ring full, EVENT_LOG_SPOOL */
+};
+
+/* Counters of the spool of events journal didn't take, over the life
+ * time of the spool file */
+struct event_log_spool_stats {
+    unsigned long spooled;
+    unsigned long replayed;
+    unsigned long dropped;          /* Spool full */
+    unsigned long pending;          /* Events in the spool right now */
+    unsigned long rejected;         /* Journal refused them for good */
+};
+
+/* Counters of an event since the daemon started */
+struct event_log_stats {
+    unsigned long emitted;
+    unsigned long suppressed;       /* Over the rate limit */
+    unsigned long failed;           /* Journal refused or dropped it */
+    unsigned long long last_emitted;    /* Microseconds since the epoch,
+                                         * 0 if never emitted */
+    unsigned long coalesced;        /* Repeats within its window */
+};
 
 extern int event_log_init(char *category);
 extern int log_event(char *ev_name,...);
 extern char *key_value_string(char *s1, ...);
+extern int event_log_set_severity(int level);
+extern int event_log_get_severity(void);
+extern int event_log_enabled(char *ev_name);
+extern int log_event_index(int index, int event_id, char *ev_name, ...);
+extern int event_log_reload(void);
+extern int event_log_index_enabled(int index, int event_id);
+extern int event_log_async_enable(int capacity, int policy);
+extern void event_log_async_disable(void);
+extern void event_log_async_stats(struct event_log_async_stats *stats);
+extern int event_log_stats(char *ev_name, struct event_log_stats *stats);
+extern unsigned long event_log_unknown_events(void);
+extern void event_log_diag_dump(const char *feature, char **buf);
+extern int event_log_set_sample_rate(char *ev_name, unsigned int rate);
+extern int event_log_spool_drain(void);
+extern void event_log_run(void);
+extern void event_log_spool_stats(struct event_log_spool_stats *stats);
 #endif /* __EVENTLOG_H_ */
@@ -34,17 +34,39 @@
 #define SHOW_EVENTS_CATEGORY         "Display log events for specified event category\n"
 #define SHOW_EVENTS_FILTER_CAT       "Specify the event category to display\n"
 #define SHOW_EVENTS_REVERSE          "Display log events in reverse order (most recent first)\n"
+#define SHOW_EVENTS_KEY_CMD          " | key WORD"
+#define SHOW_EVENTS_KEY              "Display log events with the specified key value\n"
+#define SHOW_EVENTS_KEY_VALUE        "Specify the key & its value as key=value\n"
+#define SHOW_EVENTS_RANGE_CMD        " | since WORD | until WORD"
+#define SHOW_EVENTS_SINCE            "Display log events logged at or after the specified time\n"
+#define SHOW_EVENTS_UNTIL            "Display log events logged at or before the specified time\n"
+#define SHOW_EVENTS_TIME             "Specify the time as YYYY-MM-DD[:HH:MM:SS] or how long ago as "\
+                                     "<number>(s|m|h|d|w), for example 1h30m\n"
+#define SHOW_EVENTS_LAST_CMD         " | last <1-100000>"
+#define SHOW_EVENTS_LAST             "Display only the specified number of most recent log events\n"
+#define SHOW_EVENTS_LAST_COUNT       "Specify the number of log events to display\n"
+#define SHOW_EVENTS_FOLLOW_CMD       " | follow"
+#define SHOW_EVENTS_FOLLOW           "Display the most recent log events, then new ones as they are logged until ctrl c\n"
+#define EVENT_KEY_FIELD              "OPS_EVT_KEY_"
 #define MESSAGE_OPS_EVT_MATCH        "MESSAGE_ID=50c0fa81c2a545ec982a54293f1b1945"
-#define MAX_FILTER_ARGS              3
+#define MAX_FILTER_ARGS              4
 #define EVENT_ID_INDEX               0
 #define EVENT_SEVERITY_INDEX         1
 #define EVENT_CATEGORY_INDEX         3
+#define EVENT_KEY_INDEX              4
+#define EVENT_SINCE_INDEX            5
+#define EVENT_UNTIL_INDEX            6
+#define EVENT_LAST_INDEX             7
+#define EVENT_FOLLOW_INDEX           8
+#define EVENTS_FOLLOW_TAIL           10  /*events shown before following, unless last is given*/
+#define EVENTS_FOLLOW_WAIT           1000000 /*microseconds between checks for ctrl c*/
 
 #define EVENTS_YAML_FILE             "/etc/openswitch/supportability/ops_events.yaml"
 #define BUF_SIZE                     100 /*maximum buffer size*/
 #define BASE_SIZE                    20  /*maximum base time string size*/
 #define MICRO_SIZE                   7   /*maximum micro seconds size*/
 #define MIN_SIZE                     6   /*string length must be greater than or equal to MIN_SIZE(6)*/
+#define USEC_PER_SEC                 1000000ULL
 
 
 #endif //_SHOW_EVENTS_VTY_H
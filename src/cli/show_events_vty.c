@@ -33,11 +33,18 @@
 #include "time.h"
 #include "systemd/sd-journal.h"
 #include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
 #include "supportability_vty.h"
 #include "supportability_utils.h"
 
 VLOG_DEFINE_THIS_MODULE (vtysh_show_events_cli);
 
+/* Set by ctrl c while following the events */
+volatile sig_atomic_t gShowEventsUserInterrupt = FALSE;
+
 /* Function  : convert_to_datetime
  * Responsibility : to convert the real timestamp in to unix timestamp date-time
  * return : none
@@ -129,6 +136,25 @@ journal_filter(const char *arg, int index, sd_journal *journal_handle,struct ran
         strnupr((char*)arg, strlen(arg));
         snprintf(buf, BUF_SIZE, "OPS_EVENT_CATEGORY=%s", arg);
     }
+    else if(index == EVENT_KEY_INDEX) {
+        /* Every key of an event is a journal field of its own,
+         * OPS_EVT_KEY_<KEY>=value, with the key upper cased &
+         * characters other than letters & digits turned in to '_' */
+        char *value = strchr(arg, '=');
+        char *p = NULL;
+        if((value == NULL) || (value == arg)) {
+            vty_out(vty,"Key filter must be key=value%s",VTY_NEWLINE);
+            return -1;
+        }
+        snprintf(buf, BUF_SIZE, "%s%.*s%s", EVENT_KEY_FIELD,
+                 (int)(value - arg), arg, value);
+        for(p = buf + strlen(EVENT_KEY_FIELD);
+            (*p != '=') && (*p != '\0'); p++)
+        {
+            *p = isalnum((unsigned char)*p) ? toupper((unsigned char)*p)
+                                            : '_';
+        }
+    }
     else {
         VLOG_ERR("Invalid index value");
         return -1;
@@ -141,16 +167,308 @@ journal_filter(const char *arg, int index, sd_journal *journal_handle,struct ran
   return 0;
 }
 
+/* Function       : parse_event_time
+ * Resposibility  : Convert the since/until argument in to microseconds
+ *                  since the epoch. It is either a local time as
+ *                  YYYY-MM-DD, YYYY-MM-DD:HH:MM:SS (as show events prints
+ *                  it, microseconds may follow) or YYYY-MM-DDTHH:MM:SS,
+ *                  or how long ago as a sequence of <number><unit> with
+ *                  unit one of s, m, h, d & w, e.g. 1h30m.
+ * Return         : 0 on success -1 otherwise
+ */
+static int
+parse_event_time(const char *arg, uint64_t *usec)
+{
+    struct tm tm;
+    char sep = 0;
+    int n = 0, micro = 0, digits = 0;
+    uint64_t ago = 0, value = 0;
+    time_t t_t = 0;
+    const char *p = arg;
+
+    memset(&tm, 0, sizeof(tm));
+    if(sscanf(arg, "%4d-%2d-%2d%n", &tm.tm_year, &tm.tm_mon, &tm.tm_mday,
+              &n) == 3) {
+        p = arg + n;
+        if(*p != '\0') {
+            n = 0;
+            if((sscanf(p, "%c%2d:%2d:%2d%n", &sep, &tm.tm_hour, &tm.tm_min,
+                       &tm.tm_sec, &n) != 4) ||
+               ((sep != ':') && (sep != 'T'))) {
+                return -1;
+            }
+            p += n;
+            if(*p == '.') {
+                /* Microseconds, as many digits as given */
+                for(p++; isdigit((unsigned char)*p) && (digits < 6); p++)
+                {
+                    micro = (micro * 10) + (*p - '0');
+                    digits++;
+                }
+                for(; digits < 6; digits++)
+                {
+                    micro *= 10;
+                }
+            }
+            if(*p != '\0') {
+                return -1;
+            }
+        }
+        if((tm.tm_mon < 1) || (tm.tm_mon > 12) || (tm.tm_mday < 1) ||
+           (tm.tm_mday > 31) || (tm.tm_hour > 23) || (tm.tm_min > 59) ||
+           (tm.tm_sec > 60)) {
+            return -1;
+        }
+        tm.tm_year -= 1900;
+        tm.tm_mon -= 1;
+        tm.tm_isdst = -1;
+        t_t = mktime(&tm);
+        if(t_t == (time_t)-1) {
+            return -1;
+        }
+        *usec = ((uint64_t)t_t * USEC_PER_SEC) + micro;
+        return 0;
+    }
+
+    /* Relative, from now */
+    if(*p == '\0') {
+        return -1;
+    }
+    while(*p != '\0')
+    {
+        if(!isdigit((unsigned char)*p)) {
+            return -1;
+        }
+        for(value = 0; isdigit((unsigned char)*p); p++)
+        {
+            value = (value * 10) + (*p - '0');
+            if(value > UINT32_MAX) {
+                return -1;
+            }
+        }
+        switch(*p++) {
+        case 's': break;
+        case 'm': value *= 60; break;
+        case 'h': value *= 60 * 60; break;
+        case 'd': value *= 24 * 60 * 60; break;
+        case 'w': value *= 7 * 24 * 60 * 60; break;
+        default: return -1;
+        }
+        ago += value;
+    }
+    t_t = time(NULL);
+    if(ago > (uint64_t)t_t) {
+        ago = t_t;
+    }
+    *usec = ((uint64_t)t_t - ago) * USEC_PER_SEC;
+    return 0;
+}
+
+/* Function       : journal_step
+ * Resposibility  : Move to the next entry, or the previous one in reverse
+ * Return         : 1 if moved, 0 at the end & negative errno on failure
+ */
+static int
+journal_step(sd_journal *journal_handle, int reverse)
+{
+    int return_value = 0;
+    if(reverse) {
+        return_value = sd_journal_previous(journal_handle);
+        if(return_value < 0) {
+            VLOG_ERR("sd_journal_previous failed");
+        }
+    }
+    else {
+        return_value = sd_journal_next(journal_handle);
+        if(return_value < 0) {
+            VLOG_ERR("sd_journal_next failed");
+        }
+    }
+    return return_value;
+}
+
+/* Function       : show_event_entry
+ * Resposibility  : Display the event log entry the journal is at
+ * Return         : 0 on success -1 otherwise
+ */
+static int
+show_event_entry(sd_journal *journal_handle)
+{
+  int return_value = 0;
+  const char *message_data = NULL;
+  const char *timestamp = NULL;
+  const char *module_name = NULL;
+  const char ch = '|';
+  char  tm_buf[BUF_SIZE] = {0,};
+  const char *tm = NULL;
+  const char *msg = NULL;
+  const char *message = NULL;
+  const char *module = NULL;
+  size_t data_length = 0;
+  size_t timestamp_length = 0;
+  size_t module_length = 0;
+
+  return_value = sd_journal_get_data(journal_handle
+          , "MESSAGE"
+          ,(const void **)&message_data
+          , &data_length);
+  if (return_value < 0) {
+      VLOG_ERR("Failed to read message field: %s\n", strerror(-return_value));
+      return -1;
+  }
+
+  return_value = sd_journal_get_data(journal_handle
+          , "SYSLOG_IDENTIFIER"
+          ,(const void **)&module_name
+          , &module_length);
+  if (return_value < 0) {
+      VLOG_ERR("Failed to read module name field: %s\n", strerror(-return_value));
+      return -1;
+  }
+
+  return_value = sd_journal_get_data(journal_handle
+          ,"_SOURCE_REALTIME_TIMESTAMP"
+          ,(const void **)&timestamp
+          , &timestamp_length);
+  if (return_value < 0) {
+      VLOG_ERR("Failed to read timestamp field: %s\n", strerror(-return_value));
+      return -1;
+  }
+
+  /*to get the values from fields using get_value() API*/
+
+  msg = get_value(message_data);
+
+  if(msg!=NULL) {
+      message = strchr(msg,ch);
+  }
+  else {
+      VLOG_ERR("failed to read message-value from message field");
+      message =NULL;
+  }
+
+  module = get_value(module_name);
+
+  if(module==NULL) {
+      VLOG_ERR("failed to read module-value from module field");
+  }
+
+  tm = get_value(timestamp);
+
+  if(tm!=NULL) {
+      /*convert real timestamp to unix timestamp */
+      convert_to_datetime(tm_buf,BUF_SIZE,tm);
+  }
+  else {
+      VLOG_ERR("failed to read time-value from time field");
+  }
+
+  vty_out(vty,"%s|%s%s%s",tm_buf,module,message,VTY_NEWLINE);
+  return 0;
+}
+
+/* Function       : showevents_signal_handler
+ * Resposibility  : ctrl c handler for show events follow
+ * Return         : NULL
+ */
+void
+showevents_signal_handler(int sig, siginfo_t *siginfo, void *context)
+{
+    gShowEventsUserInterrupt = TRUE;
+}
+
+/* Function       : show_events_follow
+ * Resposibility  : Display the events logged after the entry the journal
+ *                  is at as they come, until ctrl c. Blocks in
+ *                  sd_journal_wait() between them, waking up every
+ *                  EVENTS_FOLLOW_WAIT to check for ctrl c.
+ * Return         : CMD_SUCCESS on success CMD_WARNING otherwise
+ */
+static int
+show_events_follow(sd_journal *journal_handle)
+{
+    struct sigaction oldSignalHandler,newSignalHandler;
+    int return_value = 0, return_val = CMD_SUCCESS;
+
+    gShowEventsUserInterrupt = FALSE;
+    /*change the signal handler */
+    memset (&oldSignalHandler, '\0', sizeof(oldSignalHandler));
+    memset (&newSignalHandler, '\0', sizeof(newSignalHandler));
+    newSignalHandler.sa_sigaction = showevents_signal_handler;
+    newSignalHandler.sa_flags = SA_SIGINFO;
+    if(sigaction(SIGINT, &newSignalHandler, &oldSignalHandler) != 0)
+    {
+        VLOG_ERR("Failed to change signal handler");
+        vty_out(vty,"Unable to follow the logs%s",VTY_NEWLINE);
+        return CMD_WARNING;
+    }
+
+    vty_out(vty,"Waiting for new events, press ctrl c to stop%s",
+            VTY_NEWLINE);
+    fflush(stdout);
+    while(!gShowEventsUserInterrupt)
+    {
+        return_value = sd_journal_wait(journal_handle, EVENTS_FOLLOW_WAIT);
+        if(return_value == -EINTR) {
+            continue;
+        }
+        if(return_value < 0) {
+            VLOG_ERR("sd_journal_wait failed with err %d", return_value);
+            return_val = CMD_WARNING;
+            break;
+        }
+        if(return_value == SD_JOURNAL_NOP) {
+            continue;
+        }
+        /* Only the entries after the last one shown */
+        while(!gShowEventsUserInterrupt &&
+              ((return_value = journal_step(journal_handle, FALSE)) > 0))
+        {
+            show_event_entry(journal_handle);
+        }
+        if(return_value < 0) {
+            return_val = CMD_WARNING;
+            break;
+        }
+        fflush(stdout);
+    }
+    if(gShowEventsUserInterrupt) {
+        vty_out(vty,"USER INTERRUPT:Show events follow terminated%s",
+                VTY_NEWLINE);
+    }
+
+    if(sigaction(SIGINT, &oldSignalHandler, NULL) != 0)
+    {
+        VLOG_ERR("Failed to change signal handler to old state");
+        vty_out(vty, "Failed to restore the interrupt handler%s",
+                VTY_NEWLINE);
+        return CMD_WARNING;
+    }
+    return return_val;
+}
+
 /* Function       : cli_show_events
- * Resposibility  : Display Event Logs
+ * Resposibility  : Display Event Logs logged from since to until, both
+ *                  in microseconds since the epoch & 0 if not given. The
+ *                  journal is expected to be positioned at the start of
+ *                  the range, the walk stops at its first entry outside.
+ *                  With last, only the last that many matching entries
+ *                  are walked, stepping back over them from the end of
+ *                  the range & showing them oldest first unless reverse.
+ *                  With follow, the events logged after are shown as
+ *                  they come until ctrl c.
  * Return         : 0 on success 1 otherwise
  */
 int
-cli_show_events(sd_journal *journal_handle,int reverse, int filter)
+cli_show_events(sd_journal *journal_handle,int reverse, int filter,
+                uint64_t since, uint64_t until, int last, int follow)
 {
   int return_value = 0;
   int events_display_count = 0;
   int eof = 1;
+  int walked = 0;
+  int positioned = FALSE;
+  uint64_t usec = 0;
   /* Success, Now print the Header */
   vty_out(vty,"%s---------------------------------------------------%s",
           VTY_NEWLINE,VTY_NEWLINE);
@@ -158,109 +476,54 @@ cli_show_events(sd_journal *journal_handle,int reverse, int filter)
   vty_out(vty,"---------------------------------------------------%s",
           VTY_NEWLINE);
 
-  if(reverse) {
-      eof = sd_journal_previous(journal_handle);
+  if(last && !reverse) {
+      /* Lands on the oldest of them, however long the journal is */
+      eof = sd_journal_previous_skip(journal_handle, last);
       if(eof < 0) {
-          VLOG_ERR("sd_journal_previous failed");
+          VLOG_ERR("sd_journal_previous_skip failed");
+          sd_journal_close(journal_handle);
           return CMD_WARNING;
       }
+      /* There may be fewer */
+      last = eof;
+      positioned = (eof > 0);
   }
-  else {
-      eof = sd_journal_next(journal_handle);
-      if(eof < 0) {
-          VLOG_ERR("sd_journal_next failed");
-          return CMD_WARNING;
-      }
-  }
-  /* For Each Event Log Message  */
-  while(eof)
+  /* For Each Event Log Message, stepping no further than the last one
+   * shown, follow goes on from there */
+  while(!last || (walked < last))
   {
-      const char *message_data = NULL;
-      const char *timestamp = NULL;
-      const char *module_name = NULL;
-      const char ch = '|';
-      char  tm_buf[BUF_SIZE] = {0,};
-      const char *tm = NULL;
-      const char *msg = NULL;
-      const char *message = NULL;
-      const char *module = NULL;
-      size_t data_length = 0;
-      size_t timestamp_length = 0;
-      size_t module_length = 0;
-
-      return_value = sd_journal_get_data(journal_handle
-              , "MESSAGE"
-              ,(const void **)&message_data
-              , &data_length);
-      if (return_value < 0) {
-          VLOG_ERR("Failed to read message field: %s\n", strerror(-return_value));
-          continue;
-      }
-
-      return_value = sd_journal_get_data(journal_handle
-              , "SYSLOG_IDENTIFIER"
-              ,(const void **)&module_name
-              , &module_length);
-      if (return_value < 0) {
-          VLOG_ERR("Failed to read module name field: %s\n", strerror(-return_value));
-          continue;
-      }
-
-      return_value = sd_journal_get_data(journal_handle
-              ,"_SOURCE_REALTIME_TIMESTAMP"
-              ,(const void **)&timestamp
-              , &timestamp_length);
-      if (return_value < 0) {
-          VLOG_ERR("Failed to read timestamp field: %s\n", strerror(-return_value));
-          continue;
-      }
-
-      ++events_display_count;
-
-      /*to get the values from fields using get_value() API*/
-
-      msg = get_value(message_data);
-
-      if(msg!=NULL) {
-          message = strchr(msg,ch);
-      }
-      else {
-          VLOG_ERR("failed to read message-value from message field");
-          message =NULL;
-      }
-
-      module = get_value(module_name);
-
-      if(module==NULL) {
-          VLOG_ERR("failed to read module-value from module field");
+      if(positioned) {
+          positioned = FALSE;
       }
-
-      tm = get_value(timestamp);
-
-      if(tm!=NULL) {
-          /*convert real timestamp to unix timestamp */
-          convert_to_datetime(tm_buf,BUF_SIZE,tm);
-      }
-      else {
-          VLOG_ERR("failed to read time-value from time field");
+      else if((eof = journal_step(journal_handle, reverse)) <= 0) {
+          break;
       }
-
-      vty_out(vty,"%s|%s%s%s",tm_buf,module,message,VTY_NEWLINE);
-      if(reverse) {
-          eof = sd_journal_previous(journal_handle);
-          if(eof < 0) {
-              VLOG_ERR("sd_journal_previous failed");
-              return CMD_WARNING;
+      walked++;
+      if(since || until) {
+          return_value = sd_journal_get_realtime_usec(journal_handle, &usec);
+          if(return_value < 0) {
+              VLOG_ERR("Failed to read entry time: %s",
+                       strerror(-return_value));
+              continue;
           }
-      }
-      else {
-          eof = sd_journal_next(journal_handle);
-          if(eof < 0) {
-              VLOG_ERR("sd_journal_next failed");
-              return CMD_WARNING;
+          /* Past the end of the range, nothing after it can match */
+          if((reverse && since && (usec < since)) ||
+             (!reverse && until && (usec > until))) {
+              break;
           }
+          /* Seeking lands next to the start, skip what is before it */
+          if((since && (usec < since)) || (until && (usec > until))) {
+              continue;
+          }
+      }
+      if(show_event_entry(journal_handle) == 0) {
+          ++events_display_count;
       }
   }
+  if(eof < 0) {
+      sd_journal_close(journal_handle);
+      return CMD_WARNING;
+  }
 
   if(!events_display_count) {
       if(filter) {
@@ -270,6 +533,11 @@ cli_show_events(sd_journal *journal_handle,int reverse, int filter)
           vty_out(vty,"No event has been logged in the system%s",VTY_NEWLINE);
       }
   }
+  if(follow) {
+      return_value = show_events_follow(journal_handle);
+      sd_journal_close(journal_handle);
+      return return_value;
+  }
   sd_journal_close(journal_handle);
   return CMD_SUCCESS;
 }
@@ -281,7 +549,8 @@ cli_show_events(sd_journal *journal_handle,int reverse, int filter)
 DEFUN_NOLOCK (cli_platform_show_events,
         cli_platform_show_events_cmd,
         "show events "
-        "{event-id <A:1001-999999>| severity (emer | alert | crit | err | warn | notice | info | debug) | category WORD|reverse}",
+        "{event-id <A:1001-999999>| severity (emer | alert | crit | err | warn | notice | info | debug) | reverse | category WORD"
+        "|key WORD|since WORD|until WORD|last <1-100000>|follow}",
         SHOW_STR
         SHOW_EVENTS_STR
         SHOW_EVENTS_FILTER_EV_ID
@@ -298,7 +567,9 @@ DEFUN_NOLOCK (cli_platform_show_events,
         SHOW_EVENTS_REVERSE
         SHOW_EVENTS_CATEGORY)
 {
-    int i = 1, return_value = 0, reverse = 0, filter = 0;
+    int i = 1, return_value = 0, reverse = 0, filter = 0, last = 0;
+    int follow = 0;
+    uint64_t since = 0, until = 0;
     sd_journal *journal_handle = NULL;
     struct range_list *temp_to_free, *temp_to_display, *list = NULL;
 
@@ -343,17 +614,64 @@ DEFUN_NOLOCK (cli_platform_show_events,
          temp_to_free = cmd_free_memory_range_list(temp_to_free);
       }
     }
-    if(argv[2] != NULL) {
-        /* Reverse list option */
-        return_value = sd_journal_seek_tail(journal_handle);
+    if(((argv[EVENT_SINCE_INDEX] != NULL) &&
+        (parse_event_time(argv[EVENT_SINCE_INDEX], &since) < 0)) ||
+       ((argv[EVENT_UNTIL_INDEX] != NULL) &&
+        (parse_event_time(argv[EVENT_UNTIL_INDEX], &until) < 0))) {
+        vty_out(vty,"Invalid time, give YYYY-MM-DD[:HH:MM:SS] or how long "
+                "ago as <number>(s|m|h|d|w)%s",VTY_NEWLINE);
+        sd_journal_close(journal_handle);
+        return CMD_WARNING;
+    }
+    if(until && (since > until)) {
+        vty_out(vty,"since must not be later than until%s",VTY_NEWLINE);
+        sd_journal_close(journal_handle);
+        return CMD_WARNING;
+    }
+    if(argv[EVENT_LAST_INDEX] != NULL) {
+        last = atoi(argv[EVENT_LAST_INDEX]);
+    }
+    if(argv[EVENT_FOLLOW_INDEX] != NULL) {
+        /* New events come after the tail, in order */
+        if((argv[2] != NULL) || until) {
+            vty_out(vty,"follow can not be used with reverse or until%s",
+                    VTY_NEWLINE);
+            sd_journal_close(journal_handle);
+            return CMD_WARNING;
+        }
+        follow = TRUE;
+        if(!last) {
+            last = EVENTS_FOLLOW_TAIL;
+        }
+    }
+    if((argv[2] != NULL) || last) {
+        /* Reverse list & last options, from the end of the range */
+        if(until) {
+            return_value = sd_journal_seek_realtime_usec(journal_handle,
+                                                         until);
+        }
+        else {
+            return_value = sd_journal_seek_tail(journal_handle);
+        }
         if(return_value < 0) {
             vty_out(vty,"Unable to reverse the logs%s",VTY_NEWLINE);
-            VLOG_ERR("sd_journal_seek_tail failed with err %d",
+            VLOG_ERR("Journal seek failed with err %d",
             return_value);
             sd_journal_close(journal_handle);
             return CMD_WARNING;
         }
-        reverse = TRUE;
+        reverse = (argv[2] != NULL);
+    }
+    else if(since) {
+        /* Start at the range rather than walking up to it */
+        return_value = sd_journal_seek_realtime_usec(journal_handle, since);
+        if(return_value < 0) {
+            vty_out(vty,"Unable to seek the logs%s",VTY_NEWLINE);
+            VLOG_ERR("sd_journal_seek_realtime_usec failed with err %d",
+                     return_value);
+            sd_journal_close(journal_handle);
+            return CMD_WARNING;
+        }
     }
     /* Filter Event Logs based on given filters in CLI */
     while(i <= MAX_FILTER_ARGS)
@@ -372,5 +690,9 @@ DEFUN_NOLOCK (cli_platform_show_events,
         }
         i++;
     }
-    return cli_show_events(journal_handle, reverse, filter);
+    if(since || until) {
+        filter = TRUE;
+    }
+    return cli_show_events(journal_handle, reverse, filter, since, until,
+                           last, follow);
 }
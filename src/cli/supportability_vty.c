@@ -380,7 +380,31 @@ install_show_evnts()
     }
     if(exit) {
         /* Append the command & form it properly */
-        strncat(cmd, ")}", ((MAX_CMD_SIZE - strlen(cmd))-1));
+        strncat(cmd, ")", ((MAX_CMD_SIZE - strlen(cmd))-1));
+        strncat(cmd, SHOW_EVENTS_KEY_CMD, ((MAX_CMD_SIZE - strlen(cmd))-1));
+        strncat(cmd, SHOW_EVENTS_RANGE_CMD,
+                ((MAX_CMD_SIZE - strlen(cmd))-1));
+        strncat(cmd, SHOW_EVENTS_LAST_CMD, ((MAX_CMD_SIZE - strlen(cmd))-1));
+        strncat(cmd, SHOW_EVENTS_FOLLOW_CMD,
+                ((MAX_CMD_SIZE - strlen(cmd))-1));
+        strncat(cmd, "}", ((MAX_CMD_SIZE - strlen(cmd))-1));
+        strncat(help, SHOW_EVENTS_KEY, ((MAX_EV_HELP_SIZE - strlen(help))-1));
+        strncat(help, SHOW_EVENTS_KEY_VALUE,
+                ((MAX_EV_HELP_SIZE - strlen(help))-1));
+        strncat(help, SHOW_EVENTS_SINCE,
+                ((MAX_EV_HELP_SIZE - strlen(help))-1));
+        strncat(help, SHOW_EVENTS_TIME,
+                ((MAX_EV_HELP_SIZE - strlen(help))-1));
+        strncat(help, SHOW_EVENTS_UNTIL,
+                ((MAX_EV_HELP_SIZE - strlen(help))-1));
+        strncat(help, SHOW_EVENTS_TIME,
+                ((MAX_EV_HELP_SIZE - strlen(help))-1));
+        strncat(help, SHOW_EVENTS_LAST,
+                ((MAX_EV_HELP_SIZE - strlen(help))-1));
+        strncat(help, SHOW_EVENTS_LAST_COUNT,
+                ((MAX_EV_HELP_SIZE - strlen(help))-1));
+        strncat(help, SHOW_EVENTS_FOLLOW,
+                ((MAX_EV_HELP_SIZE - strlen(help))-1));
         /* Now let cmd element structure point to newly formed help & cmd strings */
         cli_platform_show_events_cmd.string = cmd;
         cli_platform_show_events_cmd.doc = help;
@@ -0,0 +1,1618 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*************************************************************************//**
+ * @ingroup ops_supportability
+ * This module loads the event catalog used by the event log part of
+ * supportability library. The catalog compiled at build time is mapped
+ * read-only so that all daemons share one page cache copy of it, and
+ * the yaml file is parsed only if that catalog is missing or stale.
+ *
+ * @file
+ * Source file for the event catalog of supportability library.
+ *
+ ****************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <yaml.h>
+#include "eventlog.h"
+#include "event_catalog.h"
+#include "openvswitch/vlog.h"
+
+VLOG_DEFINE_THIS_MODULE(event_catalog);
+
+#define CATALOG_ALIGN(X) (((X) + 7) & ~((size_t)7))
+#define MIN_CATALOG_BUCKETS 16
+
+#define MIN_STAGING_EVENTS 64
+#define MIN_STAGING_STRINGS 4096
+
+/* Rate limit, coalescing & sampling settings, -1 when not set in yaml
+ * file */
+struct staging_rate {
+    int rate_limit;
+    int rate_burst;
+    int coalesce_window;
+    int sample_rate;
+};
+
+/* Rate limit, coalescing & sampling settings of a category from the
+ * categories list */
+struct staging_category_rate {
+    uint32_t name;
+    struct staging_rate rate;
+};
+
+/* Events parsed from yaml file, before they are laid out in the
+ * catalog image. Strings are interned in one arena & referred to by
+ * their offset in it, 0 being the empty string, so that equal strings
+ * compare by offset. The fixed size fields of the events are kept in
+ * arrays of their own, all grown together as events are parsed. */
+struct staging {
+    char *strings;
+    size_t strings_used;
+    size_t strings_size;
+    uint32_t *interned;                 /* Offsets hashed by content */
+    uint32_t n_interned;
+    uint32_t n_intern_buckets;          /* Power of 2 */
+
+    uint32_t *names;
+    uint32_t *severities;
+    uint32_t *descriptions;
+    int *event_ids;
+    int *num_of_keys;
+    int *categories_of;                 /* Category index, -1 if none */
+    struct staging_rate *event_rates;
+    int n_events;
+    int max_events;
+
+    uint32_t *categories;               /* Category names */
+    int n_categories;
+    int max_categories;
+    struct staging_category_rate *category_rates;
+    int n_category_rates;
+    int max_category_rates;
+};
+
+/* Fields of an event definition in yaml file */
+enum {
+    EV_FIELD_NONE,
+    EV_FIELD_NAME,
+    EV_FIELD_CATEGORY,
+    EV_FIELD_ID,
+    EV_FIELD_SEVERITY,
+    EV_FIELD_KEYS,
+    EV_FIELD_DESCRIPTION,
+    EV_FIELD_RATE_LIMIT,
+    EV_FIELD_RATE_BURST,
+    EV_FIELD_COALESCE_WINDOW,
+    EV_FIELD_SAMPLE_RATE
+};
+
+static struct event_catalog catalog;
+static int catalog_loaded = 0;
+
+/* event_name_hash
+ * FNV-1a hash of the event name used to index the catalog.
+ * ops_eventcatalog.py computes the same hash for compiled catalogs.
+ *
+ * Returns the hash value.
+ */
+uint32_t
+event_name_hash(const char *name)
+{
+    uint32_t hash = 2166136261u;
+    while(*name)
+    {
+        hash ^= (unsigned char)*name++;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+/* yaml_file_hash
+ * FNV-1a hash of the yaml file content, recorded in the catalog
+ * to find out whether it was compiled from the same file.
+ *
+ * Returns the hash value.
+ */
+static uint64_t
+yaml_file_hash(const unsigned char *data, size_t len)
+{
+    uint64_t hash = 14695981039346656037ull;
+    size_t i = 0;
+    for(i = 0; i < len; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/* install_path
+ * Prefixes the file path with OPENSWITCH_INSTALL_PATH, if set.
+ *
+ * Returns the allocated path on success, NULL on failure.
+ */
+static char *
+install_path(const char *file)
+{
+    char path[512] = {0,};
+    char *envv = getenv("OPENSWITCH_INSTALL_PATH");
+    if (envv)
+        strncpy(path, envv, (sizeof(path)-1));
+    if ((strlen(path) + strlen(file) + 1) > sizeof(path))
+        return NULL;
+    strcat(path, file);
+    return strdup(path);
+}
+
+/* read_file
+ * Reads the whole file in to an allocated buffer.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+static int
+read_file(const char *path, unsigned char **data, size_t *len)
+{
+    struct stat st;
+    ssize_t n = 0;
+    size_t done = 0;
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return -1;
+    }
+    if((fstat(fd, &st) < 0) || (st.st_size <= 0)) {
+        close(fd);
+        return -1;
+    }
+    *data = (unsigned char*)malloc(st.st_size);
+    if(*data == NULL) {
+        close(fd);
+        return -1;
+    }
+    while(done < (size_t)st.st_size)
+    {
+        n = read(fd, *data + done, st.st_size - done);
+        if(n <= 0) {
+            free(*data);
+            *data = NULL;
+            close(fd);
+            return -1;
+        }
+        done += n;
+    }
+    close(fd);
+    *len = done;
+    return 0;
+}
+
+/* count_keys
+ * Counts the number of keys in the event string
+ *
+ * Returns - 1 on failure, number of keys on success.
+ */
+int
+count_keys(char *keys)
+{
+    char *key_token = NULL, *save = NULL;
+    int key_count = 0;
+    if(keys == NULL) {
+       return -1;
+    }
+    key_token = strtok_r(keys, ",", &save);
+    while(key_token != NULL)
+    {
+        key_token = strtok_r(NULL, ",", &save);
+        key_count++;
+    }
+    return key_count;
+}
+
+/* staging_grow
+ * Resizes an array of the staging area to max entries.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+static int
+staging_grow(void *array, size_t size, int max)
+{
+    void *grown = realloc(*(void**)array, max * size);
+    if(grown == NULL) {
+        return -1;
+    }
+    *(void**)array = grown;
+    return 0;
+}
+
+/* staging_rehash
+ * Doubles the hash index of the interned strings.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+static int
+staging_rehash(struct staging *st)
+{
+    uint32_t n_buckets = st->n_intern_buckets ? (2*st->n_intern_buckets) :
+                                                MIN_CATALOG_BUCKETS;
+    uint32_t *buckets = (uint32_t*)calloc(n_buckets, sizeof(*buckets));
+    uint32_t i = 0, bucket = 0;
+    if(buckets == NULL) {
+        return -1;
+    }
+    for(i = 0; i < st->n_intern_buckets; i++)
+    {
+        if(st->interned[i] == 0) {
+            continue;
+        }
+        bucket = event_name_hash(st->strings + st->interned[i]) &
+                 (n_buckets - 1);
+        while(buckets[bucket] != 0)
+        {
+            bucket = (bucket + 1) & (n_buckets - 1);
+        }
+        buckets[bucket] = st->interned[i];
+    }
+    free(st->interned);
+    st->interned = buckets;
+    st->n_intern_buckets = n_buckets;
+    return 0;
+}
+
+/* staging_intern
+ * Interns the string in the arena of the staging area, a string
+ * already there is not copied again.
+ *
+ * Returns 0 on success with the offset of the string in off, -1 on
+ * failure.
+ */
+static int
+staging_intern(struct staging *st, const char *str, uint32_t *off)
+{
+    size_t size = strlen(str) + 1, new_size = 0;
+    uint32_t bucket = 0;
+    *off = 0;
+    if(size == 1) {
+        return 0;
+    }
+    if((2*(st->n_interned + 1)) > st->n_intern_buckets) {
+        if(staging_rehash(st) < 0) {
+            return -1;
+        }
+    }
+    bucket = event_name_hash(str) & (st->n_intern_buckets - 1);
+    while(st->interned[bucket] != 0)
+    {
+        if(!strcmp(st->strings + st->interned[bucket], str)) {
+            *off = st->interned[bucket];
+            return 0;
+        }
+        bucket = (bucket + 1) & (st->n_intern_buckets - 1);
+    }
+    if((st->strings_used + size) > st->strings_size) {
+        new_size = st->strings_size ? st->strings_size : MIN_STAGING_STRINGS;
+        while(new_size < (st->strings_used + size))
+        {
+            new_size *= 2;
+        }
+        if((new_size > UINT32_MAX) ||
+           (staging_grow(&st->strings, 1, new_size) < 0)) {
+            return -1;
+        }
+        st->strings_size = new_size;
+    }
+    if(st->strings_used == 0) {
+        /* Offset 0 is the empty string */
+        st->strings[st->strings_used++] = '\0';
+    }
+    *off = st->strings_used;
+    memcpy(st->strings + st->strings_used, str, size);
+    st->strings_used += size;
+    st->interned[bucket] = *off;
+    st->n_interned++;
+    return 0;
+}
+
+/* staging_str
+ * Returns the string at offset off of the staging area arena.
+ */
+static const char *
+staging_str(const struct staging *st, uint32_t off)
+{
+    return (off == 0) ? "" : (st->strings + off);
+}
+
+/* staging_add_event
+ * Adds an event with nothing set to the staging area, growing its
+ * arrays when full.
+ *
+ * Returns the event index on success, -1 on failure.
+ */
+static int
+staging_add_event(struct staging *st)
+{
+    int max = st->max_events, i = st->n_events;
+    if(i == max) {
+        max = max ? (2*max) : MIN_STAGING_EVENTS;
+        if((staging_grow(&st->names, sizeof(*st->names), max) < 0) ||
+           (staging_grow(&st->severities, sizeof(*st->severities), max) < 0) ||
+           (staging_grow(&st->descriptions,
+                         sizeof(*st->descriptions), max) < 0) ||
+           (staging_grow(&st->event_ids, sizeof(*st->event_ids), max) < 0) ||
+           (staging_grow(&st->num_of_keys,
+                         sizeof(*st->num_of_keys), max) < 0) ||
+           (staging_grow(&st->categories_of,
+                         sizeof(*st->categories_of), max) < 0) ||
+           (staging_grow(&st->event_rates,
+                         sizeof(*st->event_rates), max) < 0)) {
+            VLOG_ERR("Failed to allocate events");
+            return -1;
+        }
+        st->max_events = max;
+    }
+    st->names[i] = 0;
+    st->severities[i] = 0;
+    st->descriptions[i] = 0;
+    st->event_ids[i] = 0;
+    st->num_of_keys[i] = 0;
+    st->categories_of[i] = -1;
+    st->event_rates[i].rate_limit = -1;
+    st->event_rates[i].rate_burst = -1;
+    st->event_rates[i].coalesce_window = -1;
+    st->event_rates[i].sample_rate = -1;
+    st->n_events++;
+    return i;
+}
+
+/* staging_category
+ * Looks up the category in the staging area, adding it if this is
+ * the first event seen for it.
+ *
+ * Returns the category index on success, -1 on failure.
+ */
+static int
+staging_category(struct staging *st, const char *name)
+{
+    uint32_t off = 0;
+    int i = 0, max = st->max_categories;
+    if(staging_intern(st, name, &off) < 0) {
+        return -1;
+    }
+    for(i = 0; i < st->n_categories; i++)
+    {
+        if(st->categories[i] == off) {
+            return i;
+        }
+    }
+    if(i == max) {
+        max = max ? (2*max) : MIN_CATALOG_BUCKETS;
+        if(staging_grow(&st->categories, sizeof(*st->categories), max) < 0) {
+            return -1;
+        }
+        st->max_categories = max;
+    }
+    st->categories[i] = off;
+    st->n_categories++;
+    return i;
+}
+
+/* free_staging
+ * Releases the events parsed from yaml file.
+ */
+static void
+free_staging(struct staging *st)
+{
+    free(st->strings);
+    free(st->interned);
+    free(st->names);
+    free(st->severities);
+    free(st->descriptions);
+    free(st->event_ids);
+    free(st->num_of_keys);
+    free(st->categories_of);
+    free(st->event_rates);
+    free(st->categories);
+    free(st->category_rates);
+}
+
+/* rate_value
+ * Converts a rate limit setting from yaml file, negative values
+ * are taken as 0.
+ *
+ * Returns the setting.
+ */
+static int
+rate_value(const char *value)
+{
+    int rate = atoi(value);
+    return (rate < 0) ? 0 : rate;
+}
+
+/* staging_category_rate
+ * Starts the rate limit, coalescing & sampling settings of a category
+ * from the categories list, the first entry of a category is the one
+ * used.
+ *
+ * Returns the settings to fill in, NULL to ignore them.
+ */
+static struct staging_rate *
+staging_category_rate(struct staging *st, const char *name)
+{
+    struct staging_category_rate *cr = NULL;
+    uint32_t off = 0;
+    int i = 0, max = st->max_category_rates;
+    if(staging_intern(st, name, &off) < 0) {
+        return NULL;
+    }
+    for(i = 0; i < st->n_category_rates; i++)
+    {
+        if(st->category_rates[i].name == off) {
+            return NULL;
+        }
+    }
+    if(i == max) {
+        max = max ? (2*max) : MIN_CATALOG_BUCKETS;
+        if(staging_grow(&st->category_rates,
+                        sizeof(*st->category_rates), max) < 0) {
+            return NULL;
+        }
+        st->max_category_rates = max;
+    }
+    cr = &st->category_rates[st->n_category_rates++];
+    cr->name = off;
+    cr->rate.rate_limit = -1;
+    cr->rate.rate_burst = -1;
+    cr->rate.coalesce_window = -1;
+    cr->rate.sample_rate = -1;
+    return &cr->rate;
+}
+
+/* category_rate
+ * Looks up the settings from the categories list of the category of
+ * the event.
+ *
+ * Returns the settings, NULL if its category has none.
+ */
+static const struct staging_rate *
+category_rate(const struct staging *st, int index)
+{
+    uint32_t name = st->categories[st->categories_of[index]];
+    int i = 0;
+    for(i = 0; i < st->n_category_rates; i++)
+    {
+        if(st->category_rates[i].name == name) {
+            return &st->category_rates[i].rate;
+        }
+    }
+    return NULL;
+}
+
+/* rate_limits
+ * Resolves the rate limit of an event, the same way ops_eventcatalog.py
+ * does. Settings of the event override those of its category, the
+ * burst defaults to the rate the event ends up with.
+ */
+static void
+rate_limits(const struct staging *st, int index, uint32_t *rate,
+            uint32_t *burst)
+{
+    const struct staging_rate *ev = &st->event_rates[index];
+    const struct staging_rate *cat = category_rate(st, index);
+    *rate = 0;
+    if(ev->rate_limit >= 0) {
+        *rate = ev->rate_limit;
+    }
+    else if((cat != NULL) && (cat->rate_limit >= 0)) {
+        *rate = cat->rate_limit;
+    }
+    *burst = *rate;
+    if(ev->rate_burst >= 0) {
+        *burst = ev->rate_burst;
+    }
+    else if((ev->rate_limit < 0) && (cat != NULL) && (cat->rate_burst >= 0)) {
+        *burst = cat->rate_burst;
+    }
+    if(*rate == 0) {
+        *burst = 0;
+    }
+}
+
+/* coalesce_window
+ * Resolves the window duplicates of an event are coalesced over, the
+ * same way ops_eventcatalog.py does. The setting of the event
+ * overrides that of its category.
+ *
+ * Returns the window in seconds, 0 if duplicates are not coalesced.
+ */
+static uint32_t
+coalesce_window(const struct staging *st, int index)
+{
+    const struct staging_rate *ev = &st->event_rates[index];
+    const struct staging_rate *cat = category_rate(st, index);
+    if(ev->coalesce_window >= 0) {
+        return ev->coalesce_window;
+    }
+    if((cat != NULL) && (cat->coalesce_window >= 0)) {
+        return cat->coalesce_window;
+    }
+    return 0;
+}
+
+/* sample_rate
+ * Resolves the sampling of an event, the same way ops_eventcatalog.py
+ * does. The setting of the event overrides that of its category.
+ *
+ * Returns N for an event logged 1 in N times, 1 if it is not sampled.
+ */
+static uint32_t
+sample_rate(const struct staging *st, int index)
+{
+    const struct staging_rate *ev = &st->event_rates[index];
+    const struct staging_rate *cat = category_rate(st, index);
+    int rate = 1;
+    if(ev->sample_rate >= 0) {
+        rate = ev->sample_rate;
+    }
+    else if((cat != NULL) && (cat->sample_rate >= 0)) {
+        rate = cat->sample_rate;
+    }
+    return (rate > 1) ? rate : 1;
+}
+
+/* assign_parsed_values
+ * assigns the value parsed from yaml file to the field
+ * of the event it belongs to.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+static int
+assign_parsed_values(struct staging *st, int ev, int field, char *value)
+{
+    int size = strlen(value);
+    int cat = 0, ret = 0;
+    switch(field) {
+
+        case EV_FIELD_NAME:
+            ret = staging_intern(st, value, &st->names[ev]);
+            break;
+
+        case EV_FIELD_CATEGORY:
+            cat = staging_category(st, value);
+            if(cat < 0) {
+                return -1;
+            }
+            st->categories_of[ev] = cat;
+            break;
+
+        case EV_FIELD_ID:
+            st->event_ids[ev] = atoi(value);
+            break;
+
+        case EV_FIELD_SEVERITY:
+            if((size > 0) && (size < MAX_SEV_NAME_SIZE)) {
+                ret = staging_intern(st, value, &st->severities[ev]);
+            }
+            break;
+
+        case EV_FIELD_KEYS:
+            st->num_of_keys[ev] = count_keys(value);
+            break;
+
+        case EV_FIELD_DESCRIPTION:
+            ret = staging_intern(st, value, &st->descriptions[ev]);
+            break;
+
+        case EV_FIELD_RATE_LIMIT:
+            st->event_rates[ev].rate_limit = rate_value(value);
+            break;
+
+        case EV_FIELD_RATE_BURST:
+            st->event_rates[ev].rate_burst = rate_value(value);
+            break;
+
+        case EV_FIELD_COALESCE_WINDOW:
+            st->event_rates[ev].coalesce_window = rate_value(value);
+            break;
+
+        case EV_FIELD_SAMPLE_RATE:
+            st->event_rates[ev].sample_rate = rate_value(value);
+            break;
+
+        default:
+            break;
+    }
+    return ret;
+}
+
+/* event_field
+ * Maps a key of an event definition in yaml file to the
+ * event field it populates.
+ *
+ * Returns the field, EV_FIELD_NONE for keys we don't keep.
+ */
+static int
+event_field(const char *key)
+{
+    if(!strcmp(key, "event_name")) {
+        return EV_FIELD_NAME;
+    }
+    else if(!strcmp(key, "event_category")) {
+        return EV_FIELD_CATEGORY;
+    }
+    else if(!strcmp(key, "event_ID")) {
+        return EV_FIELD_ID;
+    }
+    else if(!strcmp(key, "severity")) {
+        return EV_FIELD_SEVERITY;
+    }
+    else if(!strcmp(key, "keys")) {
+        return EV_FIELD_KEYS;
+    }
+    else if(!strcmp(key, "event_description_template")) {
+        return EV_FIELD_DESCRIPTION;
+    }
+    else if(!strcmp(key, "rate_limit")) {
+        return EV_FIELD_RATE_LIMIT;
+    }
+    else if(!strcmp(key, "rate_burst")) {
+        return EV_FIELD_RATE_BURST;
+    }
+    else if(!strcmp(key, "coalesce_window")) {
+        return EV_FIELD_COALESCE_WINDOW;
+    }
+    else if(!strcmp(key, "sample_rate")) {
+        return EV_FIELD_SAMPLE_RATE;
+    }
+    return EV_FIELD_NONE;
+}
+
+/* parse_event_yaml
+ * Parses the events.yaml file content and loads all the event
+ * definitions it has in to the staging area.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+static int
+parse_event_yaml(const unsigned char *data, size_t len, struct staging *st)
+{
+    yaml_parser_t parser;
+    yaml_token_t token;
+    struct staging_rate *cat_rate = NULL;
+    char *key = NULL;
+    int def_flag = 0, is_key = 0, field = EV_FIELD_NONE;
+    int ret = 0, done = 0, ev = -1;
+
+    if (!yaml_parser_initialize(&parser)) {
+        VLOG_ERR("YAML Initialize failed");
+        return -1;
+    }
+    yaml_parser_set_input_string(&parser, data, len);
+    /* Lets loop through all tokens & fill in the event each
+     * definition under event_definitions describes */
+    while(!done)
+    {
+        if(!yaml_parser_scan(&parser, &token)) {
+            VLOG_ERR("YAML parse failed");
+            ret = -1;
+            break;
+        }
+        switch(token.type)
+        {
+            case YAML_STREAM_END_TOKEN:
+                done = 1;
+                break;
+
+            case YAML_KEY_TOKEN:
+                is_key = 1;
+                break;
+
+            case YAML_VALUE_TOKEN:
+                is_key = 0;
+                break;
+
+            case YAML_SCALAR_TOKEN:
+                key = (char*)token.data.scalar.value;
+                if(key == NULL) {
+                    break;
+                }
+                if(!def_flag) {
+                    /* Only rate limits, coalescing windows & sampling
+                     * are taken from the categories list ahead of the
+                     * event definitions */
+                    if(is_key) {
+                        field = event_field(key);
+                        if(!strcmp(key, "event_definitions")) {
+                            def_flag = 1;
+                            field = EV_FIELD_NONE;
+                        }
+                        break;
+                    }
+                    if(field == EV_FIELD_CATEGORY) {
+                        cat_rate = staging_category_rate(st, key);
+                    }
+                    else if((cat_rate != NULL) &&
+                            (field == EV_FIELD_RATE_LIMIT)) {
+                        cat_rate->rate_limit = rate_value(key);
+                    }
+                    else if((cat_rate != NULL) &&
+                            (field == EV_FIELD_RATE_BURST)) {
+                        cat_rate->rate_burst = rate_value(key);
+                    }
+                    else if((cat_rate != NULL) &&
+                            (field == EV_FIELD_COALESCE_WINDOW)) {
+                        cat_rate->coalesce_window = rate_value(key);
+                    }
+                    else if((cat_rate != NULL) &&
+                            (field == EV_FIELD_SAMPLE_RATE)) {
+                        cat_rate->sample_rate = rate_value(key);
+                    }
+                    field = EV_FIELD_NONE;
+                    break;
+                }
+                if(is_key) {
+                    field = event_field(key);
+                    if(field == EV_FIELD_NAME) {
+                        /* Every definition starts with its event name */
+                        ev = staging_add_event(st);
+                        if(ev < 0) {
+                            ret = -1;
+                            done = 1;
+                            break;
+                        }
+                    }
+                    break;
+                }
+                if((ev >= 0) && (field != EV_FIELD_NONE)) {
+                    if(assign_parsed_values(st, ev, field, key) < 0) {
+                        ret = -1;
+                        done = 1;
+                    }
+                }
+                field = EV_FIELD_NONE;
+                break;
+
+            default:
+                break;
+        }
+        yaml_token_delete(&token);
+    }
+    yaml_parser_delete(&parser);
+    return ret;
+}
+
+/* add_string
+ * Appends the string to the catalog string arena, empty strings
+ * all share offset 0.
+ *
+ * Returns offset of the string in the arena.
+ */
+static uint32_t
+add_string(char *strings, size_t *used, const char *str)
+{
+    uint32_t off = *used;
+    size_t size = strlen(str);
+    if(size == 0) {
+        return 0;
+    }
+    memcpy(strings + off, str, (size+1));
+    *used += (size+1);
+    return off;
+}
+
+/* string_size
+ * Returns the room add_string() takes for the string in the arena.
+ */
+static size_t
+string_size(const char *str)
+{
+    return (str[0] == '\0') ? 0 : (strlen(str) + 1);
+}
+
+/* add_field
+ * Appends the journal field "<name><value>" to the catalog string
+ * arena.
+ *
+ * Returns offset of the field in the arena.
+ */
+static uint32_t
+add_field(char *strings, size_t *used, const char *name, const char *value)
+{
+    uint32_t off = *used;
+    size_t name_size = strlen(name), value_size = strlen(value);
+    memcpy(strings + off, name, name_size);
+    memcpy(strings + off + name_size, value, (value_size+1));
+    *used += (name_size + value_size + 1);
+    return off;
+}
+
+/* event_fields
+ * Renders the constant journal fields of an event, as stored in the
+ * catalog: the MESSAGE field up to the description, PRIORITY (left
+ * empty for an unknown severity) and OPS_EVENT_ID.
+ *
+ * Returns the severity level, -1 if unknown.
+ */
+static int
+event_fields(const struct staging *st, int ev, char *prefix, char *priority,
+             char *id)
+{
+    const char *severity = staging_str(st, st->severities[ev]);
+    int level = severity_level((char*)severity);
+    snprintf(prefix, EVENT_FIELD_SIZE + MAX_EVENT_NAME_SIZE,
+             "MESSAGE=ops-evt|%d|%s|", st->event_ids[ev], severity);
+    priority[0] = '\0';
+    if(level >= 0) {
+        snprintf(priority, EVENT_FIELD_SIZE, "PRIORITY=%d", level);
+    }
+    snprintf(id, EVENT_FIELD_SIZE, "OPS_EVENT_ID=%d", st->event_ids[ev]);
+    return level;
+}
+
+/* compile_template
+ * Splits the description template at off in the string arena in to
+ * literal and {key} placeholder segments. With a NULL segs the
+ * segments are only counted.
+ *
+ * Returns the number of segments.
+ */
+static uint32_t
+compile_template(const char *strings, uint32_t off,
+                 struct event_catalog_segment *segs)
+{
+    const char *tmpl = strings + off;
+    uint32_t i = 0, j = 0, literal = 0, n = 0;
+    uint32_t len = strlen(tmpl);
+    while(i < len)
+    {
+        if(tmpl[i] == '{') {
+            j = i + 1;
+            while((j < len) && (tmpl[j] != '{') && (tmpl[j] != '}'))
+            {
+                j++;
+            }
+            if((j < len) && (tmpl[j] == '}') && (j > (i + 1))) {
+                if(i > literal) {
+                    if(segs) {
+                        segs[n].kind = EVENT_SEGMENT_LITERAL;
+                        segs[n].off = off + literal;
+                        segs[n].len = i - literal;
+                    }
+                    n++;
+                }
+                if(segs) {
+                    segs[n].kind = EVENT_SEGMENT_KEY;
+                    segs[n].off = off + i + 1;
+                    segs[n].len = j - (i + 1);
+                }
+                n++;
+                i = j + 1;
+                literal = i;
+                continue;
+            }
+        }
+        i++;
+    }
+    if(len > literal) {
+        if(segs) {
+            segs[n].kind = EVENT_SEGMENT_LITERAL;
+            segs[n].off = off + literal;
+            segs[n].len = len - literal;
+        }
+        n++;
+    }
+    return n;
+}
+
+/* build_catalog
+ * Lays out the events in the staging area as a catalog image, the
+ * same way ops_eventcatalog.py does at build time.
+ *
+ * Returns the allocated image on success, NULL on failure.
+ */
+static struct event_catalog_header *
+build_catalog(const struct staging *st, uint64_t yaml_hash)
+{
+    struct event_catalog_header *hdr = NULL;
+    struct event_catalog_event *events = NULL;
+    struct event_catalog_category *categories = NULL;
+    uint32_t *buckets = NULL;
+    struct event_catalog_segment *segments = NULL;
+    char *strings = NULL;
+    size_t strings_size = 1, used = 1, size = 0;
+    uint32_t n_buckets = MIN_CATALOG_BUCKETS, n = 0, bucket = 0;
+    uint32_t n_segments = 0;
+    char prefix[EVENT_FIELD_SIZE + MAX_EVENT_NAME_SIZE];
+    char priority[EVENT_FIELD_SIZE], id[EVENT_FIELD_SIZE];
+    int i = 0, j = 0;
+
+    for(i = 0; i < st->n_categories; i++)
+    {
+        const char *name = staging_str(st, st->categories[i]);
+        strings_size += string_size(name);
+        strings_size += strlen(EVENT_CATEGORY_FIELD) + strlen(name) + 1;
+    }
+    for(i = 0; i < st->n_events; i++)
+    {
+        if(st->categories_of[i] >= 0) {
+            n++;
+            strings_size += string_size(staging_str(st, st->names[i]));
+            strings_size += string_size(staging_str(st, st->severities[i]));
+            strings_size += string_size(staging_str(st, st->descriptions[i]));
+            event_fields(st, i, prefix, priority, id);
+            strings_size += string_size(prefix) + string_size(priority) +
+                            string_size(id);
+            n_segments += compile_template(staging_str(st,
+                                           st->descriptions[i]), 0, NULL);
+        }
+    }
+    while(n_buckets < (2*n))
+    {
+        n_buckets *= 2;
+    }
+    size = CATALOG_ALIGN(sizeof(*hdr));
+    size = CATALOG_ALIGN(size + n*sizeof(*events));
+    size = CATALOG_ALIGN(size + st->n_categories*sizeof(*categories));
+    size = CATALOG_ALIGN(size + n_buckets*sizeof(*buckets));
+    size = CATALOG_ALIGN(size + n_segments*sizeof(*segments));
+    size = CATALOG_ALIGN(size + strings_size);
+
+    hdr = (struct event_catalog_header*)calloc(1, size);
+    if(hdr == NULL) {
+        return NULL;
+    }
+    memcpy(hdr->magic, EVENT_CATALOG_MAGIC, EVENT_CATALOG_MAGIC_SIZE);
+    hdr->version = EVENT_CATALOG_VERSION;
+    hdr->size = size;
+    hdr->yaml_hash = yaml_hash;
+    hdr->n_events = n;
+    hdr->n_categories = st->n_categories;
+    hdr->n_buckets = n_buckets;
+    hdr->events_off = CATALOG_ALIGN(sizeof(*hdr));
+    hdr->categories_off = CATALOG_ALIGN(hdr->events_off + n*sizeof(*events));
+    hdr->buckets_off = CATALOG_ALIGN(hdr->categories_off +
+                       st->n_categories*sizeof(*categories));
+    hdr->segments_off = CATALOG_ALIGN(hdr->buckets_off +
+                        n_buckets*sizeof(*buckets));
+    hdr->n_segments = n_segments;
+    hdr->strings_off = CATALOG_ALIGN(hdr->segments_off +
+                       n_segments*sizeof(*segments));
+    hdr->strings_size = strings_size;
+
+    events = (struct event_catalog_event*)((char*)hdr + hdr->events_off);
+    categories = (struct event_catalog_category*)
+                 ((char*)hdr + hdr->categories_off);
+    buckets = (uint32_t*)((char*)hdr + hdr->buckets_off);
+    segments = (struct event_catalog_segment*)((char*)hdr + hdr->segments_off);
+    strings = (char*)hdr + hdr->strings_off;
+
+    for(i = 0; i < st->n_categories; i++)
+    {
+        const char *name = staging_str(st, st->categories[i]);
+        categories[i].name = add_string(strings, &used, name);
+        categories[i].field = add_field(strings, &used, EVENT_CATEGORY_FIELD,
+                                        name);
+    }
+    /* Group the events by category, keeping yaml order within it */
+    n = 0;
+    n_segments = 0;
+    for(i = 0; i < st->n_categories; i++)
+    {
+        categories[i].first = n;
+        for(j = 0; j < st->n_events; j++)
+        {
+            if(st->categories_of[j] != i) {
+                continue;
+            }
+            events[n].name = add_string(strings, &used,
+                                        staging_str(st, st->names[j]));
+            events[n].severity = add_string(strings, &used,
+                                 staging_str(st, st->severities[j]));
+            events[n].description = add_string(strings, &used,
+                                    staging_str(st, st->descriptions[j]));
+            events[n].event_id = st->event_ids[j];
+            events[n].num_of_keys = st->num_of_keys[j];
+            events[n].category = i;
+            events[n].first_segment = n_segments;
+            events[n].n_segments = compile_template(strings,
+                                   events[n].description,
+                                   &segments[n_segments]);
+            events[n].priority = event_fields(st, j, prefix, priority, id);
+            events[n].message_prefix = add_string(strings, &used, prefix);
+            events[n].priority_field = add_string(strings, &used, priority);
+            events[n].id_field = add_string(strings, &used, id);
+            rate_limits(st, j, &events[n].rate_limit, &events[n].rate_burst);
+            events[n].coalesce_window = coalesce_window(st, j);
+            events[n].sample_rate = sample_rate(st, j);
+            n_segments += events[n].n_segments;
+            n++;
+        }
+        categories[i].n_events = n - categories[i].first;
+    }
+    /* Index the event names, first definition of a name wins */
+    for(i = 0; i < (int)hdr->n_events; i++)
+    {
+        const char *name = strings + events[i].name;
+        if(name[0] == '\0') {
+            continue;
+        }
+        bucket = event_name_hash(name) & (n_buckets - 1);
+        while(buckets[bucket] != 0)
+        {
+            if(!strcmp(strings + events[buckets[bucket] - 1].name, name)) {
+                break;
+            }
+            bucket = (bucket + 1) & (n_buckets - 1);
+        }
+        if(buckets[bucket] == 0) {
+            buckets[bucket] = i + 1;
+        }
+    }
+    return hdr;
+}
+
+/* string_valid
+ * Checks the string offset is within the arena of the image.
+ *
+ * Returns TRUE if valid, FALSE otherwise.
+ */
+static int
+string_valid(const struct event_catalog_header *hdr, uint32_t off)
+{
+    return (off < hdr->strings_size);
+}
+
+/* catalog_attach
+ * Validates the catalog image and points catalog sections in to it.
+ *
+ * Returns 0 on success, -1 if the image is not a usable catalog.
+ */
+static int
+catalog_attach(struct event_catalog *cat,
+               const struct event_catalog_header *hdr, size_t size)
+{
+    uint32_t i = 0;
+    if((size < sizeof(*hdr)) ||
+       memcmp(hdr->magic, EVENT_CATALOG_MAGIC, EVENT_CATALOG_MAGIC_SIZE) ||
+       (hdr->version != EVENT_CATALOG_VERSION) || (hdr->size != size)) {
+        return -1;
+    }
+    if((hdr->n_buckets == 0) || (hdr->n_buckets & (hdr->n_buckets - 1)) ||
+       (hdr->n_buckets < hdr->n_events) ||
+       (hdr->events_off + (uint64_t)hdr->n_events *
+            sizeof(struct event_catalog_event) > size) ||
+       (hdr->categories_off + (uint64_t)hdr->n_categories *
+            sizeof(struct event_catalog_category) > size) ||
+       (hdr->buckets_off + (uint64_t)hdr->n_buckets * sizeof(uint32_t) > size) ||
+       (hdr->segments_off + (uint64_t)hdr->n_segments *
+            sizeof(struct event_catalog_segment) > size) ||
+       (hdr->strings_size == 0) ||
+       (hdr->strings_off + (uint64_t)hdr->strings_size > size)) {
+        return -1;
+    }
+    cat->hdr = hdr;
+    cat->events = (const struct event_catalog_event*)
+                  ((const char*)hdr + hdr->events_off);
+    cat->categories = (const struct event_catalog_category*)
+                      ((const char*)hdr + hdr->categories_off);
+    cat->buckets = (const uint32_t*)((const char*)hdr + hdr->buckets_off);
+    cat->segments = (const struct event_catalog_segment*)
+                    ((const char*)hdr + hdr->segments_off);
+    cat->strings = (const char*)hdr + hdr->strings_off;
+    /* Everything we hand out must stay within the image */
+    if(cat->strings[hdr->strings_size - 1] != '\0') {
+        return -1;
+    }
+    for(i = 0; i < hdr->n_events; i++)
+    {
+        if(!string_valid(hdr, cat->events[i].name) ||
+           !string_valid(hdr, cat->events[i].severity) ||
+           !string_valid(hdr, cat->events[i].description) ||
+           !string_valid(hdr, cat->events[i].message_prefix) ||
+           !string_valid(hdr, cat->events[i].priority_field) ||
+           !string_valid(hdr, cat->events[i].id_field) ||
+           (cat->events[i].priority >= MAX_SEV_LEVELS) ||
+           (cat->events[i].category >= hdr->n_categories) ||
+           (cat->events[i].first_segment > hdr->n_segments) ||
+           (cat->events[i].n_segments >
+            (hdr->n_segments - cat->events[i].first_segment))) {
+            return -1;
+        }
+    }
+    for(i = 0; i < hdr->n_segments; i++)
+    {
+        if((cat->segments[i].off > hdr->strings_size) ||
+           (cat->segments[i].len > (hdr->strings_size - cat->segments[i].off))) {
+            return -1;
+        }
+    }
+    for(i = 0; i < hdr->n_categories; i++)
+    {
+        if(!string_valid(hdr, cat->categories[i].name) ||
+           !string_valid(hdr, cat->categories[i].field) ||
+           (cat->categories[i].first > hdr->n_events) ||
+           (cat->categories[i].n_events >
+            (hdr->n_events - cat->categories[i].first))) {
+            return -1;
+        }
+    }
+    for(i = 0; i < hdr->n_buckets; i++)
+    {
+        if(cat->buckets[i] > hdr->n_events) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* map_catalog_file
+ * Maps the compiled catalog read-only, provided it was built from
+ * the yaml file we have. When the yaml file can't be read the
+ * compiled catalog is used as is.
+ *
+ * Returns 0 on success, -1 if the catalog is missing or stale.
+ */
+static int
+map_catalog_file(struct event_catalog *cat, const char *path,
+                 int have_yaml, uint64_t yaml_hash)
+{
+    struct stat st;
+    void *image = NULL;
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) {
+        return -1;
+    }
+    if((fstat(fd, &st) < 0) || (st.st_size <= 0)) {
+        close(fd);
+        return -1;
+    }
+    image = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(image == MAP_FAILED) {
+        return -1;
+    }
+    if(catalog_attach(cat, image, st.st_size) < 0) {
+        VLOG_WARN("Ignoring invalid event catalog %s", path);
+        munmap(image, st.st_size);
+        return -1;
+    }
+    if(have_yaml && (cat->hdr->yaml_hash != yaml_hash)) {
+        VLOG_INFO("Event catalog %s is stale, using yaml file", path);
+        munmap(image, st.st_size);
+        return -1;
+    }
+    cat->mapped = TRUE;
+    return 0;
+}
+
+/* shm_catalog_name
+ * Names the shared memory segment of the catalog built from the yaml
+ * file with the given hash.
+ */
+static void
+shm_catalog_name(char *name, size_t size, uint64_t yaml_hash)
+{
+    snprintf(name, size, EVENT_CATALOG_SHM_NAME, EVENT_CATALOG_VERSION,
+             (unsigned long long)yaml_hash);
+}
+
+/* event_catalog_shm_name
+ * Names the shared memory segment a catalog built from the yaml file
+ * at yaml_path is published in.
+ *
+ * Returns 0 on success, -1 if the yaml file can't be read.
+ */
+int
+event_catalog_shm_name(const char *yaml_path, char *name, size_t size)
+{
+    unsigned char *yaml_data = NULL;
+    size_t yaml_len = 0;
+    if(read_file(yaml_path, &yaml_data, &yaml_len) < 0) {
+        return -1;
+    }
+    shm_catalog_name(name, size, yaml_file_hash(yaml_data, yaml_len));
+    free(yaml_data);
+    return 0;
+}
+
+/* discard_catalog_shm
+ * Unlinks a segment attach_catalog_shm() found unusable, if nobody is
+ * publishing in it. publish_catalog_shm() holds the segment locked
+ * from before it sizes it until the image is complete, so an unlocked
+ * segment with no magic was left by a publisher which died. An empty
+ * segment may belong to a publisher about to lock it, it is only taken
+ * as abandoned once EVENT_CATALOG_SHM_GRACE seconds old. Left in
+ * place, an abandoned segment would keep every process building its
+ * own copy of the catalog.
+ */
+static void
+discard_catalog_shm(int fd, const char *name, const struct stat *st)
+{
+    if((st->st_size == 0) &&
+       (time(NULL) - st->st_ctime < EVENT_CATALOG_SHM_GRACE)) {
+        return;
+    }
+    if(flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        return;
+    }
+    VLOG_WARN("Removing abandoned event catalog in shared memory %s", name);
+    shm_unlink(name);
+}
+
+/* attach_catalog_shm
+ * Maps the catalog another process published in shared memory for
+ * the yaml file we have. A segment not owned by us or root, or
+ * writable by others is ignored. One still being written is ignored,
+ * & removed if its publisher is gone, see discard_catalog_shm().
+ *
+ * Returns 0 on success, -1 if there is no usable segment.
+ */
+static int
+attach_catalog_shm(struct event_catalog *cat, uint64_t yaml_hash)
+{
+    char name[EVENT_CATALOG_SHM_NAME_SIZE];
+    struct stat st;
+    void *image = NULL;
+    uint64_t magic = 0;
+    int fd = 0;
+    shm_catalog_name(name, sizeof(name), yaml_hash);
+    fd = shm_open(name, O_RDONLY, 0);
+    if(fd < 0) {
+        return -1;
+    }
+    if((fstat(fd, &st) < 0) ||
+       ((st.st_uid != 0) && (st.st_uid != geteuid())) ||
+       (st.st_mode & (S_IWGRP | S_IWOTH))) {
+        close(fd);
+        return -1;
+    }
+    if(st.st_size < (off_t)sizeof(*cat->hdr)) {
+        discard_catalog_shm(fd, name, &st);
+        close(fd);
+        return -1;
+    }
+    image = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if(image == MAP_FAILED) {
+        close(fd);
+        return -1;
+    }
+    /* The magic is written last, see publish_catalog_shm() */
+    memcpy(&magic, EVENT_CATALOG_MAGIC, sizeof(magic));
+    if(__atomic_load_n((uint64_t*)image, __ATOMIC_ACQUIRE) != magic) {
+        discard_catalog_shm(fd, name, &st);
+        munmap(image, st.st_size);
+        close(fd);
+        return -1;
+    }
+    if((catalog_attach(cat, image, st.st_size) < 0) ||
+       (cat->hdr->yaml_hash != yaml_hash)) {
+        VLOG_WARN("Ignoring invalid event catalog in shared memory %s", name);
+        discard_catalog_shm(fd, name, &st);
+        munmap(image, st.st_size);
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    cat->mapped = TRUE;
+    return 0;
+}
+
+/* publish_catalog_shm
+ * Publishes the catalog image built from the yaml file in a read-only
+ * shared memory segment, unless another process already did. The
+ * magic is written once the rest of the image is, so that processes
+ * attaching meanwhile build their own copy instead of using half of
+ * one. The segment is locked until then, telling them it is not
+ * abandoned.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+static int
+publish_catalog_shm(const struct event_catalog_header *hdr)
+{
+    char name[EVENT_CATALOG_SHM_NAME_SIZE];
+    char *image = NULL;
+    uint64_t magic = 0;
+    int fd = 0;
+    shm_catalog_name(name, sizeof(name), hdr->yaml_hash);
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0444);
+    if(fd < 0) {
+        return -1;
+    }
+    if((flock(fd, LOCK_EX) < 0) || (ftruncate(fd, hdr->size) < 0)) {
+        shm_unlink(name);
+        close(fd);
+        return -1;
+    }
+    image = mmap(NULL, hdr->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(image == MAP_FAILED) {
+        shm_unlink(name);
+        close(fd);
+        return -1;
+    }
+    memcpy(image + EVENT_CATALOG_MAGIC_SIZE,
+           (const char*)hdr + EVENT_CATALOG_MAGIC_SIZE,
+           hdr->size - EVENT_CATALOG_MAGIC_SIZE);
+    memcpy(&magic, hdr->magic, sizeof(magic));
+    __atomic_store_n((uint64_t*)image, magic, __ATOMIC_RELEASE);
+    munmap(image, hdr->size);
+    /* Closing the last descriptor drops the lock */
+    close(fd);
+    return 0;
+}
+
+/* catalog_load
+ * Loads the event catalog in to cat. The compiled catalog is
+ * preferred, then the one published in shared memory by another
+ * process for the same yaml file. The yaml file is parsed only as a
+ * last resort, & what is built from it published in turn.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+static int
+catalog_load(struct event_catalog *cat)
+{
+    struct staging *st = NULL;
+    struct event_catalog_header *hdr = NULL;
+    unsigned char *yaml_data = NULL;
+    size_t yaml_len = 0;
+    uint64_t yaml_hash = 0;
+    char *yaml_path = NULL, *catalog_path = NULL;
+    int have_yaml = FALSE, ret = -1;
+
+    yaml_path = install_path(EVENT_YAML_FILE);
+    catalog_path = install_path(EVENT_CATALOG_FILE);
+    if((yaml_path == NULL) || (catalog_path == NULL)) {
+        goto done;
+    }
+    if(read_file(yaml_path, &yaml_data, &yaml_len) == 0) {
+        have_yaml = TRUE;
+        yaml_hash = yaml_file_hash(yaml_data, yaml_len);
+    }
+    if(map_catalog_file(cat, catalog_path, have_yaml, yaml_hash) == 0) {
+        ret = 0;
+        goto done;
+    }
+    if(!have_yaml) {
+        VLOG_ERR("YAML file (%s) open failed", yaml_path);
+        goto done;
+    }
+    if(attach_catalog_shm(cat, yaml_hash) == 0) {
+        ret = 0;
+        goto done;
+    }
+    st = (struct staging*)calloc(1, sizeof(*st));
+    if(st == NULL) {
+        goto done;
+    }
+    if(parse_event_yaml(yaml_data, yaml_len, st) == 0) {
+        hdr = build_catalog(st, yaml_hash);
+    }
+    free_staging(st);
+    free(st);
+    if(hdr == NULL) {
+        VLOG_ERR("Failed to load events from %s", yaml_path);
+        goto done;
+    }
+    /* Share what we built, falling back to our own copy if another
+     * process beat us to it or shared memory isn't usable */
+    if((publish_catalog_shm(hdr) == 0) &&
+       (attach_catalog_shm(cat, yaml_hash) == 0)) {
+        free(hdr);
+        ret = 0;
+        goto done;
+    }
+    if(catalog_attach(cat, hdr, hdr->size) < 0) {
+        free(hdr);
+        goto done;
+    }
+    cat->mapped = FALSE;
+    ret = 0;
+
+done:
+    free(yaml_data);
+    free(yaml_path);
+    free(catalog_path);
+    return ret;
+}
+
+/* event_catalog_load
+ * Loads the event catalog once per process, see catalog_load().
+ * Callers serialize calls, event_log_init() does so under its lock.
+ *
+ * Returns the catalog on success, NULL on failure.
+ */
+const struct event_catalog *
+event_catalog_load(void)
+{
+    if(!catalog_loaded && (catalog_load(&catalog) == 0)) {
+        catalog_loaded = TRUE;
+    }
+    return (catalog_loaded ? &catalog : NULL);
+}
+
+/* event_catalog_reload
+ * Loads the event catalog again, as a new catalog alongside the one
+ * loaded so far which is left as is.
+ *
+ * Returns the catalog on success, NULL on failure.
+ */
+struct event_catalog *
+event_catalog_reload(void)
+{
+    struct event_catalog *cat = NULL;
+    cat = (struct event_catalog*)calloc(1, sizeof(*cat));
+    if(cat == NULL) {
+        return NULL;
+    }
+    if(catalog_load(cat) < 0) {
+        free(cat);
+        return NULL;
+    }
+    return cat;
+}
+
+/* event_catalog_unpublish
+ * Unlinks the shared memory segment of a catalog a reload replaced,
+ * if it was published. Processes which mapped it keep their mapping,
+ * those starting later build the catalog of the current yaml file.
+ */
+void
+event_catalog_unpublish(const struct event_catalog *cat)
+{
+    char name[EVENT_CATALOG_SHM_NAME_SIZE];
+    shm_catalog_name(name, sizeof(name), cat->hdr->yaml_hash);
+    shm_unlink(name);
+}
+
+/* event_catalog_free
+ * Releases a catalog which nobody uses, from event_catalog_reload() or
+ * the one event_catalog_load() loaded once a reload replaced it.
+ */
+void
+event_catalog_free(struct event_catalog *cat)
+{
+    if(cat->mapped) {
+        munmap((void*)cat->hdr, cat->hdr->size);
+    }
+    else {
+        free((void*)cat->hdr);
+    }
+    if(cat == &catalog) {
+        memset(&catalog, 0, sizeof(catalog));
+        catalog_loaded = FALSE;
+        return;
+    }
+    free(cat);
+}
+
+/* event_catalog_find
+ * Looks up the event name in the catalog hash index.
+ *
+ * Returns event index on success, -1 on failure.
+ */
+int
+event_catalog_find(const struct event_catalog *cat, const char *name)
+{
+    uint32_t mask = cat->hdr->n_buckets - 1;
+    uint32_t bucket = event_name_hash(name) & mask;
+    uint32_t probes = 0, index = 0;
+    /* Probe till we either match the event name or hit an empty bucket */
+    while((probes <= mask) && ((index = cat->buckets[bucket]) != 0))
+    {
+        if(!strcmp(name, event_catalog_str(cat, cat->events[index-1].name))) {
+            return (index - 1);
+        }
+        bucket = (bucket + 1) & mask;
+        probes++;
+    }
+    return -1;
+}
+
+/* event_catalog_find_category
+ * Looks up the category by name.
+ *
+ * Returns category index on success, -1 on failure.
+ */
+int
+event_catalog_find_category(const struct event_catalog *cat,
+                            const char *name)
+{
+    uint32_t i = 0;
+    for(i = 0; i < cat->hdr->n_categories; i++)
+    {
+        if(!strcmp(name, event_catalog_str(cat, cat->categories[i].name))) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* find_key_value
+ * Finds the "key=value" pair for the key of a placeholder. When the
+ * same key is passed more than once the first one is used.
+ *
+ * Returns the value on success, NULL if the key was not passed.
+ */
+static const char *
+find_key_value(const char *key, uint32_t len, char **kv, int n_kv)
+{
+    int i = 0;
+    for(i = 0; i < n_kv; i++)
+    {
+        if((kv[i] != NULL) && !strncmp(kv[i], key, len) &&
+           (kv[i][len] == '=')) {
+            return (kv[i] + len + 1);
+        }
+    }
+    return NULL;
+}
+
+/* event_catalog_render
+ * Renders the description of the event at index in to buf in a
+ * single pass over its template segments, substituting each {key}
+ * with the value of the matching "key=value" pair. A value ends at
+ * the next '=', placeholders for keys not passed are left as is. As
+ * with snprintf(), the message is truncated to fit in buf, nothing is
+ * written if size is 0.
+ *
+ * Returns length of the whole message, size or more if it didn't fit.
+ */
+int
+event_catalog_render(const struct event_catalog *cat, int index,
+                     char **kv, int n_kv, char *buf, size_t size)
+{
+    const struct event_catalog_event *ev = &cat->events[index];
+    const struct event_catalog_segment *seg = NULL;
+    const char *src = NULL;
+    size_t used = 0, len = 0, copy = 0;
+    uint32_t i = 0;
+    for(i = 0; i < ev->n_segments; i++)
+    {
+        seg = &cat->segments[ev->first_segment + i];
+        src = cat->strings + seg->off;
+        len = seg->len;
+        if(seg->kind == EVENT_SEGMENT_KEY) {
+            const char *value = find_key_value(src, seg->len, kv, n_kv);
+            if(value != NULL) {
+                src = value;
+                len = strcspn(value, "=");
+            }
+            else {
+                /* Keep the braces around the key */
+                src -= 1;
+                len += 2;
+            }
+        }
+        if(used < size) {
+            copy = (len < (size - 1 - used)) ? len : (size - 1 - used);
+            memcpy(buf + used, src, copy);
+        }
+        used += len;
+    }
+    if(size > 0) {
+        buf[(used < size) ? used : (size - 1)] = '\0';
+    }
+    return used;
+}
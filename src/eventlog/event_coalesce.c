@@ -0,0 +1,280 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*************************************************************************//**
+ * @ingroup ops_supportability
+ * This module coalesces the duplicate events of the event log part of
+ * supportability library, so that a daemon logging the same event with
+ * the same key values over & over costs one journal write per window
+ * rather than one per event. Events without a coalescing window never
+ * take the lock, the check runs before log_event() renders anything.
+ *
+ * @file
+ * Source file for the duplicate event coalescing of supportability
+ * library.
+ *
+ ****************************************************************************/
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "eventlog.h"
+#include "event_catalog.h"
+#include "event_coalesce.h"
+
+#define NSEC_PER_SEC 1000000000ULL
+
+/* monotonic_ns
+ * Returns the monotonic clock in nanoseconds.
+ */
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * NSEC_PER_SEC) + ts.tv_nsec;
+}
+
+/* coalesce_hash
+ * FNV-1a hash of the event ID & its "key=value" strings.
+ *
+ * Returns the hash value.
+ */
+static uint64_t
+coalesce_hash(int event_id, char **kv, int n_kv)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    const unsigned char *p = NULL;
+    int i = 0;
+    for(i = 0; i < (int)sizeof(event_id); i++)
+    {
+        hash ^= (unsigned char)(event_id >> (8*i));
+        hash *= 1099511628211ULL;
+    }
+    for(i = 0; i < n_kv; i++)
+    {
+        p = (const unsigned char*)kv[i];
+        do {
+            hash ^= *p;
+            hash *= 1099511628211ULL;
+        } while(*p++);
+    }
+    return hash;
+}
+
+/* coalesce_due
+ * Makes the window of the slot the next one to close with repeats to
+ * report if it closes first. Called with the lock held.
+ */
+static void
+coalesce_due(struct event_coalesce *co, const struct event_coalesce_slot *slot)
+{
+    uint64_t due = __atomic_load_n(&co->next_due, __ATOMIC_RELAXED);
+    if((due == 0) || (slot->window_end < due)) {
+        __atomic_store_n(&co->next_due, slot->window_end, __ATOMIC_RELAXED);
+    }
+}
+
+/* coalesce_report
+ * Fills in the report of the repeats counted in the window of the slot.
+ */
+static void
+coalesce_report(const struct event_coalesce_slot *slot,
+                struct event_coalesce_report *report)
+{
+    report->index = slot->index;
+    report->repeats = slot->repeats;
+    report->seconds = (slot->window_end - slot->window_start) / NSEC_PER_SEC;
+}
+
+/* event_coalesce_init
+ * Sets up the coalescing windows of a catalog, all closed.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int
+event_coalesce_init(struct event_coalesce *co)
+{
+    co->slots = (struct event_coalesce_slot*)calloc(EVENT_COALESCE_SLOTS,
+                                                    sizeof(*co->slots));
+    if(co->slots == NULL) {
+        return -1;
+    }
+    co->next_due = 0;
+    return pthread_mutex_init(&co->mutex, NULL) ? -1 : 0;
+}
+
+/* event_coalesce_check
+ * Looks for an open window of the event with the same key values. A
+ * repeat within it is counted, otherwise a window is opened for the
+ * event when there is a slot for it. If the window found has closed
+ * with repeats counted, they are handed back in report to be reported
+ * before the event is logged.
+ *
+ * Returns TRUE if the event may be logged, FALSE if coalesced.
+ */
+int
+event_coalesce_check(struct event_coalesce *co,
+                     const struct event_catalog *catalog, int index,
+                     char **kv, int n_kv,
+                     struct event_coalesce_report *report)
+{
+    const struct event_catalog_event *ev = &catalog->events[index];
+    struct event_coalesce_slot *slot = NULL, *open = NULL;
+    uint64_t hash = 0, now = 0;
+    int i = 0;
+
+    report->repeats = 0;
+    if(ev->coalesce_window == 0) {
+        return TRUE;
+    }
+    hash = coalesce_hash(ev->event_id, kv, n_kv);
+    now = monotonic_ns();
+    pthread_mutex_lock(&co->mutex);
+    for(i = 0; i < EVENT_COALESCE_PROBES; i++)
+    {
+        slot = &co->slots[(hash + i) & (EVENT_COALESCE_SLOTS - 1)];
+        if(slot->window_end && (slot->hash == hash) &&
+           (slot->index == index)) {
+            if(now < slot->window_end) {
+                if(++slot->repeats == 1) {
+                    coalesce_due(co, slot);
+                }
+                pthread_mutex_unlock(&co->mutex);
+                return FALSE;
+            }
+            if(slot->repeats) {
+                coalesce_report(slot, report);
+            }
+            open = slot;
+            break;
+        }
+        if((open == NULL) &&
+           ((slot->window_end == 0) ||
+            ((now >= slot->window_end) && (slot->repeats == 0)))) {
+            open = slot;
+        }
+    }
+    /* With no slot left the event is logged, just not coalesced */
+    if(open != NULL) {
+        open->hash = hash;
+        open->index = index;
+        open->window_start = now;
+        open->window_end = now + (ev->coalesce_window * NSEC_PER_SEC);
+        open->repeats = 0;
+    }
+    pthread_mutex_unlock(&co->mutex);
+    return TRUE;
+}
+
+/* event_coalesce_report_due
+ * Closes the windows which have ended, handing back the repeats
+ * counted in up to max of them. Only one caller at a time gets them,
+ * the others go on without waiting.
+ *
+ * Returns the number of reports, 0 if there is nothing to report yet.
+ */
+int
+event_coalesce_report_due(struct event_coalesce *co,
+                          struct event_coalesce_report *reports, int max)
+{
+    struct event_coalesce_slot *slot = NULL;
+    uint64_t due = 0, now = 0, next = 0;
+    int i = 0, n = 0;
+
+    due = __atomic_load_n(&co->next_due, __ATOMIC_RELAXED);
+    if(due == 0) {
+        return 0;
+    }
+    now = monotonic_ns();
+    if((now < due) || pthread_mutex_trylock(&co->mutex)) {
+        return 0;
+    }
+    for(i = 0; i < EVENT_COALESCE_SLOTS; i++)
+    {
+        slot = &co->slots[i];
+        if(slot->window_end == 0) {
+            continue;
+        }
+        if(now < slot->window_end) {
+            if(slot->repeats && ((next == 0) || (slot->window_end < next))) {
+                next = slot->window_end;
+            }
+            continue;
+        }
+        if(slot->repeats) {
+            if(n == max) {
+                /* Left for the next call */
+                next = now;
+                continue;
+            }
+            coalesce_report(slot, &reports[n++]);
+        }
+        slot->window_end = 0;
+        slot->repeats = 0;
+    }
+    __atomic_store_n(&co->next_due, next, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&co->mutex);
+    return n;
+}
+
+/* event_coalesce_carry
+ * Carries the open windows over to the coalescing state of a reloaded
+ * catalog, matching the events by name as their indexes may have
+ * changed. Windows carried are closed in the old state, so that their
+ * repeats are only reported once.
+ */
+void
+event_coalesce_carry(struct event_coalesce *co,
+                     const struct event_catalog *catalog,
+                     struct event_coalesce *old,
+                     const struct event_catalog *old_catalog)
+{
+    struct event_coalesce_slot *from = NULL, *to = NULL;
+    int i = 0, j = 0, index = 0;
+
+    pthread_mutex_lock(&old->mutex);
+    for(i = 0; i < EVENT_COALESCE_SLOTS; i++)
+    {
+        from = &old->slots[i];
+        if(from->window_end == 0) {
+            continue;
+        }
+        index = event_catalog_find(catalog, event_catalog_str(old_catalog,
+                                   old_catalog->events[from->index].name));
+        if(index < 0) {
+            continue;
+        }
+        for(j = 0; j < EVENT_COALESCE_PROBES; j++)
+        {
+            to = &co->slots[(from->hash + j) & (EVENT_COALESCE_SLOTS - 1)];
+            if(to->window_end == 0) {
+                *to = *from;
+                to->index = index;
+                if(to->repeats) {
+                    coalesce_due(co, to);
+                }
+                from->window_end = 0;
+                from->repeats = 0;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&old->mutex);
+}
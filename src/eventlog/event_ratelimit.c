@@ -0,0 +1,171 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*************************************************************************//**
+ * @ingroup ops_supportability
+ * This module rate limits the events of the event log part of
+ * supportability library, so that an event storm doesn't flood
+ * journald. The check is lock free and runs before log_event()
+ * renders anything.
+ *
+ * @file
+ * Source file for the event rate limit of supportability library.
+ *
+ ****************************************************************************/
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include "eventlog.h"
+#include "event_catalog.h"
+#include "event_ratelimit.h"
+
+#define NSEC_PER_SEC 1000000000ULL
+
+/* monotonic_ns
+ * Returns the monotonic clock in nanoseconds.
+ */
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * NSEC_PER_SEC) + ts.tv_nsec;
+}
+
+/* event_ratelimit_init
+ * Sets up the rate limit state of every event of the catalog.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int
+event_ratelimit_init(struct event_ratelimit *rl,
+                     const struct event_catalog *catalog)
+{
+    rl->events = (struct event_rate_state*)calloc(
+                 catalog->hdr->n_events + 1, sizeof(*rl->events));
+    if(rl->events == NULL) {
+        return -1;
+    }
+    rl->pending = 0;
+    rl->first_pending = 0;
+    return 0;
+}
+
+/* ratelimit_suppress
+ * Counts an event over its limit as suppressed, & pending a report.
+ */
+static void
+ratelimit_suppress(struct event_ratelimit *rl, struct event_rate_state *state,
+                   uint64_t now)
+{
+    __atomic_add_fetch(&state->suppressed, 1, __ATOMIC_RELAXED);
+    if(__atomic_fetch_add(&rl->pending, 1, __ATOMIC_RELAXED) == 0) {
+        __atomic_store_n(&rl->first_pending, now, __ATOMIC_RELAXED);
+    }
+}
+
+/* event_ratelimit_throttled
+ * Checks the bucket of the event without taking a token from it, for
+ * event_log_enabled() to skip formatting the keys of an event which
+ * log_event() would suppress. An event over its limit is counted as
+ * suppressed here, as log_event() won't see it.
+ *
+ * Returns TRUE if the event is over its limit, FALSE otherwise.
+ */
+int
+event_ratelimit_throttled(struct event_ratelimit *rl,
+                          const struct event_catalog *catalog, int index)
+{
+    const struct event_catalog_event *ev = &catalog->events[index];
+    struct event_rate_state *state = &rl->events[index];
+    uint64_t now = 0, tat = 0, interval = 0, tolerance = 0;
+    if(ev->rate_limit == 0) {
+        return FALSE;
+    }
+    now = monotonic_ns();
+    interval = NSEC_PER_SEC / ev->rate_limit;
+    tolerance = (ev->rate_burst > 1) ? (interval * (ev->rate_burst - 1)) : 0;
+    tat = __atomic_load_n(&state->tat, __ATOMIC_RELAXED);
+    if((tat <= now) || ((tat - now) <= tolerance)) {
+        return FALSE;
+    }
+    ratelimit_suppress(rl, state, now);
+    return TRUE;
+}
+
+/* event_ratelimit_check
+ * Takes a token from the bucket of the event. An event over its
+ * limit is counted as suppressed.
+ *
+ * Returns TRUE if the event may be logged, FALSE if suppressed.
+ */
+int
+event_ratelimit_check(struct event_ratelimit *rl,
+                      const struct event_catalog *catalog, int index)
+{
+    const struct event_catalog_event *ev = &catalog->events[index];
+    struct event_rate_state *state = &rl->events[index];
+    uint64_t now = 0, tat = 0, interval = 0, tolerance = 0, next = 0;
+    if(ev->rate_limit == 0) {
+        return TRUE;
+    }
+    now = monotonic_ns();
+    interval = NSEC_PER_SEC / ev->rate_limit;
+    tolerance = (ev->rate_burst > 1) ? (interval * (ev->rate_burst - 1)) : 0;
+    tat = __atomic_load_n(&state->tat, __ATOMIC_RELAXED);
+    do {
+        next = (tat > now) ? tat : now;
+        if((next - now) > tolerance) {
+            ratelimit_suppress(rl, state, now);
+            return FALSE;
+        }
+        next += interval;
+    } while(!__atomic_compare_exchange_n(&state->tat, &tat, next, TRUE,
+                                         __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return TRUE;
+}
+
+/* event_ratelimit_report_due
+ * Checks whether suppressed events are due to be reported, only one
+ * caller gets the count of them.
+ *
+ * Returns the number of events to report & the seconds they span,
+ * 0 if there is nothing to report yet.
+ */
+unsigned long
+event_ratelimit_report_due(struct event_ratelimit *rl, unsigned int *seconds)
+{
+    uint64_t now = 0, first = 0;
+    unsigned long count = 0;
+    if(__atomic_load_n(&rl->pending, __ATOMIC_RELAXED) == 0) {
+        return 0;
+    }
+    now = monotonic_ns();
+    first = __atomic_load_n(&rl->first_pending, __ATOMIC_RELAXED);
+    if((now - first) < (EVENT_SUPPRESSED_REPORT_INTERVAL * NSEC_PER_SEC)) {
+        return 0;
+    }
+    /* Moving the window forward elects the thread which reports */
+    if(!__atomic_compare_exchange_n(&rl->first_pending, &first, now, FALSE,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    count = __atomic_exchange_n(&rl->pending, 0, __ATOMIC_RELAXED);
+    *seconds = (now - first) / NSEC_PER_SEC;
+    return count;
+}
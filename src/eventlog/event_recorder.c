@@ -0,0 +1,212 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*************************************************************************//**
+ * @ingroup ops_supportability
+ * This module keeps the flight recorder of the event log part of
+ * supportability library, a ring of the last events the daemon logged
+ * stored as binary records. Nothing is rendered when an event is
+ * recorded, that is only done when the ring is dumped through
+ * diag-dump, or offline from a core file by ops_eventrecorder.py.
+ *
+ * @file
+ * Source file for the event flight recorder of supportability library.
+ *
+ ****************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include "eventlog.h"
+#include "event_catalog.h"
+#include "event_recorder.h"
+
+/* Not static so that it can be found by symbol in a core file */
+struct event_recorder ops_event_recorder;
+
+/* event_recorder_init
+ * Fills in the header of the ring, records are only ever added after
+ * it is set up by event_log_init().
+ */
+void
+event_recorder_init(void)
+{
+    struct event_recorder *rec = &ops_event_recorder;
+    rec->version = EVENT_RECORDER_VERSION;
+    rec->record_size = sizeof(struct event_recorder_record);
+    rec->n_records = EVENT_RECORDER_RECORDS;
+    rec->pid = getpid();
+    memcpy(rec->magic, EVENT_RECORDER_MAGIC, EVENT_RECORDER_MAGIC_SIZE);
+}
+
+/* event_recorder_add
+ * Records the event with its "key=value" strings copied as they are,
+ * overwriting the oldest record once the ring is full. Writers take
+ * their record with a single atomic add & claim its slot by marking it
+ * busy. A writer a full lap behind another on the same slot gives up
+ * rather than wait, the slot keeps the newer record. A record reads as
+ * written only once its seq is stored, after everything else.
+ */
+void
+event_recorder_add(int event_id, char **kv, int n_kv)
+{
+    struct event_recorder_record *r = NULL;
+    struct timespec now;
+    uint64_t seq = 0, old = 0;
+    size_t size = 0, len = 0;
+    int i = 0, n_keys = 0;
+
+    seq = __atomic_fetch_add(&ops_event_recorder.next, 1, __ATOMIC_RELAXED);
+    r = &ops_event_recorder.records[seq & (EVENT_RECORDER_RECORDS - 1)];
+    old = __atomic_load_n(&r->seq, __ATOMIC_RELAXED);
+    do {
+        if((old == EVENT_RECORDER_BUSY) || (old > seq)) {
+            return;
+        }
+    } while(!__atomic_compare_exchange_n(&r->seq, &old, EVENT_RECORDER_BUSY,
+                                         TRUE, __ATOMIC_ACQUIRE,
+                                         __ATOMIC_RELAXED));
+    /* Readers must see the slot busy before any of the new record. */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    clock_gettime(CLOCK_REALTIME, &now);
+    r->timestamp = ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+    r->event_id = event_id;
+    for(i = 0; (i < n_kv) && (size < EVENT_RECORDER_DATA_SIZE - 1); i++)
+    {
+        len = strlen(kv[i]);
+        if(len > (EVENT_RECORDER_DATA_SIZE - 1 - size)) {
+            len = EVENT_RECORDER_DATA_SIZE - 1 - size;
+        }
+        memcpy(r->data + size, kv[i], len);
+        r->data[size + len] = '\0';
+        size += len + 1;
+        n_keys++;
+    }
+    r->n_keys = n_keys;
+    r->size = size;
+    __atomic_store_n(&r->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+/* recorder_find_event
+ * Looks up the catalog event with the given ID.
+ *
+ * Returns event index on success, -1 on failure.
+ */
+static int
+recorder_find_event(const struct event_catalog *catalog, int event_id)
+{
+    uint32_t i = 0;
+    for(i = 0; i < catalog->hdr->n_events; i++)
+    {
+        if(catalog->events[i].event_id == event_id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* recorder_print
+ * Prints a line for the record, rendered the way log_event() renders
+ * the message of the event if it is in the catalog, on heap if it is
+ * too long for the stack.
+ */
+static void
+recorder_print(FILE *fp, const struct event_catalog *catalog,
+               const struct event_recorder_record *r)
+{
+    char message[MAX_LOG_STR], *long_message = NULL;
+    char when[EVENT_FIELD_SIZE] = "-";
+    char *kv[MAX_EVENT_KEYS];
+    time_t secs = r->timestamp / 1000000;
+    struct tm tm;
+    size_t off = 0, len = 0;
+    int i = 0, n_kv = 0, index = -1;
+
+    if(localtime_r(&secs, &tm)) {
+        strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+    }
+    for(i = 0; (i < r->n_keys) && (i < MAX_EVENT_KEYS) &&
+               (off < r->size); i++)
+    {
+        kv[n_kv++] = (char*)r->data + off;
+        off += strlen(r->data + off) + 1;
+    }
+    if(catalog) {
+        index = recorder_find_event(catalog, r->event_id);
+    }
+    if(index < 0) {
+        fprintf(fp, "%s.%06u ops-evt|%d|", when,
+                (unsigned int)(r->timestamp % 1000000), r->event_id);
+        for(i = 0; i < n_kv; i++)
+        {
+            fprintf(fp, "%s%s", i ? " " : "", kv[i]);
+        }
+        fprintf(fp, "\n");
+        return;
+    }
+    len = event_catalog_render(catalog, index, kv, n_kv, message,
+                               sizeof(message));
+    if(len >= sizeof(message)) {
+        long_message = (char*)malloc(len + 1);
+        if(long_message != NULL) {
+            event_catalog_render(catalog, index, kv, n_kv, long_message,
+                                 len + 1);
+        }
+    }
+    fprintf(fp, "%s.%06u ops-evt|%d|%s|%s\n", when,
+            (unsigned int)(r->timestamp % 1000000), r->event_id,
+            event_catalog_str(catalog, catalog->events[index].severity),
+            long_message ? long_message : message);
+    free(long_message);
+}
+
+/* event_recorder_dump
+ * Prints the recorded events oldest first. Records being overwritten
+ * while they are read are skipped.
+ */
+void
+event_recorder_dump(FILE *fp, const struct event_catalog *catalog)
+{
+    struct event_recorder_record r;
+    const struct event_recorder_record *slot = NULL;
+    uint64_t next = 0, seq = 0;
+
+    next = __atomic_load_n(&ops_event_recorder.next, __ATOMIC_RELAXED);
+    seq = (next > EVENT_RECORDER_RECORDS) ? next - EVENT_RECORDER_RECORDS : 0;
+    fprintf(fp, "Flight recorder: %llu events logged, last %llu:\n",
+            (unsigned long long)next, (unsigned long long)(next - seq));
+    for(; seq < next; seq++)
+    {
+        slot = &ops_event_recorder.records[seq & (EVENT_RECORDER_RECORDS - 1)];
+        if(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != seq + 1) {
+            continue;
+        }
+        memcpy(&r, slot, sizeof(r));
+        /* An acquire load only keeps later accesses after it, the fence
+         * keeps the copy before the recheck of seq. */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if((__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq + 1) ||
+           (r.size > EVENT_RECORDER_DATA_SIZE)) {
+            continue;
+        }
+        r.data[EVENT_RECORDER_DATA_SIZE - 1] = '\0';
+        recorder_print(fp, catalog, &r);
+    }
+}
@@ -0,0 +1,513 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*************************************************************************//**
+ * @ingroup ops_supportability
+ * This module keeps the local spool of the event log part of
+ * supportability library, where events are kept while journal doesn't
+ * take them & replayed from once it does, so that a journald restart
+ * neither stalls the daemon nor loses its events. The spool file is
+ * memory mapped, adding an event is a copy in to it.
+ *
+ * @file
+ * Source file for the local event spool of supportability library.
+ *
+ ****************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <systemd/sd-journal.h>
+#include "eventlog.h"
+#include "event_spool.h"
+#include "openvswitch/vlog.h"
+
+VLOG_DEFINE_THIS_MODULE(event_spool);
+
+#define NSEC_PER_SEC 1000000000ULL
+#define NSEC_PER_MSEC 1000000ULL
+#define SPOOL_ALIGN(n) (((n) + 7) & ~(size_t)7)
+/* The ring starts on its own cache line after the header, rejected was
+ * added to version 1 in bytes it left zeroed */
+#define SPOOL_DATA_OFFSET 64
+#define SPOOL_FILE_SIZE (SPOOL_DATA_OFFSET + EVENT_SPOOL_SIZE)
+
+/* Records are added under spool_mutex, which also guards mapping the
+ * file. Only the holder of drain_mutex replays them & moves the tail,
+ * so adding an event never waits for journal. Daemons of the same name,
+ * as Python daemons all are, share the spool file, so each mutex is
+ * paired with a record lock on a byte of the file for the processes
+ * to exclude each other. Record locks are per process & go away with
+ * it, the mutexes exclude the threads of the process. */
+static pthread_mutex_t spool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t drain_mutex = PTHREAD_MUTEX_INITIALIZER;
+#define SPOOL_LOCK_ADD 0
+#define SPOOL_LOCK_DRAIN 1
+static struct event_spool_header *spool = NULL;
+static int spool_fd = -1;           /* Kept open for the record locks */
+static char spool_file[512];
+static uint64_t next_drain = 0;     /* Monotonic ns of the next retry */
+static uint64_t retry_ns = 0;       /* Back off of the next retry */
+static int spool_failed = FALSE;    /* The file could not be created */
+
+/* monotonic_ns
+ * Returns the monotonic clock in nanoseconds.
+ */
+static uint64_t
+monotonic_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * NSEC_PER_SEC) + ts.tv_nsec;
+}
+
+/* spool_lock
+ * Takes the record lock on byte which of the spool file, waiting for
+ * another process to release it if wait is set.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+static int
+spool_lock(int fd, int which, int wait)
+{
+    struct flock fl;
+    int ret = 0;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = F_WRLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = which;
+    fl.l_len = 1;
+    do {
+        ret = fcntl(fd, wait ? F_SETLKW : F_SETLK, &fl);
+    } while((ret < 0) && (errno == EINTR));
+    return ret;
+}
+
+/* spool_unlock
+ * Releases the record lock on byte which of the spool file.
+ */
+static void
+spool_unlock(int fd, int which)
+{
+    struct flock fl;
+    memset(&fl, 0, sizeof(fl));
+    fl.l_type = F_UNLCK;
+    fl.l_whence = SEEK_SET;
+    fl.l_start = which;
+    fl.l_len = 1;
+    fcntl(fd, F_SETLK, &fl);
+}
+
+/* spool_record
+ * Returns the record at byte count pos of the ring.
+ */
+static struct event_spool_record *
+spool_record(struct event_spool_header *sp, uint64_t pos)
+{
+    return (struct event_spool_record*)((char*)sp + SPOOL_DATA_OFFSET +
+                                        (pos % sp->size));
+}
+
+/* spool_valid
+ * Checks that the mapped file is a spool this library can replay.
+ *
+ * Returns TRUE if valid, FALSE otherwise.
+ */
+static int
+spool_valid(const struct event_spool_header *sp)
+{
+    return (!memcmp(sp->magic, EVENT_SPOOL_MAGIC, EVENT_SPOOL_MAGIC_SIZE) &&
+            (sp->version == EVENT_SPOOL_VERSION) &&
+            (sp->size == EVENT_SPOOL_SIZE) && (sp->head >= sp->tail) &&
+            ((sp->head - sp->tail) <= sp->size) &&
+            ((sp->tail % 8) == 0) && ((sp->head % 8) == 0));
+}
+
+/* spool_map
+ * Maps the spool file of the daemon, creating it if create is set. The
+ * directory is set up by ops_supportability_dir.conf, without it events
+ * are not spooled. A file left by a daemon of this name is kept with
+ * the events in it, one which is not a valid spool is started over,
+ * holding both record locks so that no other process uses it
+ * meanwhile. Called with spool_mutex held.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+static int
+spool_map(int create)
+{
+    struct event_spool_header *sp = NULL;
+    struct stat st;
+    int fd = -1;
+
+    fd = open(spool_file, O_RDWR | O_CLOEXEC | (create ? O_CREAT : 0), 0640);
+    if(fd < 0) {
+        return -1;
+    }
+    if((spool_lock(fd, SPOOL_LOCK_ADD, TRUE) < 0) ||
+       (spool_lock(fd, SPOOL_LOCK_DRAIN, TRUE) < 0)) {
+        VLOG_ERR("Failed to lock event spool %s", spool_file);
+        close(fd);
+        return -1;
+    }
+    if((fstat(fd, &st) < 0) ||
+       ((st.st_size != SPOOL_FILE_SIZE) &&
+        (ftruncate(fd, SPOOL_FILE_SIZE) < 0))) {
+        VLOG_ERR("Failed to size event spool %s", spool_file);
+        close(fd);
+        return -1;
+    }
+    sp = (struct event_spool_header*)mmap(NULL, SPOOL_FILE_SIZE,
+                                          PROT_READ | PROT_WRITE,
+                                          MAP_SHARED, fd, 0);
+    if(sp == MAP_FAILED) {
+        VLOG_ERR("Failed to map event spool %s", spool_file);
+        close(fd);
+        return -1;
+    }
+    if(!spool_valid(sp)) {
+        memset(sp, 0, sizeof(*sp));
+        sp->version = EVENT_SPOOL_VERSION;
+        sp->size = EVENT_SPOOL_SIZE;
+        memcpy(sp->magic, EVENT_SPOOL_MAGIC, EVENT_SPOOL_MAGIC_SIZE);
+    }
+    spool_unlock(fd, SPOOL_LOCK_DRAIN);
+    spool_unlock(fd, SPOOL_LOCK_ADD);
+    spool_fd = fd;
+    __atomic_store_n(&spool, sp, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* event_spool_init
+ * Names the spool file after the daemon, under OPENSWITCH_INSTALL_PATH
+ * if set, & maps it if a previous run left one, for the events in it
+ * to be replayed. The file is otherwise only created when the first
+ * event is spooled.
+ */
+void
+event_spool_init(void)
+{
+    const char *prefix = getenv("OPENSWITCH_INSTALL_PATH");
+    pthread_mutex_lock(&spool_mutex);
+    if(spool == NULL) {
+        snprintf(spool_file, sizeof(spool_file), "%s%s/%s%s",
+                 prefix ? prefix : "", EVENT_SPOOL_DIR,
+                 program_invocation_short_name, EVENT_SPOOL_SUFFIX);
+        if((access(spool_file, F_OK) == 0) && (spool_map(FALSE) == 0) &&
+           (spool->head != spool->tail)) {
+            VLOG_INFO("Event spool %s holds events to replay", spool_file);
+        }
+    }
+    pthread_mutex_unlock(&spool_mutex);
+}
+
+/* event_spool_pending
+ * Returns TRUE if the spool holds events not replayed yet.
+ */
+int
+event_spool_pending(void)
+{
+    struct event_spool_header *sp = __atomic_load_n(&spool, __ATOMIC_ACQUIRE);
+    if(sp == NULL) {
+        return FALSE;
+    }
+    return (__atomic_load_n(&sp->head, __ATOMIC_ACQUIRE) !=
+            __atomic_load_n(&sp->tail, __ATOMIC_ACQUIRE));
+}
+
+/* spool_retry_later
+ * Puts off replaying the spool after journal refused an event, from
+ * EVENT_SPOOL_RETRY_MIN doubling up to EVENT_SPOOL_RETRY_MAX while it
+ * keeps refusing them. A short journald restart only costs a few
+ * milliseconds of events going to the spool.
+ */
+static void
+spool_retry_later(uint64_t now)
+{
+    uint64_t retry = __atomic_load_n(&retry_ns, __ATOMIC_RELAXED);
+    if(retry < (EVENT_SPOOL_RETRY_MIN * NSEC_PER_MSEC)) {
+        retry = EVENT_SPOOL_RETRY_MIN * NSEC_PER_MSEC;
+    }
+    __atomic_store_n(&next_drain, now + retry, __ATOMIC_RELAXED);
+    retry *= 2;
+    if(retry > (EVENT_SPOOL_RETRY_MAX * NSEC_PER_MSEC)) {
+        retry = EVENT_SPOOL_RETRY_MAX * NSEC_PER_MSEC;
+    }
+    __atomic_store_n(&retry_ns, retry, __ATOMIC_RELAXED);
+}
+
+/* event_spool_add
+ * Appends the journal fields of an event to the spool, creating the
+ * spool file on first use. A record is never split across the end of
+ * the ring, the space left there is padded & the record goes at the
+ * start. Records not replayed yet are never overwritten. refused is
+ * set when journal refused the event, see spool_retry_later().
+ *
+ * Returns 0 on success, -1 if the event could not be spooled.
+ */
+int
+event_spool_add(const struct iovec *iov, int n_iov, int refused)
+{
+    struct event_spool_header *sp = NULL;
+    struct event_spool_record *rec = NULL;
+    struct timespec now;
+    uint64_t head = 0, tail = 0, pad = 0;
+    size_t need = 0, used = 0;
+    int i = 0, first = FALSE;
+
+    if(n_iov > EVENT_JOURNAL_FIELDS) {
+        n_iov = EVENT_JOURNAL_FIELDS;
+    }
+    for(i = 0; i < n_iov; i++)
+    {
+        need += iov[i].iov_len;
+    }
+    need = SPOOL_ALIGN(sizeof(*rec) + need);
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    pthread_mutex_lock(&spool_mutex);
+    if((spool == NULL) && (spool_file[0] != '\0') && !spool_failed &&
+       (spool_map(TRUE) < 0)) {
+        VLOG_ERR("Failed to open event spool %s, events journal doesn't "
+                 "take are lost", spool_file);
+        spool_failed = TRUE;
+    }
+    sp = spool;
+    if((sp == NULL) || (need > sp->size) ||
+       (spool_lock(spool_fd, SPOOL_LOCK_ADD, TRUE) < 0)) {
+        pthread_mutex_unlock(&spool_mutex);
+        return -1;
+    }
+    head = sp->head;
+    tail = __atomic_load_n(&sp->tail, __ATOMIC_ACQUIRE);
+    if((head % sp->size) + need > sp->size) {
+        pad = sp->size - (head % sp->size);
+    }
+    if((sp->size - (head - tail)) < (pad + need)) {
+        sp->dropped++;
+        spool_unlock(spool_fd, SPOOL_LOCK_ADD);
+        pthread_mutex_unlock(&spool_mutex);
+        return -1;
+    }
+    first = (head == tail);
+    if(pad) {
+        rec = spool_record(sp, head);
+        rec->size = pad;
+        rec->n_fields = 0;
+        rec->flags = EVENT_SPOOL_PAD;
+        head += pad;
+    }
+    rec = spool_record(sp, head);
+    rec->size = need;
+    rec->n_fields = n_iov;
+    rec->flags = 0;
+    rec->timestamp = ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+    for(i = 0; i < n_iov; i++)
+    {
+        memcpy((char*)(rec + 1) + used, iov[i].iov_base, iov[i].iov_len);
+        rec->len[i] = iov[i].iov_len;
+        used += iov[i].iov_len;
+    }
+    sp->spooled++;
+    if(refused) {
+        spool_retry_later(monotonic_ns());
+    }
+    __atomic_store_n(&sp->head, head + need, __ATOMIC_RELEASE);
+    spool_unlock(spool_fd, SPOOL_LOCK_ADD);
+    pthread_mutex_unlock(&spool_mutex);
+    if(first) {
+        VLOG_WARN("Journal not taking events, spooling them to %s",
+                  spool_file);
+    }
+    return 0;
+}
+
+/* event_spool_transient
+ * Checks whether journal refused an event with an error which may go
+ * away, as while journald restarts or its socket is full. Only such
+ * events are spooled & retried.
+ *
+ * Returns TRUE if the error is transient, FALSE otherwise.
+ */
+int
+event_spool_transient(int err)
+{
+    return ((err == -EAGAIN) || (err == -ENOBUFS) ||
+            (err == -ECONNREFUSED) || (err == -ENOENT));
+}
+
+/* spool_replay
+ * Sends a spooled event to journal along with the time it was logged.
+ *
+ * Returns 0 on success, negative errno on failure.
+ */
+static int
+spool_replay(const struct event_spool_record *rec)
+{
+    struct iovec iov[EVENT_JOURNAL_FIELDS + 1];
+    char time_field[EVENT_FIELD_SIZE];
+    size_t used = 0;
+    int i = 0;
+    for(i = 0; (i < rec->n_fields) && (i < EVENT_JOURNAL_FIELDS); i++)
+    {
+        if((used + rec->len[i]) > (rec->size - sizeof(*rec))) {
+            break;
+        }
+        iov[i].iov_base = (char*)(rec + 1) + used;
+        iov[i].iov_len = rec->len[i];
+        used += rec->len[i];
+    }
+    iov[i].iov_base = time_field;
+    iov[i++].iov_len = snprintf(time_field, sizeof(time_field),
+                                EVENT_SPOOL_TIME_FIELD "%llu",
+                                (unsigned long long)rec->timestamp);
+    return sd_journal_sendv(iov, i);
+}
+
+/* event_spool_drain
+ * Replays the spooled events in to journal in the order they were
+ * spooled, until the spool is empty or journal refuses one with a
+ * transient error. An event journal refuses otherwise is dropped &
+ * counted as rejected, as retrying it would hold up the spool. Unless
+ * force is set, journal is not retried before the back off set when it
+ * last refused an event has passed. Only one
+ * caller at a time replays, in any of the processes sharing the spool,
+ * the others go on without waiting.
+ *
+ * Returns 0 if the spool is empty, -1 if events are left in it.
+ */
+int
+event_spool_drain(int force)
+{
+    struct event_spool_header *sp = NULL;
+    struct event_spool_record *rec = NULL;
+    uint64_t head = 0, tail = 0, now = 0;
+    unsigned long replayed = 0, rejected = 0;
+    int ret = 0, err = 0;
+
+    sp = __atomic_load_n(&spool, __ATOMIC_ACQUIRE);
+    if((sp == NULL) || !event_spool_pending()) {
+        return 0;
+    }
+    now = monotonic_ns();
+    if(!force && (now < __atomic_load_n(&next_drain, __ATOMIC_RELAXED))) {
+        return -1;
+    }
+    if(pthread_mutex_trylock(&drain_mutex)) {
+        return -1;
+    }
+    if(spool_lock(spool_fd, SPOOL_LOCK_DRAIN, FALSE) < 0) {
+        pthread_mutex_unlock(&drain_mutex);
+        return -1;
+    }
+    tail = sp->tail;
+    head = __atomic_load_n(&sp->head, __ATOMIC_ACQUIRE);
+    while(tail < head)
+    {
+        rec = spool_record(sp, tail);
+        /* The file may have been left by a daemon which crashed */
+        if((rec->size == 0) || (rec->size % 8) ||
+           (rec->size > sp->size - (tail % sp->size)) ||
+           (!(rec->flags & EVENT_SPOOL_PAD) && (rec->size < sizeof(*rec)))) {
+            VLOG_ERR("Event spool %s is corrupt, %llu bytes of events lost",
+                     spool_file, (unsigned long long)(head - tail));
+            tail = head;
+            break;
+        }
+        if(!(rec->flags & EVENT_SPOOL_PAD)) {
+            err = spool_replay(rec);
+            if(event_spool_transient(err)) {
+                ret = -1;
+                break;
+            }
+            if(err != 0) {
+                rejected++;
+                __atomic_add_fetch(&sp->rejected, 1, __ATOMIC_RELAXED);
+            }
+            else {
+                replayed++;
+                __atomic_add_fetch(&sp->replayed, 1, __ATOMIC_RELAXED);
+            }
+        }
+        tail += rec->size;
+        __atomic_store_n(&sp->tail, tail, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&sp->tail, tail, __ATOMIC_RELEASE);
+    if(ret != 0) {
+        spool_retry_later(now);
+    }
+    else {
+        __atomic_store_n(&retry_ns, 0, __ATOMIC_RELAXED);
+    }
+    spool_unlock(spool_fd, SPOOL_LOCK_DRAIN);
+    pthread_mutex_unlock(&drain_mutex);
+    if(replayed) {
+        VLOG_INFO("Replayed %lu spooled events in to journal%s", replayed,
+                  ret ? ", journal refused the next" : "");
+    }
+    if(rejected) {
+        VLOG_WARN("Dropped %lu spooled events journal rejected", rejected);
+    }
+    return ret;
+}
+
+/* event_log_spool_drain
+ * Replays the spooled events in to journal right away.
+ *
+ * Returns 0 if the spool is empty, -1 if events are left in it.
+ */
+int
+event_log_spool_drain(void)
+{
+    return event_spool_drain(TRUE);
+}
+
+/* event_log_spool_stats
+ * Fills in the spool counters, they add up over the life time of the
+ * spool file. pending is the number of events in the spool now.
+ */
+void
+event_log_spool_stats(struct event_log_spool_stats *stats)
+{
+    struct event_spool_header *sp = NULL;
+    if(stats == NULL) {
+        return;
+    }
+    memset(stats, 0, sizeof(*stats));
+    pthread_mutex_lock(&spool_mutex);
+    sp = spool;
+    if(sp != NULL) {
+        stats->spooled = sp->spooled;
+        stats->replayed = __atomic_load_n(&sp->replayed, __ATOMIC_RELAXED);
+        stats->dropped = sp->dropped;
+        stats->rejected = __atomic_load_n(&sp->rejected, __ATOMIC_RELAXED);
+        if(event_spool_pending()) {
+            stats->pending = stats->spooled - stats->replayed -
+                             stats->rejected;
+        }
+    }
+    pthread_mutex_unlock(&spool_mutex);
+}
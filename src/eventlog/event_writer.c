@@ -0,0 +1,429 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*************************************************************************//**
+ * @ingroup ops_supportability
+ * This module hands the rendered events of the event log part of
+ * supportability library to journal. By default every event is sent
+ * on the caller's thread, in async mode events are copied in to a
+ * bounded ring and a writer thread drains it in batches, so a slow
+ * journald doesn't stall the threads logging events.
+ *
+ * @file
+ * Source file for the journal writer of supportability library.
+ *
+ ****************************************************************************/
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/uio.h>
+#include <systemd/sd-journal.h>
+#include "eventlog.h"
+#include "event_writer.h"
+#include "event_spool.h"
+#include "openvswitch/vlog.h"
+
+VLOG_DEFINE_THIS_MODULE(event_writer);
+
+/* One event, its journal fields stored back to back in data */
+struct event_record {
+    uint16_t n_fields;
+    uint16_t size;              /* Bytes of data used */
+    uint16_t len[EVENT_JOURNAL_FIELDS];
+    char data[EVENT_RECORD_SIZE];
+};
+
+/* The ring & everything below is protected by writer_mutex, except
+ * writer_running which log_event() peeks at without the lock to take
+ * the synchronous path when async mode is off */
+static pthread_mutex_t writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t writer_not_full = PTHREAD_COND_INITIALIZER;
+static pthread_t writer_thread;
+static int writer_running = FALSE;
+static int writer_started = FALSE;  /* Until the writer thread is joined */
+static int writer_exit_registered = FALSE;
+static int writer_fork_registered = FALSE;
+static int writer_policy = EVENT_LOG_DROP_NEW;
+static struct event_record *ring = NULL;
+static struct event_record *batch = NULL;
+static int ring_capacity = 0;
+static int ring_head = 0;           /* Next record to fill */
+static int ring_count = 0;
+static struct event_log_async_stats writer_stats;
+/* Set on the writer thread, which sends the events it logs itself */
+static __thread int writer_self = FALSE;
+
+/* journal_sendv
+ * Sends the event to journal on the calling thread. While the spool
+ * holds events they are replayed first, & the event is spooled behind
+ * them if they can't all be. An event journal refuses with a transient
+ * error is spooled.
+ *
+ * Returns 0 on success, negative errno or -1 if the event was lost.
+ */
+static int
+journal_sendv(const struct iovec *iov, int n_iov)
+{
+    int ret = 0;
+    if(event_spool_pending() && (event_spool_drain(FALSE) != 0)) {
+        return event_spool_add(iov, n_iov, FALSE);
+    }
+    ret = sd_journal_sendv(iov, n_iov);
+    if(ret != 0) {
+        VLOG_ERR("sd_journal_sendv failed with %d", ret);
+        if(event_spool_transient(ret) &&
+           (event_spool_add(iov, n_iov, TRUE) == 0)) {
+            return 0;
+        }
+    }
+    return ret;
+}
+
+/* record_fill
+ * Copies the journal fields of an event in to a ring record, fields
+ * which don't fit in to the record are left out, a truncated field
+ * could make journal refuse the whole event.
+ */
+static void
+record_fill(struct event_record *rec, const struct iovec *iov, int n_iov)
+{
+    size_t used = 0, len = 0;
+    int i = 0, n = 0;
+    if(n_iov > EVENT_JOURNAL_FIELDS) {
+        n_iov = EVENT_JOURNAL_FIELDS;
+    }
+    for(i = 0; i < n_iov; i++)
+    {
+        len = iov[i].iov_len;
+        if(len > (sizeof(rec->data) - used)) {
+            continue;
+        }
+        memcpy(rec->data + used, iov[i].iov_base, len);
+        rec->len[n++] = len;
+        used += len;
+    }
+    rec->n_fields = n;
+    rec->size = used;
+}
+
+/* record_fits
+ * Tells whether all journal fields of an event fit in a ring record.
+ *
+ * Returns TRUE if they do, FALSE otherwise.
+ */
+static int
+record_fits(const struct iovec *iov, int n_iov)
+{
+    size_t used = 0;
+    int i = 0;
+    for(i = 0; i < n_iov; i++)
+    {
+        used += iov[i].iov_len;
+    }
+    return (n_iov <= EVENT_JOURNAL_FIELDS) &&
+           (used <= EVENT_RECORD_SIZE);
+}
+
+/* record_send
+ * Sends the event held in a ring record to journal.
+ *
+ * Returns 0 on success, negative errno on failure.
+ */
+static int
+record_send(struct event_record *rec)
+{
+    struct iovec iov[EVENT_JOURNAL_FIELDS];
+    size_t used = 0;
+    int i = 0;
+    for(i = 0; i < rec->n_fields; i++)
+    {
+        iov[i].iov_base = rec->data + used;
+        iov[i].iov_len = rec->len[i];
+        used += rec->len[i];
+    }
+    return journal_sendv(iov, rec->n_fields);
+}
+
+/* event_writer_main
+ * Writer thread, drains the ring in batches of EVENT_WRITER_BATCH
+ * records. The batch is copied out of the ring so that journal is
+ * written without holding the lock. When idle for EVENT_WRITER_TICK
+ * it logs the summaries due, see event_log_run(). Exits once async
+ * mode is turned off and the ring is empty.
+ */
+static void *
+event_writer_main(void *arg)
+{
+    struct timespec deadline;
+    int i = 0, n = 0, tail = 0, failed = 0;
+
+    writer_self = TRUE;
+    pthread_mutex_lock(&writer_mutex);
+    for(;;)
+    {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += EVENT_WRITER_TICK;
+        while((ring_count == 0) && writer_running) {
+            if(pthread_cond_timedwait(&writer_not_empty, &writer_mutex,
+                                      &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+        if((ring_count == 0) && writer_running) {
+            pthread_mutex_unlock(&writer_mutex);
+            event_log_run();
+            pthread_mutex_lock(&writer_mutex);
+            continue;
+        }
+        if(ring_count == 0) {
+            break;
+        }
+        n = (ring_count < EVENT_WRITER_BATCH) ? ring_count
+                                              : EVENT_WRITER_BATCH;
+        tail = (ring_head - ring_count + ring_capacity) % ring_capacity;
+        for(i = 0; i < n; i++)
+        {
+            struct event_record *rec = &ring[(tail + i) % ring_capacity];
+            memcpy(&batch[i], rec, offsetof(struct event_record, data) +
+                                   rec->size);
+        }
+        ring_count -= n;
+        pthread_cond_broadcast(&writer_not_full);
+        pthread_mutex_unlock(&writer_mutex);
+
+        failed = 0;
+        for(i = 0; i < n; i++)
+        {
+            if(record_send(&batch[i]) != 0) {
+                failed++;
+            }
+        }
+
+        pthread_mutex_lock(&writer_mutex);
+        writer_stats.written += n - failed;
+        writer_stats.failed += failed;
+    }
+    pthread_mutex_unlock(&writer_mutex);
+    return NULL;
+}
+
+/* event_journal_send
+ * Hands a rendered event to journal, synchronously or through the
+ * ring when async mode is on. When the ring is full the overflow
+ * policy decides which event is lost, whether the caller waits or
+ * whether the event is spooled.
+ *
+ * The writer thread sends the events it logs itself rather than
+ * waiting on its own ring. Events too long for a ring record are sent
+ * synchronously too, rather than with fields left out.
+ *
+ * Returns 0 on success, -1 if the event was dropped & negative errno
+ * if journal could not be written.
+ */
+int
+event_journal_send(const struct iovec *iov, int n_iov)
+{
+    if(writer_self || !__atomic_load_n(&writer_running, __ATOMIC_ACQUIRE) ||
+       !record_fits(iov, n_iov)) {
+        return journal_sendv(iov, n_iov);
+    }
+    pthread_mutex_lock(&writer_mutex);
+    while(writer_running && (ring_count == ring_capacity) &&
+          (writer_policy == EVENT_LOG_BLOCK)) {
+        pthread_cond_wait(&writer_not_full, &writer_mutex);
+    }
+    if(!writer_running) {
+        /* async mode was turned off meanwhile */
+        pthread_mutex_unlock(&writer_mutex);
+        return journal_sendv(iov, n_iov);
+    }
+    if(ring_count == ring_capacity) {
+        if((writer_policy == EVENT_LOG_SPOOL) &&
+           (event_spool_add(iov, n_iov, FALSE) == 0)) {
+            writer_stats.spooled++;
+            pthread_mutex_unlock(&writer_mutex);
+            return 0;
+        }
+        if(writer_policy != EVENT_LOG_DROP_OLDEST) {
+            writer_stats.dropped_new++;
+            pthread_mutex_unlock(&writer_mutex);
+            return -1;
+        }
+        /* EVENT_LOG_DROP_OLDEST, the record at the tail is overwritten */
+        writer_stats.dropped_oldest++;
+        ring_count--;
+    }
+    record_fill(&ring[ring_head], iov, n_iov);
+    ring_head = (ring_head + 1) % ring_capacity;
+    ring_count++;
+    writer_stats.queued++;
+    pthread_cond_signal(&writer_not_empty);
+    pthread_mutex_unlock(&writer_mutex);
+    return 0;
+}
+
+/* writer_fork_prepare
+ * Holds the writer lock across fork(), so that the child gets the
+ * ring in a consistent state.
+ */
+static void
+writer_fork_prepare(void)
+{
+    pthread_mutex_lock(&writer_mutex);
+}
+
+/* writer_fork_parent
+ * Releases the writer lock in the parent once fork() is done.
+ */
+static void
+writer_fork_parent(void)
+{
+    pthread_mutex_unlock(&writer_mutex);
+}
+
+/* writer_fork_child
+ * Turns async mode off in the child, which has no writer thread. The
+ * events queued are left for the parent to write, the child logs
+ * synchronously until it turns async mode on again.
+ */
+static void
+writer_fork_child(void)
+{
+    free(ring);
+    free(batch);
+    ring = batch = NULL;
+    ring_capacity = 0;
+    ring_head = 0;
+    ring_count = 0;
+    __atomic_store_n(&writer_running, FALSE, __ATOMIC_RELEASE);
+    writer_started = FALSE;
+    pthread_cond_init(&writer_not_empty, NULL);
+    pthread_cond_init(&writer_not_full, NULL);
+    pthread_mutex_unlock(&writer_mutex);
+}
+
+/* event_log_async_enable
+ * Turns on async mode, events are queued in a ring of capacity
+ * records and written to journal by a writer thread. policy is one
+ * of EVENT_LOG_DROP_OLDEST, EVENT_LOG_DROP_NEW, EVENT_LOG_BLOCK or
+ * EVENT_LOG_SPOOL and decides what happens to an event logged while
+ * the ring is full.
+ * Queued events are flushed at process exit. A child forked meanwhile
+ * logs synchronously, see writer_fork_child().
+ *
+ * Returns 0 on success & -1 on failure or if async mode is on already
+ */
+int
+event_log_async_enable(int capacity, int policy)
+{
+    int ret = -1;
+    if((capacity <= 0) || (policy < EVENT_LOG_DROP_OLDEST) ||
+       (policy > EVENT_LOG_SPOOL)) {
+        return -1;
+    }
+    pthread_mutex_lock(&writer_mutex);
+    if(writer_started) {
+        goto out;
+    }
+    ring = (struct event_record*)calloc(capacity, sizeof(*ring));
+    batch = (struct event_record*)calloc(EVENT_WRITER_BATCH, sizeof(*batch));
+    if((ring == NULL) || (batch == NULL)) {
+        VLOG_ERR("Failed to allocate event ring of %d records", capacity);
+        goto fail;
+    }
+    ring_capacity = capacity;
+    ring_head = 0;
+    ring_count = 0;
+    writer_policy = policy;
+    __atomic_store_n(&writer_running, TRUE, __ATOMIC_RELEASE);
+    if(pthread_create(&writer_thread, NULL, event_writer_main, NULL) != 0) {
+        VLOG_ERR("Failed to create event writer thread");
+        __atomic_store_n(&writer_running, FALSE, __ATOMIC_RELEASE);
+        goto fail;
+    }
+    writer_started = TRUE;
+    if(!writer_exit_registered) {
+        atexit(event_log_async_disable);
+        writer_exit_registered = TRUE;
+    }
+    if(!writer_fork_registered &&
+       (pthread_atfork(writer_fork_prepare, writer_fork_parent,
+                       writer_fork_child) == 0)) {
+        writer_fork_registered = TRUE;
+    }
+    ret = 0;
+    goto out;
+
+fail:
+    free(ring);
+    free(batch);
+    ring = batch = NULL;
+out:
+    pthread_mutex_unlock(&writer_mutex);
+    return ret;
+}
+
+/* event_log_async_disable
+ * Turns off async mode, waits for the writer thread to write the
+ * events still in the ring. Events are sent synchronously afterwards.
+ */
+void
+event_log_async_disable(void)
+{
+    pthread_mutex_lock(&writer_mutex);
+    if(!writer_running) {
+        pthread_mutex_unlock(&writer_mutex);
+        return;
+    }
+    __atomic_store_n(&writer_running, FALSE, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&writer_not_empty);
+    pthread_cond_broadcast(&writer_not_full);
+    pthread_mutex_unlock(&writer_mutex);
+
+    pthread_join(writer_thread, NULL);
+
+    pthread_mutex_lock(&writer_mutex);
+    free(ring);
+    free(batch);
+    ring = batch = NULL;
+    ring_capacity = 0;
+    writer_started = FALSE;
+    pthread_mutex_unlock(&writer_mutex);
+}
+
+/* event_log_async_stats
+ * Fills in the async mode counters, they add up over the life time
+ * of the process. pending is the number of events in the ring now.
+ */
+void
+event_log_async_stats(struct event_log_async_stats *stats)
+{
+    if(stats == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&writer_mutex);
+    *stats = writer_stats;
+    stats->pending = ring_count;
+    pthread_mutex_unlock(&writer_mutex);
+}
@@ -27,19 +27,111 @@
 #define _GNU_SOURCE
 #include <stdio.h>
 #include "eventlog.h"
+#include "event_catalog.h"
+#include "event_writer.h"
+#include "event_ratelimit.h"
+#include "event_recorder.h"
+#include "event_coalesce.h"
+#include "event_spool.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
-#include <systemd/sd-journal.h>
-#include <yaml.h>
+#include <time.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/uio.h>
 #include "openvswitch/vlog.h"
+#include "unixctl.h"
 
 VLOG_DEFINE_THIS_MODULE(eventlog);
 
-static event *ev_table = NULL;
-static char *category_table[MAX_CATEGORIES_PER_DAEMON];
+/* The catalog along with the state of this daemon indexed the same
+ * way as its events & categories. It is published by event_log_init()
+ * once fully set up & then only changed through atomics, so log_event()
+ * reads it without locking. A reload publishes a new one in its place
+ * with a single pointer store, the replaced one is freed once no thread
+ * reads it any more, see event_log_state_get(). event_log_init() &
+ * event_log_reload() calls are serialized by event_log_mutex. */
+/* Counters of a catalog event, updated with relaxed atomics */
+struct event_counters {
+    unsigned long emitted;
+    unsigned long failed;
+    unsigned long coalesced;
+    uint64_t last_emitted;              /* Microseconds since the epoch */
+};
+
+struct event_log_state {
+    const struct event_catalog *catalog;
+    /* Catalog categories this daemon registered through event_log_init() */
+    unsigned char *registered;
+    /* Rate limit state of the catalog events */
+    struct event_ratelimit ratelimit;
+    /* Coalescing windows of the catalog events */
+    struct event_coalesce coalesce;
+    /* Each catalog event is logged 1 in sample_rates[i] times, as set
+     * in the catalog or by event_log_set_sample_rate() */
+    uint32_t *sample_rates;
+    /* One per catalog event */
+    struct event_counters *counters;
+    /* States replaced by a reload, newest first, see event_log_reap() */
+    struct event_log_state *retired_next;
+    unsigned long retired_epoch;        /* ev_epoch once replaced */
+};
+
+/* Size the message buffer of a thread starts at */
+#define EVENT_MESSAGE_SIZE (MAX_LOG_STR + MAX_EVENT_NAME_SIZE)
+
+/* A thread reading ev_state, one per thread which ever did. The epoch
+ * is the ev_epoch the thread started reading at, 0 while it doesn't
+ * read. Records of exited threads are taken over by new ones. */
+struct event_reader {
+    struct event_reader *next;
+    unsigned long epoch;
+    int depth;                          /* Nested reads of the thread */
+    int in_use;                         /* Owned by a live thread */
+    /* Buffer messages are rendered in, grown to the longest so far */
+    char *message;
+    size_t message_size;
+};
+
+static pthread_mutex_t event_log_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct event_log_state *ev_state = NULL;
+static struct event_log_state *ev_retired = NULL;
+/* Bumped by each reload, after the replaced state is unpublished */
+static unsigned long ev_epoch = 1;
+static struct event_reader *ev_readers = NULL;
+static pthread_key_t ev_reader_key;
+static int ev_reader_key_created = FALSE;
+static __thread struct event_reader *reader_self = NULL;
 static int category_index = 0;
-static char *event_yaml_path = NULL;
+/* Events logged with a name not in the catalog of this daemon */
+static unsigned long ev_unknown = 0;
+/* Least severe level of the events this daemon logs */
+static int ev_min_severity = MAX_SEV_LEVELS - 1;
+
+static void eventlog_unixctl_severity(struct unixctl_conn *conn, int argc,
+                                      const char *argv[], void *aux);
+static void eventlog_unixctl_reload(struct unixctl_conn *conn, int argc,
+                                    const char *argv[], void *aux);
+static void eventlog_unixctl_stats(struct unixctl_conn *conn, int argc,
+                                   const char *argv[], void *aux);
+static void eventlog_unixctl_recorder(struct unixctl_conn *conn, int argc,
+                                      const char *argv[], void *aux);
+static void eventlog_unixctl_sample(struct unixctl_conn *conn, int argc,
+                                    const char *argv[], void *aux);
+static void eventlog_unixctl_drain(struct unixctl_conn *conn, int argc,
+                                   const char *argv[], void *aux);
+
+/* Per thread scratch slots "key=value" strings are formed in by
+ * EV_KV(), enough for the keys of two events in flight */
+#define KV_SCRATCH_SLOTS (2*MAX_EVENT_KEYS)
+static __thread char kv_scratch[KV_SCRATCH_SLOTS][KEY_VALUE_SIZE];
+static __thread unsigned int kv_scratch_next = 0;
+
+/* Per thread state of event sampling, the generator sampled events
+ * are picked with & the event event_log_enabled() last let through */
+static __thread uint64_t sample_seed = 0;
+static __thread int sample_pass = -1;
 
 /* Function        : strcmp_with_nullcheck
 * Responsibility  : Ensure arguments are not null before calling strcmp
@@ -53,615 +145,1078 @@ strcmp_with_nullcheck( const char * str1, const char * str2 )
   return strcmp(str1, str2);
 }
 
-/* count_keys
- * Counts the number of keys in the event string
- *
- * Returns - 1 on failure, number of keys on success.
+/* event_reader_exit
+ * Hands the reader record of an exiting thread over to new threads.
  */
-int
-count_keys(char *keys)
+static void
+event_reader_exit(void *arg)
 {
-    char *key_token = NULL;
-    int key_count = 0;
-    if(keys == NULL) {
-       return -1;
-    }
-    key_token = strtok(keys, ",");
-    while(key_token != NULL)
+    struct event_reader *r = (struct event_reader*)arg;
+    r->depth = 0;
+    __atomic_store_n(&r->epoch, 0, __ATOMIC_RELEASE);
+    __atomic_store_n(&r->in_use, FALSE, __ATOMIC_RELEASE);
+    reader_self = NULL;
+}
+
+/* event_reader_fork_child
+ * Only the forking thread is left in the child, the other threads no
+ * longer read anything.
+ */
+static void
+event_reader_fork_child(void)
+{
+    struct event_reader *r = NULL;
+    for(r = ev_readers; r != NULL; r = r->next)
     {
-        key_token = strtok(NULL, ",");
-        key_count++;
+        if(r != reader_self) {
+            r->depth = 0;
+            r->epoch = 0;
+            r->in_use = FALSE;
+        }
     }
-    return key_count;
 }
 
-/* assign_parsed_values
- * assigns the values from yaml file passed to indexed
- * location in event table.
+/* event_reader_new
+ * Sets up the reader record of the calling thread, taking over the one
+ * of an exited thread if any. Done once per thread, log_event() does
+ * no heap allocation afterwards but to grow the message buffer.
  *
- * Returns none
+ * Returns the record on success, NULL on failure.
  */
-void
-assign_parsed_values(char *key, int *val, int *fnd, int *index)
+static struct event_reader *
+event_reader_new(void)
 {
-    int tmp = *index;
-    int size = 0;
-    switch(*val) {
-
-        case 1:
-            *val = 0;
-            break;
-
-        case 2:
-            ev_table[tmp].event_id = atoi(key);
-            *val = 0;
-            break;
-
-        case 3:
-            size = strlen(key);
-            if((size > 0) && (size < MAX_SEV_NAME_SIZE )) {
-                strncpy(ev_table[tmp].severity, key, (size+1));
-            }
-            *val = 0;
+    struct event_reader *r = NULL;
+    int idle = FALSE;
+    for(r = __atomic_load_n(&ev_readers, __ATOMIC_ACQUIRE); r != NULL;
+        r = r->next)
+    {
+        idle = FALSE;
+        if(__atomic_compare_exchange_n(&r->in_use, &idle, TRUE, FALSE,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
             break;
+        }
+    }
+    if(r == NULL) {
+        r = (struct event_reader*)calloc(1, sizeof(*r));
+        if(r == NULL) {
+            return NULL;
+        }
+        r->in_use = TRUE;
+        r->next = __atomic_load_n(&ev_readers, __ATOMIC_RELAXED);
+        while(!__atomic_compare_exchange_n(&ev_readers, &r->next, r, TRUE,
+                                           __ATOMIC_RELEASE,
+                                           __ATOMIC_RELAXED));
+    }
+    pthread_setspecific(ev_reader_key, r);
+    reader_self = r;
+    return r;
+}
 
-        case 4:
-            ev_table[tmp].num_of_keys = count_keys(key);
-            *val =0;
-            break;
+/* event_log_state_get
+ * Picks up the current state for the calling thread to read, till the
+ * matching event_log_state_put(). A state a reload replaced is freed
+ * only once every thread which could have picked it up put it back,
+ * however long it takes, see event_log_reap(). Calls nest.
+ *
+ * Returns the state, NULL if event_log_init() wasn't done.
+ */
+static struct event_log_state *
+event_log_state_get(void)
+{
+    struct event_reader *r = reader_self;
+    if(r == NULL) {
+        if(__atomic_load_n(&ev_state, __ATOMIC_ACQUIRE) == NULL) {
+            return NULL;
+        }
+        r = event_reader_new();
+        if(r == NULL) {
+            return NULL;
+        }
+    }
+    if(r->depth++ == 0) {
+        /* Seen by event_log_reap() before ev_state is read */
+        __atomic_store_n(&r->epoch, __atomic_load_n(&ev_epoch,
+                                                    __ATOMIC_SEQ_CST),
+                         __ATOMIC_SEQ_CST);
+    }
+    return __atomic_load_n(&ev_state, __ATOMIC_SEQ_CST);
+}
 
-        case 5:
-            size = strlen(key);
-            if((size > 0) && (size < MAX_LOG_STR)) {
-                strncpy(ev_table[tmp].event_description, key, (size+1));
-            }
-            *val = 0;
-            *fnd = 0;
-            (*index)++;
-            strncpy(ev_table[tmp+1].event_name, EVENT_NAME_DELIMITER_STR,
-            (strlen(EVENT_NAME_DELIMITER_STR)+1));
-            break;
+/* event_log_state_put
+ * Ends the read started by event_log_state_get().
+ */
+static void
+event_log_state_put(void)
+{
+    struct event_reader *r = reader_self;
+    if((r != NULL) && (--r->depth == 0)) {
+        __atomic_store_n(&r->epoch, 0, __ATOMIC_RELEASE);
     }
 }
 
-/* find_last_index
- * Searches for the delimiter in event table to find
- * the next index to fill
+/* event_log_state_new
+ * Sets up the state of this daemon for the catalog, with no category
+ * registered.
  *
- * Returns index on success, -1 on failure.
+ * Returns the state on success, NULL on failure.
  */
-int
-find_last_index()
+static struct event_log_state *
+event_log_state_new(const struct event_catalog *catalog)
 {
-    int i = 0;
-    /* Loop & figure out the index to append
-     * in ev_table */
-    while(i < MAX_EVENT_TABLE_SIZE)
+    struct event_log_state *es = NULL;
+    uint32_t i = 0;
+    es = (struct event_log_state*)calloc(1, sizeof(*es));
+    if(es == NULL) {
+        return NULL;
+    }
+    es->catalog = catalog;
+    es->registered = (unsigned char*)calloc(catalog->hdr->n_categories + 1, 1);
+    es->counters = (struct event_counters*)calloc(catalog->hdr->n_events + 1,
+                                                  sizeof(*es->counters));
+    es->sample_rates = (uint32_t*)calloc(catalog->hdr->n_events + 1,
+                                         sizeof(*es->sample_rates));
+    if((es->registered == NULL) || (es->counters == NULL) ||
+       (es->sample_rates == NULL) ||
+       (event_ratelimit_init(&es->ratelimit, catalog) < 0) ||
+       (event_coalesce_init(&es->coalesce) < 0)) {
+        free(es->registered);
+        free(es->counters);
+        free(es->sample_rates);
+        free(es->ratelimit.events);
+        free(es->coalesce.slots);
+        free(es);
+        return NULL;
+    }
+    for(i = 0; i < catalog->hdr->n_events; i++)
     {
-        if(!strcmp_with_nullcheck(ev_table[i].event_name,
-            EVENT_NAME_DELIMITER_STR)) {
-            return i;
-        }
-        i++;
+        es->sample_rates[i] = catalog->events[i].sample_rate;
     }
-   return -1;
+    return es;
 }
 
-/* parse_yaml_for_category
- * Parses the events.yaml file for the events with
- * the category passed.
+/* event_log_state_free
+ * Releases a state along with its catalog.
+ */
+static void
+event_log_state_free(struct event_log_state *es)
+{
+    event_catalog_free((struct event_catalog*)es->catalog);
+    free(es->registered);
+    free(es->counters);
+    free(es->sample_rates);
+    free(es->ratelimit.events);
+    free(es->coalesce.slots);
+    free(es);
+}
+
+/* event_log_init
+ * Initialization function for event log for daemon.
+ * Loads the event catalog on first call and registers the
+ * category of interest, the events of registered categories
+ * are the ones the daemon can log. Calls are serialized, the
+ * catalog is published to log_event() only once fully loaded.
  *
- * Returns 1 if atleast an event with the category is found
- * on failure returns -1.
+ * Returns 1 on success, 0 if the category has no events
+ * & -1 on failure
  */
 int
-parse_yaml_for_category(char *category)
-{
-    yaml_parser_t parser;
-    yaml_token_t token;
-    char buf[MAX_EVENT_NAME_SIZE] = {0,};
-    char *key = NULL;
-    int index = 0, ret = 0;
-    int def_flag=0,evt_flag=0,val_flag=0;
-    int found = 0, category_found = 0, size = 0;
-    FILE* fh;
-
-    if(category == NULL) {
+event_log_init(char *category_name)
+{
+    const struct event_catalog *catalog = NULL;
+    struct event_log_state *es = NULL;
+    int cat = 0, ret = -1;
+    if(category_name == NULL) {
         return -1;
     }
-    if(event_yaml_path == NULL) {
-        char path[512] = {0,};
-        char *envv = getenv("OPENSWITCH_INSTALL_PATH");
-        if (envv)
-            strcpy(path, envv);
-        if ((strlen(path) + strlen(EVENT_YAML_FILE) + 1) > sizeof(path))
-            return -1;
-        strcat(path, EVENT_YAML_FILE);
-        if ((event_yaml_path = strdup(path)) == NULL)
-            return -1;
+
+    pthread_mutex_lock(&event_log_mutex);
+    if(category_index > (MAX_CATEGORIES_PER_DAEMON)) {
+        goto out;
     }
-    fh = fopen(event_yaml_path, "r");
-    if(fh == NULL) {
-        VLOG_ERR("YAML file (%s) open failed", event_yaml_path);
-        return -1;
+    es = ev_state;
+    if(es == NULL) {
+        /* It seems this is the first call of event_log_init()
+         * by this daemon, lets load the event catalog then
+         */
+        if(!ev_reader_key_created) {
+            if(pthread_key_create(&ev_reader_key, event_reader_exit) != 0) {
+                goto out;
+            }
+            pthread_atfork(NULL, NULL, event_reader_fork_child);
+            ev_reader_key_created = TRUE;
+        }
+        catalog = event_catalog_load();
+        if(catalog == NULL) {
+            goto out;
+        }
+        es = event_log_state_new(catalog);
+        if(es == NULL) {
+            goto out;
+        }
+        unixctl_command_register("eventlog/severity", "[level]", 0, 1,
+                                 eventlog_unixctl_severity, NULL);
+        unixctl_command_register("eventlog/reload", "", 0, 0,
+                                 eventlog_unixctl_reload, NULL);
+        unixctl_command_register("eventlog/stats", "[event]", 0, 1,
+                                 eventlog_unixctl_stats, NULL);
+        unixctl_command_register("eventlog/recorder", "", 0, 0,
+                                 eventlog_unixctl_recorder, NULL);
+        unixctl_command_register("eventlog/sample", "event [rate]", 1, 2,
+                                 eventlog_unixctl_sample, NULL);
+        unixctl_command_register("eventlog/drain", "", 0, 0,
+                                 eventlog_unixctl_drain, NULL);
+        event_recorder_init();
+        event_spool_init();
+        __atomic_store_n(&ev_state, es, __ATOMIC_RELEASE);
     }
-    index = find_last_index();
-    if((index < 0) || (index > MAX_EVENT_TABLE_SIZE)) {
-        return -1;
+    cat = event_catalog_find_category(es->catalog, category_name);
+    if(cat < 0) {
+        ret = 0;
+        goto out;
     }
-    if (!yaml_parser_initialize(&parser)) {
-        VLOG_ERR("YAML Initialize failed");
-        return -1;
+    /* Lets check whether event_log_init() on this category
+     * was already done */
+    if(es->registered[cat]) {
+        goto out;
     }
-    yaml_parser_set_input_file(&parser, fh);
-    /* Lets loop through all tokens & assign the values
-     * in ev_table index of the given event */
-    while(token.type!= YAML_STREAM_END_TOKEN)
-    {
-        yaml_parser_scan(&parser, &token);
-        switch(token.type)
-        {
-            case YAML_KEY_TOKEN:
-                break;
-
-            case YAML_VALUE_TOKEN:
-                break;
-
-            case YAML_SCALAR_TOKEN:
-                key= (char*)token.data.scalar.value;
-                if(key == NULL) {
-                    continue;
-                }
-
-                if(val_flag == 1)
-                {
-                    size = strlen(key);
-                    if((size > 0) && (size < MAX_EVENT_NAME_SIZE)) {
-                        strncpy(buf, key, (size+1));
-                    }
-                    val_flag = 0;
-
-                }
-                if((evt_flag) && (!strcmp(key, category)))
-                {
-                    found = 1;
-                    category_found = 1;
-                    size = strlen(buf);
-                    if((size > 0) && (size < MAX_EVENT_NAME_SIZE)) {
-                        strncpy(ev_table[index].event_name, buf, (size+1));
-                    }
-                }
-                if(found)
-                {
-                    assign_parsed_values(key, &val_flag, &found, &index);
-                    ret = asprintf(&ev_table[index].category, "%s", category);
-                    if(ret < 0) {
-                        return -1;
-                        VLOG_ERR("Failed to allocate memory");
-                    }
-                }
-                if(!strcmp_with_nullcheck(key, "event_definitions"))
-                {
-                    def_flag=1;
-                    continue;
-                }
-                else if((!strcmp_with_nullcheck(key, "event_name"))
-                     && (def_flag))
-                {
-                    val_flag=1;
-                    continue;
-
-                }
-                else if((!strcmp_with_nullcheck(key, "event_category"))
-                    && (def_flag))
-                {
-                    evt_flag =1;
-                    continue;
-                }
-                else if((!strcmp_with_nullcheck(key, "event_ID"))
-                    && (def_flag))
-                {
-                    val_flag=2;
-                    continue;
-
-                }
-                else if((!strcmp_with_nullcheck(key, "severity"))
-                    && (evt_flag))
-                {
-                    val_flag=3;
-                    continue;
-                }
-                else if((!strcmp_with_nullcheck(key, "keys"))
-                    && (evt_flag))
-                {
-                    val_flag=4;
-                    continue;
-
-                }
-                else if((!strcmp_with_nullcheck(key, "event_description_template"))
-                    && (evt_flag))
-                {
-                    val_flag =5;
-                    continue;
-                }
-                break;
-
-                default: break;
-            }
-            if (token.type != YAML_STREAM_END_TOKEN) {
-                yaml_token_delete(&token);
-            }
-        }
-    yaml_parser_delete(&parser);
-    fclose(fh);
-    return category_found;
+    __atomic_store_n(&es->registered[cat], TRUE, __ATOMIC_RELEASE);
+    category_index++;
+    ret = 1;
+
+out:
+    pthread_mutex_unlock(&event_log_mutex);
+    return ret;
 }
 
-/* create_event_table
- * Creates the event ID table.
- *
- * Returns 0 on success, -1 on failure.
+/* event_log_state_carry
+ * Carries the categories this daemon registered, the rate limit
+ * state, the coalescing windows, the sampling set at run time & the
+ * counters of the events over to the state of a reloaded catalog,
+ * matching them by name as their indexes may have changed.
  */
-int
-create_event_table()
+static void
+event_log_state_carry(struct event_log_state *es,
+                      struct event_log_state *old)
 {
-    ev_table = (event*)malloc((MAX_EVENT_TABLE_SIZE*sizeof(event)));
-    if(ev_table == NULL) {
-        return -1;
+    const struct event_catalog *catalog = es->catalog;
+    struct event_rate_state *from = NULL, *to = NULL;
+    struct event_counters *counters = NULL;
+    uint32_t i = 0, rate = 0;
+    int j = 0;
+    for(i = 0; i < old->catalog->hdr->n_categories; i++)
+    {
+        if(!old->registered[i]) {
+            continue;
+        }
+        j = event_catalog_find_category(catalog,
+            event_catalog_str(old->catalog, old->catalog->categories[i].name));
+        if(j >= 0) {
+            es->registered[j] = TRUE;
+        }
     }
-    /* Lets fill in the delimiter at 1st index to show that
-     * table is empty */
-    strncpy(ev_table[0].event_name, EVENT_NAME_DELIMITER_STR,
-    (strlen(EVENT_NAME_DELIMITER_STR)+1));
-    return 0;
+    for(i = 0; i < catalog->hdr->n_events; i++)
+    {
+        j = event_catalog_find(old->catalog,
+                               event_catalog_str(catalog,
+                                                 catalog->events[i].name));
+        if(j < 0) {
+            continue;
+        }
+        from = &old->ratelimit.events[j];
+        to = &es->ratelimit.events[i];
+        to->tat = __atomic_load_n(&from->tat, __ATOMIC_RELAXED);
+        to->suppressed = __atomic_load_n(&from->suppressed, __ATOMIC_RELAXED);
+        /* Taken rather than copied, what is counted in the old state
+         * from now on is added later by event_log_reap() */
+        counters = &old->counters[j];
+        es->counters[i].emitted = __atomic_exchange_n(&counters->emitted, 0,
+                                                      __ATOMIC_RELAXED);
+        es->counters[i].failed = __atomic_exchange_n(&counters->failed, 0,
+                                                     __ATOMIC_RELAXED);
+        es->counters[i].coalesced = __atomic_exchange_n(&counters->coalesced,
+                                                        0, __ATOMIC_RELAXED);
+        rate = __atomic_load_n(&old->sample_rates[j], __ATOMIC_RELAXED);
+        if(rate != old->catalog->events[j].sample_rate) {
+            es->sample_rates[i] = rate;
+        }
+        es->counters[i].last_emitted = __atomic_load_n(
+                                       &counters->last_emitted,
+                                       __ATOMIC_RELAXED);
+    }
+    es->ratelimit.first_pending = __atomic_load_n(
+                                  &old->ratelimit.first_pending,
+                                  __ATOMIC_RELAXED);
+    es->ratelimit.pending = __atomic_exchange_n(&old->ratelimit.pending, 0,
+                                                __ATOMIC_RELAXED);
+    event_coalesce_carry(&es->coalesce, catalog, &old->coalesce,
+                         old->catalog);
 }
 
-/* add_to_event_table
- * Add the events belonging to the category to
- * event table
- *
- * Returns the return value returned by the yaml parser
- * API.
+/* event_reader_oldest
+ * Returns the oldest epoch a thread reading ev_state started at,
+ * ULONG_MAX if no thread reads it.
  */
-int
-add_to_event_table(char *event_category)
+static unsigned long
+event_reader_oldest(void)
 {
-    int ret = 0;
-    ret = parse_yaml_for_category(event_category);
-    return ret;
+    struct event_reader *r = NULL;
+    unsigned long oldest = ULONG_MAX, epoch = 0;
+    for(r = __atomic_load_n(&ev_readers, __ATOMIC_ACQUIRE); r != NULL;
+        r = r->next)
+    {
+        epoch = __atomic_load_n(&r->epoch, __ATOMIC_SEQ_CST);
+        if(epoch && (epoch < oldest)) {
+            oldest = epoch;
+        }
+    }
+    return oldest;
 }
 
-/* event_category_search
- * Searches the category table for the given category
- *
- * Returns TRUE(1) if category is found, else FALSE
+/* event_log_reap
+ * Frees the states replaced by reloads which no thread reads any more,
+ * adding what was counted in them after they were carried over to the
+ * counters of the current state. A thread which started reading before
+ * a state was replaced may still use it, one which started after can't
+ * have picked it up. Called under event_log_mutex.
  */
-int
-event_category_search(char *category)
+static void
+event_log_reap(struct event_log_state *es)
 {
-    int i = 0;
-    if(category == NULL) {
-        return FALSE;
+    struct event_log_state **prev = &ev_retired, *old = NULL;
+    struct event_counters *from = NULL, *to = NULL;
+    unsigned long oldest = event_reader_oldest();
+    uint64_t last = 0;
+    uint32_t i = 0;
+    int j = 0;
+    while(*prev && ((*prev)->retired_epoch > oldest))
+    {
+        prev = &(*prev)->retired_next;
     }
-    /* Loop till the existing last index to find the category */
-    while(i < category_index)
+    while((old = *prev) != NULL)
     {
-        if(!strcmp_with_nullcheck(category_table[i], category)) {
-            return TRUE;
-        }
-        else {
-            i++;
+        __atomic_store_n(prev, old->retired_next, __ATOMIC_RELAXED);
+        for(i = 0; i < old->catalog->hdr->n_events; i++)
+        {
+            j = event_catalog_find(es->catalog,
+                    event_catalog_str(old->catalog,
+                                      old->catalog->events[i].name));
+            if(j < 0) {
+                continue;
+            }
+            from = &old->counters[i];
+            to = &es->counters[j];
+            __atomic_add_fetch(&to->emitted, from->emitted, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&to->failed, from->failed, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&to->coalesced, from->coalesced,
+                               __ATOMIC_RELAXED);
+            last = __atomic_load_n(&to->last_emitted, __ATOMIC_RELAXED);
+            while((from->last_emitted > last) &&
+                  !__atomic_compare_exchange_n(&to->last_emitted, &last,
+                                               from->last_emitted, TRUE,
+                                               __ATOMIC_RELAXED,
+                                               __ATOMIC_RELAXED));
         }
+        event_log_state_free(old);
     }
-    return FALSE;
 }
 
-/* event_log_init
- * Initialization function for event log for daemon.
- * creates daemon event table with category of interest
+/* event_log_reload
+ * Reloads the event catalog, so that changes to the yaml file take
+ * effect without restarting the daemon. The new catalog is set up
+ * aside, with the categories the daemon registered, & published with
+ * a single pointer store. log_event() callers never wait for it &
+ * finish with the catalog they picked up, so the replaced state is
+ * only freed once none of them reads it any more, by a later reload or
+ * event_log_run(), see event_log_reap().
  *
- * Returns 0 on success, -1 on failure
+ * Returns 1 if reloaded, 0 if the catalog didn't change & -1 on failure
  */
 int
-event_log_init(char *category_name)
+event_log_reload(void)
 {
-    int ret = 0;
-    if(category_name == NULL) {
-        return -1;
-    }
+    struct event_catalog *catalog = NULL;
+    struct event_log_state *es = NULL, *old = NULL;
+    int ret = -1;
 
-    if(category_index > (MAX_CATEGORIES_PER_DAEMON)) {
-        return -1;
+    pthread_mutex_lock(&event_log_mutex);
+    old = ev_state;
+    if(old == NULL) {
+        goto out;
     }
-    if(category_index) {
-        /* Lets check whether event_log_init() on this category
-         * was already done. If that is the case it will be present
-         * in category table we maintain */
-        if(event_category_search(category_name)) {
-            return -1;
-        }
+    catalog = event_catalog_reload();
+    if(catalog == NULL) {
+        goto out;
     }
-    if(ev_table == NULL) {
-        /* It seems this is the first call of event_log_init()
-         * by this daemon, lets create the daemon event table then
-         */
-        ret = create_event_table();
-        if(ret < 0) {
-            return -1;
-        }
+    if(catalog->hdr->yaml_hash == old->catalog->hdr->yaml_hash) {
+        event_catalog_free(catalog);
+        ret = 0;
+        goto out;
     }
-    /* Lets add the events belonging to this category to event table */
-    ret = add_to_event_table(category_name);
-    if(ret > 0) {
-        /* Add this category to category table, so that next time
-         * if somebody calls with the same category we will not
-         * duplicate all this work we already did */
-        asprintf(&category_table[category_index], "%s", category_name);
-        category_index++;
+    es = event_log_state_new(catalog);
+    if(es == NULL) {
+        event_catalog_free(catalog);
+        goto out;
     }
+    event_log_state_carry(es, old);
+    __atomic_store_n(&ev_state, es, __ATOMIC_SEQ_CST);
+    /* Nobody should build the catalog of the old yaml file any more */
+    event_catalog_unpublish(old->catalog);
+    /* Threads starting to read from now on only find the new state */
+    old->retired_epoch = __atomic_add_fetch(&ev_epoch, 1, __ATOMIC_SEQ_CST);
+    old->retired_next = ev_retired;
+    __atomic_store_n(&ev_retired, old, __ATOMIC_RELEASE);
+    event_log_reap(es);
+    VLOG_INFO("Event catalog reloaded, %u events",
+              catalog->hdr->n_events);
+    ret = 1;
+
+out:
+    pthread_mutex_unlock(&event_log_mutex);
     return ret;
 }
 
+/* eventlog_unixctl_reload
+ * unixctl handler of "eventlog/reload", reloads the event catalog.
+ */
+static void
+eventlog_unixctl_reload(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                        const char *argv[] OVS_UNUSED, void *aux OVS_UNUSED)
+{
+    int ret = event_log_reload();
+    if(ret < 0) {
+        unixctl_command_reply_error(conn, "Event catalog reload failed");
+        return;
+    }
+    unixctl_command_reply(conn, (ret > 0) ? "Event catalog reloaded" :
+                                            "Event catalog unchanged");
+}
+
 /* key_value_string
- * Forms the string in "key=value" format
+ * Forms the string in "key=value" format. The string is formed in
+ * a per thread scratch slot rather than on heap, log_event() hands
+ * the slot back once the event is logged. Values too long for the
+ * slot are truncated.
  *
  *returns formed string on sucess, NULL on failure.
  */
 char
 *key_value_string(char *s1, ...)
 {
-    char *tmp = NULL;
+    char *kv_pair = NULL;
+    char *fmt = NULL;
     int size = 0;
-    char str[KEY_VALUE_SIZE] = {0,};
-    char str2[KEY_VALUE_SIZE] = {0,};
-    /* This memory is freed in log_event():line 622 */
-    char *kv_pair = (char*)malloc(KEY_VALUE_SIZE);
-    if(kv_pair == NULL) {
+    va_list arg;
+    if(s1 == NULL) {
         return NULL;
     }
-    va_list arg;
-    va_start(arg, s1);
     size = strlen(s1);
-    if((size > 0) && (size < KEY_VALUE_SIZE)) {
-        strncpy(str, s1, (size+1));
-    }
-    else {
+    if((size == 0) || (size >= (KEY_VALUE_SIZE-1))) {
         return NULL;
     }
+    kv_pair = kv_scratch[kv_scratch_next];
+    kv_scratch_next = (kv_scratch_next + 1) % KV_SCRATCH_SLOTS;
     /* Add "=" to make "key=value" string */
-    tmp = strcat(str, "=");
-    s1 = va_arg(arg, char*);
-    vsnprintf(str2, KEY_VALUE_SIZE, s1, arg);
-    size = strlen(str2);
-    if((size > 0) && (size < KEY_VALUE_SIZE)) {
-        strcat(tmp, str2);
-    }
-    size = strlen(tmp);
-    if((size > 0) && (size < KEY_VALUE_SIZE)) {
-        strncpy(kv_pair, tmp, (size+1));
-    }
+    memcpy(kv_pair, s1, size);
+    kv_pair[size++] = '=';
+    va_start(arg, s1);
+    fmt = va_arg(arg, char*);
+    vsnprintf(kv_pair + size, KEY_VALUE_SIZE - size, fmt, arg);
     va_end(arg);
     return kv_pair;
 }
 
-/* make_key_format
- * Make key name string in format "{KEY}"
+/* free_key_value_string
+ * Releases the "key=value" string passed to log_event(). Strings
+ * from key_value_string() live in scratch slots & need no free,
+ * anything else came from the caller's heap as it used to.
+ */
+static void
+free_key_value_string(char *kv_pair)
+{
+    if((kv_pair >= kv_scratch[0]) &&
+       (kv_pair < kv_scratch[KV_SCRATCH_SLOTS])) {
+        return;
+    }
+    free(kv_pair);
+}
+
+/* event_lookup
+ * Looks up the given event in the event catalog, only events
+ * of the categories this daemon registered are found.
  *
- * returns 0 on success, -1 on failure.
+ * Returns event index on success, -1 on failure.
  */
-int
-make_key_format(char *key)
+static int
+event_lookup(const struct event_log_state *es, const char *name)
 {
-    int len = 0, i = 0;
-    if(key == NULL) {
+    int index = 0;
+    if((name == NULL) || (es == NULL)) {
         return -1;
     }
-    len = strlen(key);
-    if(len > (KEY_VALUE_SIZE-2)) {
-        VLOG_ERR("Key name too large");
+    index = event_catalog_find(es->catalog, name);
+    if((index < 0) ||
+       !__atomic_load_n(&es->registered[es->catalog->events[index].category],
+                        __ATOMIC_ACQUIRE)) {
         return -1;
     }
+    return index;
+}
 
-    /* Move over! */
-    for (i = len; i >= 0; i--)
+/* event_search
+ * Searches the event catalog for the given event
+ *
+ * Returns event index on success, -1 on failure.
+ */
+int
+event_search(char *fmt)
+{
+    int index = event_lookup(event_log_state_get(), fmt);
+    event_log_state_put();
+    return index;
+}
+
+/* severity_level
+ * To convert severity string to severity value.
+ *
+ * Returns -1 on failure & severity value on success
+ */
+int
+severity_level(char *arg)
+{
+    const char *sev[] = {"LOG_EMERG","LOG_ALERT","LOG_CRIT","LOG_ERR",
+                         "LOG_WARN","LOG_NOTICE","LOG_INFO","LOG_DEBUG"};
+    int i, found = 0;
+    for(i = 0; i < MAX_SEV_LEVELS; i++)
     {
-        key[i + 1] = key[i];
+        if(!strcmp_with_nullcheck(arg, sev[i])) {
+            found = TRUE;
+            break;
+        }
     }
+    if(found) {
+        return i;
+    }
+    return -1;
+}
 
-    /* Now plug in the new prefix. */
-    key[0] = '{';
-    strncat(key, "}", len);
+/* severity_by_name
+ * To convert a severity name, either as in events yaml file or as
+ * in show events command, to severity value.
+ *
+ * Returns -1 on failure & severity value on success
+ */
+static int
+severity_by_name(const char *arg)
+{
+    const char *sev[] = {"emer","alert","crit","err",
+                         "warn","notice","info","debug"};
+    int i = 0;
+    for(i = 0; i < MAX_SEV_LEVELS; i++)
+    {
+        if(!strcmp_with_nullcheck(arg, sev[i])) {
+            return i;
+        }
+    }
+    return severity_level((char*)arg);
+}
+
+/* event_log_set_severity
+ * Sets the least severe level of the events this daemon logs, events
+ * of a level above it are dropped by log_event().
+ *
+ * Returns 0 on success & -1 if the level is not valid
+ */
+int
+event_log_set_severity(int level)
+{
+    if((level < 0) || (level >= MAX_SEV_LEVELS)) {
+        return -1;
+    }
+    __atomic_store_n(&ev_min_severity, level, __ATOMIC_RELAXED);
     return 0;
 }
 
-/* replace_str
- * Search & replace the provided key in the string
- * with value
+/* event_log_get_severity
+ * Returns the least severe level of the events this daemon logs.
+ */
+int
+event_log_get_severity(void)
+{
+    return __atomic_load_n(&ev_min_severity, __ATOMIC_RELAXED);
+}
+
+/* sample_random
+ * xorshift64* generator of the calling thread, seeded on first use.
  *
- * returns the replaced string on success.
+ * Returns the next pseudo random number.
  */
-char
-*replace_str(char *str, char *orig, char *rep)
+static uint64_t
+sample_random(void)
 {
-    static char buffer[MAX_LOG_STR] = {0,};
-    char *p = NULL;
-    char key_name[(strlen(orig)+2)];
-    int size = 0;
-    if(orig != NULL) {
-        size = strlen(orig);
+    struct timespec now;
+    if(sample_seed == 0) {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        sample_seed = ((uint64_t)(uintptr_t)&sample_seed ^
+                       ((uint64_t)now.tv_sec << 32) ^ now.tv_nsec) | 1;
     }
-    else {
-        return NULL;
+    sample_seed ^= sample_seed >> 12;
+    sample_seed ^= sample_seed << 25;
+    sample_seed ^= sample_seed >> 27;
+    return sample_seed * 2685821657736338717ULL;
+}
+
+/* event_sampled
+ * Picks whether this call of a sampled event is logged, 1 in its
+ * sample rate at random, unless event_log_enabled() picked it already
+ * for the log_event() following it, so that a LOG_EVENT() is sampled
+ * once.
+ *
+ * Returns TRUE if the event is to be logged, FALSE if sampled out.
+ */
+static int
+event_sampled(const struct event_log_state *es, int index, int picked)
+{
+    uint32_t rate = __atomic_load_n(&es->sample_rates[index],
+                                    __ATOMIC_RELAXED);
+    if((rate <= 1) || picked) {
+        return TRUE;
     }
-    memset(key_name, 0, sizeof(key_name));
-    strncpy(key_name, orig, (size+1));
-    /* Prepend & append '}' to key name */
-    if(make_key_format(key_name) < 0) {
-        return NULL;
+    return ((sample_random() % rate) == 0);
+}
+
+/* sample_pick_take
+ * Takes the event event_log_enabled() let through last on this thread,
+ * whichever event is logged, so that it only carries over to the very
+ * next log_event() of the thread & only if that logs the same event.
+ *
+ * Returns the event index, -1 if none.
+ */
+static int
+sample_pick_take(void)
+{
+    int index = sample_pass;
+    sample_pass = -1;
+    return index;
+}
+
+/* event_enabled
+ * Checks the event at index against the severity threshold, its
+ * sampling & its rate limit, see event_log_enabled().
+ *
+ * Returns TRUE if the event is to be logged, FALSE otherwise
+ */
+static int
+event_enabled(struct event_log_state *es, int index)
+{
+    if(es->catalog->events[index].priority >
+       __atomic_load_n(&ev_min_severity, __ATOMIC_RELAXED)) {
+        return FALSE;
     }
-    /* Loop till we replace all keys with same name in str */
-    while((p = strstr(str, key_name)) != NULL)
-    {
-        if(str != NULL) {
-            strncpy(buffer, str, p-str);
-        }
-        else {
-            return NULL;
-        }
-        buffer[p-str] = '\0';
-        sprintf(buffer+(p-str), "%s%s", rep, p+strlen(key_name));
-        size = strlen(buffer);
-        if(str != NULL) {
-            strncpy(str, buffer, (size+1));
-        }
-        else {
-            return NULL;
-        }
+    sample_pass = -1;
+    if(!event_sampled(es, index, FALSE) ||
+       event_ratelimit_throttled(&es->ratelimit, es->catalog, index)) {
+        return FALSE;
+    }
+    if(__atomic_load_n(&es->sample_rates[index], __ATOMIC_RELAXED) > 1) {
+        sample_pass = index;
     }
+    return TRUE;
+}
 
-    return buffer;
+/* event_log_enabled
+ * Checks whether log_event() would log the event with the severity
+ * threshold of the daemon & the rate limit of the event, for
+ * LOG_EVENT() to skip formatting the keys of filtered events. For a
+ * sampled event the pick is made here & holds for the next log_event()
+ * on this thread only, if it logs that event. An event over its rate
+ * limit is counted as suppressed here, it is not kept in the flight
+ * recorder as its keys are never formatted. Unknown events are let
+ * through so that log_event() reports them.
+ *
+ * Returns TRUE if the event is to be logged, FALSE otherwise
+ */
+int
+event_log_enabled(char *ev_name)
+{
+    struct event_log_state *es = NULL;
+    int index = 0, ret = TRUE;
+    es = event_log_state_get();
+    index = event_lookup(es, ev_name);
+    if(index >= 0) {
+        ret = event_enabled(es, index);
+    }
+    event_log_state_put();
+    return ret;
 }
 
-/* populate_str
- * Populates the given string with the key value pairs.
+/* event_log_set_sample_rate
+ * Sets the event to be logged 1 in rate times, 0 or 1 logging it
+ * every time, overriding the sample_rate of the catalog.
  *
- * Returns 0 on sucess, -1 on failure.
+ * Returns 0 on success & -1 if the event is not in the catalog
  */
 int
-populate_str(char *s1, char *s2)
+event_log_set_sample_rate(char *ev_name, unsigned int rate)
 {
-    char *prev = NULL, *token = NULL;
-    char *string = NULL;
-    int size = 0;
-    char *final = NULL;
-    if ((s1 == NULL) || (s2 == NULL)) {
-        return -1;
+    struct event_log_state *es = NULL;
+    int index = -1;
+    es = event_log_state_get();
+    if((es != NULL) && (ev_name != NULL)) {
+        index = event_catalog_find(es->catalog, ev_name);
     }
-    size = strlen(s2);
-    if((size > 0) && (size < KEY_VALUE_SIZE)) {
-        size = asprintf(&string, "%s", s2);
-        if(size < 0) {
-            return -1;
-        }
+    if(index >= 0) {
+        __atomic_store_n(&es->sample_rates[index], rate ? rate : 1,
+                         __ATOMIC_RELAXED);
     }
-    else {
-        return -1;
+    event_log_state_put();
+    return (index >= 0) ? 0 : -1;
+}
+
+/* eventlog_unixctl_sample
+ * unixctl handler of "eventlog/sample EVENT [RATE]", sets the event to
+ * be logged 1 in RATE times or shows its sampling when no rate is
+ * given.
+ */
+static void
+eventlog_unixctl_sample(struct unixctl_conn *conn, int argc,
+                        const char *argv[], void *aux OVS_UNUSED)
+{
+    struct event_log_state *es = NULL;
+    char reply[MAX_EVENT_NAME_SIZE + EVENT_FIELD_SIZE];
+    char *end = NULL;
+    unsigned long rate = 0;
+    int index = 0;
+
+    es = event_log_state_get();
+    index = event_catalog_find(es->catalog, argv[1]);
+    if(index < 0) {
+        unixctl_command_reply_error(conn, "Unknown event");
+        goto out;
     }
-    token = strtok(string, "=");
-    prev = token;
-    while(token != NULL)
-    {
-        token = strtok(NULL, "=");
-        if(token != NULL)
-        final = replace_str(s1, prev, token);
-        if(final == NULL) {
-            return -1;
+    if(argc > 2) {
+        rate = strtoul(argv[2], &end, 10);
+        if((*argv[2] == '\0') || (*end != '\0') || (rate > UINT32_MAX)) {
+            unixctl_command_reply_error(conn, "Invalid sample rate");
+            goto out;
         }
+        event_log_set_sample_rate((char*)argv[1], rate);
     }
-    size = strlen(final);
-    if((size > 0) && (size < MAX_LOG_STR)) {
-        strncpy(s1, final, (size+1));
-    }
-    else {
-        free(string);
-        return -1;
+    snprintf(reply, sizeof(reply), "%.*s logged 1 in %u times",
+             MAX_EVENT_NAME_SIZE, argv[1],
+             __atomic_load_n(&es->sample_rates[index], __ATOMIC_RELAXED));
+    unixctl_command_reply(conn, reply);
+
+out:
+    event_log_state_put();
+}
+
+/* eventlog_unixctl_severity
+ * unixctl handler of "eventlog/severity [LEVEL]", sets the severity
+ * threshold of the daemon or shows it when no level is given.
+ */
+static void
+eventlog_unixctl_severity(struct unixctl_conn *conn, int argc,
+                          const char *argv[], void *aux OVS_UNUSED)
+{
+    const char *sev[] = {"emer","alert","crit","err",
+                         "warn","notice","info","debug"};
+    char reply[EVENT_FIELD_SIZE];
+    int level = 0;
+    if(argc > 1) {
+        level = severity_by_name(argv[1]);
+        if(event_log_set_severity(level) < 0) {
+            unixctl_command_reply_error(conn, "Invalid severity level, "
+                "expected emer|alert|crit|err|warn|notice|info|debug");
+            return;
+        }
     }
-    free(string);
-    return 0;
+    snprintf(reply, sizeof(reply), "%s", sev[event_log_get_severity()]);
+    unixctl_command_reply(conn, reply);
 }
 
-/* event_search
- * Searches the event table for the given event
+/* key_field
+ * Forms the journal field OPS_EVT_KEY_<KEY>=value out of a "key=value"
+ * string, so that every key of an event can be matched in journal on
+ * its own. Journal field names only take upper case letters, digits
+ * & '_', other characters of the key are replaced by '_'.
  *
- * Returns event index on success, -1 on failure.
+ * Returns length of the field, 0 if the key can't name a field.
  */
-int
-event_search(char *fmt)
+static size_t
+key_field(const char *kv_pair, char *field, size_t size)
 {
-    int i = 0;
-    if(fmt == NULL) {
-        return -1;
+    const char *value = strchr(kv_pair, '=');
+    size_t prefix = strlen(EVENT_KEY_FIELD_PREFIX), key = 0, len = 0;
+    size_t i = 0;
+    char c;
+    if((value == NULL) || (value == kv_pair)) {
+        return 0;
     }
-    /* Loop till we either match event name or
-     * we reach the delimter which is EV_TBD_TBD */
-    while(i < MAX_EVENT_TABLE_SIZE)
+    key = value - kv_pair;
+    len = prefix + key + strlen(value);
+    if(((prefix + key) > MAX_JOURNAL_FIELD_NAME) || (len >= size)) {
+        return 0;
+    }
+    memcpy(field, EVENT_KEY_FIELD_PREFIX, prefix);
+    for(i = 0; i < key; i++)
     {
-        if(!strcmp_with_nullcheck(fmt, ev_table[i].event_name)) {
-            return i;
+        c = kv_pair[i];
+        if((c >= 'a') && (c <= 'z')) {
+            c = c - 'a' + 'A';
         }
-        if(!strcmp_with_nullcheck(EVENT_NAME_DELIMITER_STR,
-                    ev_table[i].event_description)) {
-            break;
+        else if(!(((c >= 'A') && (c <= 'Z')) || ((c >= '0') && (c <= '9')))) {
+            c = '_';
         }
-        i++;
+        field[prefix + i] = c;
     }
-    return i;
+    memcpy(field + prefix + key, value, strlen(value) + 1);
+    return len;
 }
 
-/* severity_level
- * To convert severity string to severity value.
+/* event_message_grow
+ * Grows the message buffer of the reader to hold at least size bytes,
+ * keeping what is in it. Buffers stay with the reader record for the
+ * next thread taking it over.
  *
- * Returns -1 on failure & severity value on success
+ * Returns 0 on success, -1 on failure.
  */
-int
-severity_level(char *arg)
+static int
+event_message_grow(struct event_reader *r, size_t size)
 {
-    const char *sev[] = {"LOG_EMERG","LOG_ALERT","LOG_CRIT","LOG_ERR",
-                         "LOG_WARN","LOG_NOTICE","LOG_INFO","LOG_DEBUG"};
-    int i, found = 0;
-    for(i = 0; i < MAX_SEV_LEVELS; i++)
-    {
-        if(!strcmp_with_nullcheck(arg, sev[i])) {
-            found = TRUE;
-            break;
-        }
+    char *message = NULL;
+    if(size <= r->message_size) {
+        return 0;
     }
-    if(found) {
-        return i;
+    if(size < EVENT_MESSAGE_SIZE) {
+        size = EVENT_MESSAGE_SIZE;
     }
-    return -1;
+    message = (char*)realloc(r->message, size);
+    if(message == NULL) {
+        VLOG_ERR("Failed to allocate %zu bytes for event message", size);
+        return -1;
+    }
+    r->message = message;
+    r->message_size = size;
+    return 0;
 }
 
-/* log_event
- * API used to log the event logs.
+/* event_send
+ * Renders the event at index of the catalog & sends it to journal.
+ * The journal iovec points at the fields pre-rendered in the event
+ * catalog, only the message & the key fields are rendered, the
+ * message in to the buffer of the reader record of the thread, grown
+ * & rendered again if it is too short. Every key is sent as a journal
+ * field of its own, & the sample rate of a sampled event for counts
+ * to be scaled back.
  *
  * Returns -1 on failure & 0 on success
  */
-int
-log_event(char *ev_name,...)
+static int
+event_send(const struct event_catalog *catalog, int index,
+           char **kv, int n_kv, uint32_t sample_rate)
 {
-    int i = 0, index = 0, key_nums = 0, key_value_none = 0;
-    int ret = 0, str_size = 0;
-    va_list arg;
-    char key_value_pair[KEY_VALUE_SIZE] = {0,};
-    char all_key_value_pairs[(2*KEY_VALUE_SIZE)] = {0,};
-    char *tmp = NULL;
-    char *message = NULL;
-    char evt_msg[MAX_LOG_STR] = {0,};
-    int level = 0;
-    if(ev_name == NULL) {
+    const struct event_catalog_event *ev = &catalog->events[index];
+    struct event_reader *r = reader_self;
+    char sample_field[EVENT_FIELD_SIZE];
+    char fields[MAX_EVENT_KEYS][EVENT_KEY_FIELD_SIZE];
+    struct iovec iov[EVENT_JOURNAL_FIELDS];
+    const char *prefix = NULL;
+    size_t used = 0, len = 0;
+    int i = 0, n_iov = 0, n_fields = 0;
+    if(ev->priority < 0) {
+        VLOG_ERR("Incorrect severity level");
         return -1;
     }
-    va_start(arg, ev_name);
-    /* Search for the event in event table
-     * Fetch it's index */
-    index = event_search(ev_name);
-    if((index == (MAX_EVENT_TABLE_SIZE-1)) || (index < 0))
+    /* The message is the pre-rendered prefix followed by the
+     * description with the keys populated with their values */
+    prefix = event_catalog_str(catalog, ev->message_prefix);
+    used = strlen(prefix);
+    if((r == NULL) || (event_message_grow(r, used + 1) < 0)) {
+        return -1;
+    }
+    memcpy(r->message, prefix, used);
+    len = event_catalog_render(catalog, index, kv, n_kv, r->message + used,
+                               r->message_size - used);
+    if(len >= (r->message_size - used)) {
+        if(event_message_grow(r, used + len + 1) < 0) {
+            return -1;
+        }
+        event_catalog_render(catalog, index, kv, n_kv, r->message + used,
+                             r->message_size - used);
+    }
+    used += len;
+    iov[n_iov].iov_base = r->message;
+    iov[n_iov++].iov_len = used;
+    iov[n_iov].iov_base = (void*)event_catalog_str(catalog,
+                                                   ev->priority_field);
+    iov[n_iov].iov_len = strlen(iov[n_iov].iov_base);
+    n_iov++;
+    iov[n_iov].iov_base = MESSAGE_ID_FIELD;
+    iov[n_iov++].iov_len = strlen(MESSAGE_ID_FIELD);
+    iov[n_iov].iov_base = (void*)event_catalog_str(catalog, ev->id_field);
+    iov[n_iov].iov_len = strlen(iov[n_iov].iov_base);
+    n_iov++;
+    iov[n_iov].iov_base = (void*)event_catalog_str(catalog,
+                          catalog->categories[ev->category].field);
+    iov[n_iov].iov_len = strlen(iov[n_iov].iov_base);
+    n_iov++;
+    if(sample_rate > 1) {
+        iov[n_iov].iov_base = sample_field;
+        iov[n_iov++].iov_len = snprintf(sample_field, sizeof(sample_field),
+                                        EVENT_SAMPLE_RATE_FIELD "%u",
+                                        sample_rate);
+    }
+    for(i = 0; i < n_kv; i++)
     {
-        ret = sd_journal_send("ops-evt|Unknown Event Name %s", ev_name,
-                "MESSAGE_ID=%s", MESSAGE_OPS_EVT,
-                NULL);
-        if(ret != 0) {
-            VLOG_ERR("sd_journal_send failed with %d", ret);
+        len = key_field(kv[i], fields[n_fields], sizeof(fields[n_fields]));
+        if(len > 0) {
+            iov[n_iov].iov_base = fields[n_fields++];
+            iov[n_iov++].iov_len = len;
         }
+    }
+    return event_journal_send(iov, n_iov);
+}
+
+/* event_emit
+ * Sends the event at index of the catalog, counting it as emitted or
+ * failed.
+ *
+ * Returns -1 on failure & 0 on success
+ */
+static int
+event_emit(struct event_log_state *es, int index, char **kv, int n_kv)
+{
+    struct event_counters *counters = &es->counters[index];
+    struct timespec now;
+    if(event_send(es->catalog, index, kv, n_kv,
+                  __atomic_load_n(&es->sample_rates[index],
+                                  __ATOMIC_RELAXED)) != 0) {
+        __atomic_add_fetch(&counters->failed, 1, __ATOMIC_RELAXED);
         return -1;
     }
-    str_size = strlen(ev_table[index].event_description);
-    if(str_size < MAX_LOG_STR) {
-        strncpy(evt_msg, ev_table[index].event_description, (str_size+1));
+    clock_gettime(CLOCK_REALTIME, &now);
+    __atomic_add_fetch(&counters->emitted, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&counters->last_emitted,
+                     ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000),
+                     __ATOMIC_RELAXED);
+    return 0;
+}
+
+/* report_suppressed
+ * Logs the summary of the events suppressed by rate limiting, once
+ * EVENT_SUPPRESSED_REPORT_INTERVAL has passed since the first of
+ * them. The summary event is logged whatever the categories this
+ * daemon registered.
+ */
+static void
+report_suppressed(struct event_log_state *es)
+{
+    char count_kv[KEY_VALUE_SIZE], seconds_kv[KEY_VALUE_SIZE];
+    char *kv[2] = { count_kv, seconds_kv };
+    unsigned long count = 0;
+    unsigned int seconds = 0;
+    int index = 0;
+
+    count = event_ratelimit_report_due(&es->ratelimit, &seconds);
+    if(count == 0) {
+        return;
+    }
+    index = event_catalog_find(es->catalog, EVENT_SUPPRESSED_EVENT);
+    if(index < 0) {
+        VLOG_WARN("%lu events suppressed by rate limiting in the last %u "
+                  "seconds", count, seconds);
+        return;
+    }
+    snprintf(count_kv, sizeof(count_kv), "count=%lu", count);
+    snprintf(seconds_kv, sizeof(seconds_kv), "interval=%u", seconds);
+    event_emit(es, index, kv, 2);
+}
+
+/* report_repeated
+ * Logs how many times an event was repeated with the same key values
+ * in a coalescing window which has closed. The summary event is logged
+ * whatever the categories this daemon registered.
+ */
+static void
+report_repeated(struct event_log_state *es,
+                const struct event_coalesce_report *report)
+{
+    char event_kv[KEY_VALUE_SIZE], id_kv[KEY_VALUE_SIZE];
+    char count_kv[KEY_VALUE_SIZE], seconds_kv[KEY_VALUE_SIZE];
+    char *kv[4] = { event_kv, id_kv, count_kv, seconds_kv };
+    const struct event_catalog *catalog = es->catalog;
+    const char *name = NULL;
+    int index = 0;
+
+    name = event_catalog_str(catalog, catalog->events[report->index].name);
+    index = event_catalog_find(catalog, EVENT_REPEATED_EVENT);
+    if(index < 0) {
+        VLOG_INFO("Last %s event repeated %lu times in %u seconds", name,
+                  report->repeats, report->seconds);
+        return;
     }
+    snprintf(event_kv, sizeof(event_kv), "event=%s", name);
+    snprintf(id_kv, sizeof(id_kv), "event_id=%d",
+             catalog->events[report->index].event_id);
+    snprintf(count_kv, sizeof(count_kv), "count=%lu", report->repeats);
+    snprintf(seconds_kv, sizeof(seconds_kv), "interval=%u", report->seconds);
+    event_emit(es, index, kv, 4);
+}
+
+/* report_coalesced
+ * Logs the repeats counted in the coalescing windows which have closed
+ * since, see report_repeated().
+ */
+static void
+report_coalesced(struct event_log_state *es)
+{
+    struct event_coalesce_report reports[EVENT_COALESCE_REPORTS];
+    int i = 0, n = 0;
+    n = event_coalesce_report_due(&es->coalesce, reports,
+                                  EVENT_COALESCE_REPORTS);
+    for(i = 0; i < n; i++)
+    {
+        report_repeated(es, &reports[i]);
+    }
+}
+
+/* log_unknown_event
+ * Logs that an event not in the catalog of this daemon was logged.
+ */
+static void
+log_unknown_event(const char *ev_name)
+{
+    char message[MAX_LOG_STR + MAX_EVENT_NAME_SIZE];
+    struct iovec iov[2];
+    __atomic_add_fetch(&ev_unknown, 1, __ATOMIC_RELAXED);
+    snprintf(message, sizeof(message),
+             "MESSAGE=ops-evt|Unknown Event Name %s", ev_name);
+    iov[0].iov_base = message;
+    iov[0].iov_len = strlen(message);
+    iov[1].iov_base = MESSAGE_ID_FIELD;
+    iov[1].iov_len = strlen(MESSAGE_ID_FIELD);
+    event_journal_send(iov, 2);
+}
+
+/* log_event_va
+ * Logs the event at index of the catalog with the "key=value"
+ * strings in arg, picked is TRUE if event_log_enabled() made the
+ * sampling pick for it.
+ *
+ * Returns -1 on failure & 0 on success
+ */
+static int
+log_event_va(struct event_log_state *es, int index, int picked,
+             va_list arg)
+{
+    const struct event_catalog *catalog = es->catalog;
+    struct event_coalesce_report report;
+    int i = 0, key_nums = 0, n_kv = 0, ret = 0;
+    char *kv[MAX_EVENT_KEYS] = {NULL,};
+    char *tmp = NULL;
     /* Get the number of key's in the event */
-    key_nums = ev_table[index].num_of_keys;
+    key_nums = catalog->events[index].num_of_keys;
     while(i < key_nums)
     {
         tmp = va_arg(arg, char*);
@@ -670,57 +1225,415 @@ log_event(char *ev_name,...)
             /* this means we don't have key-value pair at all!
              * so let's break & call journal API with just message.
              */
-            key_value_none = 1;
             break;
         }
-        str_size = strlen(tmp);
-        if(str_size < KEY_VALUE_SIZE) {
-            strncpy(key_value_pair, tmp, (str_size+1));
+        if(n_kv < MAX_EVENT_KEYS) {
+            kv[n_kv++] = tmp;
         }
-        /* Populate the key with the value in message */
-        ret = populate_str(evt_msg, key_value_pair);
-        if(ret < 0) {
-            VLOG_ERR("Failure at populate_str()");
-            return -1;
+        else {
+            free_key_value_string(tmp);
         }
-        /* Make all the key-value pair's in the form of
-         * key1=value1,key2=value,... format to pass to
-         * journal API */
-        strcat(key_value_pair, ",");
-        strncat(all_key_value_pairs, key_value_pair,
-        (sizeof(all_key_value_pairs)-strlen(all_key_value_pairs)-1));
         i++;
-        free(tmp);
     }
-    ret = asprintf(&message, "MESSAGE=ops-evt|%d|%s|%s",
-            ev_table[index].event_id, ev_table[index].severity, evt_msg);
-    if(ret < 0) {
-        VLOG_ERR("Failed to allocate memory");
+    /* Events below the severity threshold of the daemon or sampled
+     * out are dropped before anything is recorded, repeats coalesced &
+     * events over their rate limit are kept in the flight recorder but
+     * dropped before being rendered */
+    if((catalog->events[index].priority <=
+        __atomic_load_n(&ev_min_severity, __ATOMIC_RELAXED)) &&
+       event_sampled(es, index, picked)) {
+        event_recorder_add(catalog->events[index].event_id, kv, n_kv);
+        if(!event_coalesce_check(&es->coalesce, catalog, index, kv, n_kv,
+                                 &report)) {
+            __atomic_add_fetch(&es->counters[index].coalesced, 1,
+                               __ATOMIC_RELAXED);
+        }
+        else {
+            if(report.repeats) {
+                report_repeated(es, &report);
+            }
+            if(event_ratelimit_check(&es->ratelimit, catalog, index)) {
+                ret = event_emit(es, index, kv, n_kv);
+            }
+        }
+    }
+    for(i = 0; i < n_kv; i++)
+    {
+        free_key_value_string(kv[i]);
+    }
+    report_suppressed(es);
+    report_coalesced(es);
+    return ret;
+}
+
+/* log_event
+ * API used to log the event logs. Logging an event does no heap
+ * allocation once the message buffer of the thread grew to fit it,
+ * see event_send(). Events below the severity threshold
+ * set by event_log_set_severity(), events sampled out, repeats within
+ * the coalescing window & events over the rate limit set in the catalog
+ * are dropped before anything is rendered. In async mode
+ * the event is only queued for the writer thread.
+ *
+ * Returns -1 on failure & 0 on success
+ */
+int
+log_event(char *ev_name,...)
+{
+    int index = 0, ret = 0, picked = sample_pick_take();
+    va_list arg;
+    struct event_log_state *es = NULL;
+    if(ev_name == NULL) {
         return -1;
     }
-    /* Convert severity string to corresponding severity value */
-    level = severity_level(ev_table[index].severity);
-    if(level < 0) {
-        VLOG_ERR("Incorrect severity level");
+    /* Search for the event in event catalog
+     * Fetch it's index */
+    es = event_log_state_get();
+    index = event_lookup(es, ev_name);
+    if(index < 0)
+    {
+        event_log_state_put();
+        log_unknown_event(ev_name);
         return -1;
     }
-    if(key_value_none) {
-        ret = sd_journal_send(message, "PRIORITY=%d", level,
-                "MESSAGE_ID=%s", MESSAGE_OPS_EVT,"OPS_EVENT_ID=%d",
-                ev_table[index].event_id,"OPS_EVENT_CATEGORY=%s",
-                 ev_table[index].category, NULL);
+    va_start(arg, ev_name);
+    ret = log_event_va(es, index, picked == index, arg);
+    va_end(arg);
+    event_log_state_put();
+    return ret;
+}
+
+/* event_log_run
+ * Logs the summaries of suppressed & coalesced events which are due &
+ * replays the spool, which otherwise only happen with the next
+ * log_event(), & frees the states reloads replaced once no thread reads
+ * them. The writer thread calls it every EVENT_WRITER_TICK seconds in
+ * async mode, daemons logging synchronously may call it from their main
+ * loop.
+ */
+void
+event_log_run(void)
+{
+    struct event_log_state *es = NULL;
+    es = event_log_state_get();
+    if(es != NULL) {
+        report_suppressed(es);
+        report_coalesced(es);
     }
-    else {
-        ret = sd_journal_send(message, "PRIORITY=%d", level,
-                "MESSAGE_ID=%s", MESSAGE_OPS_EVT,"OPS_EVENT_ID=%d",
-                ev_table[index].event_id, "OPS_EVENT_CATEGORY=%s",
-                ev_table[index].category,
-                all_key_value_pairs,
-                NULL);
+    event_log_state_put();
+    /* Spooled events go out once journal is back, even if the daemon
+     * logs nothing more */
+    if(event_spool_pending()) {
+        event_spool_drain(FALSE);
     }
-    if(ret != 0) {
-        VLOG_ERR("sd_journal_send failed with %d", ret);
+    /* Frees what reloads replaced once its readers are done with it */
+    if(__atomic_load_n(&ev_retired, __ATOMIC_RELAXED) &&
+       (pthread_mutex_trylock(&event_log_mutex) == 0)) {
+        event_log_reap(ev_state);
+        pthread_mutex_unlock(&event_log_mutex);
     }
-    free(message);
+}
+
+/* event_index_valid
+ * Checks that the catalog event at index is the event the generated
+ * ops_events.h header knows with the given ID, the header may come from
+ * another version of the yaml file than the catalog, & that the daemon
+ * registered its category.
+ *
+ * Returns TRUE if valid, FALSE otherwise.
+ */
+static int
+event_index_valid(const struct event_log_state *es, int index,
+                  int event_id)
+{
+    if((es == NULL) || (index < 0) ||
+       (index >= (int)es->catalog->hdr->n_events) ||
+       (es->catalog->events[index].event_id != event_id)) {
+        return FALSE;
+    }
+    return __atomic_load_n(
+           &es->registered[es->catalog->events[index].category],
+           __ATOMIC_ACQUIRE);
+}
+
+/* log_event_index
+ * Logs an event by its index in the catalog, as the functions of the
+ * generated ops_events.h header do, saving the name lookup. Falls back
+ * to the lookup by name if the index doesn't match the catalog.
+ *
+ * Returns -1 on failure & 0 on success
+ */
+int
+log_event_index(int index, int event_id, char *ev_name, ...)
+{
+    struct event_log_state *es = NULL;
+    va_list arg;
+    int ret = 0, picked = sample_pick_take();
+    es = event_log_state_get();
+    if(!event_index_valid(es, index, event_id)) {
+        index = event_lookup(es, ev_name);
+        if(index < 0) {
+            event_log_state_put();
+            log_unknown_event(ev_name);
+            return -1;
+        }
+    }
+    va_start(arg, ev_name);
+    ret = log_event_va(es, index, picked == index, arg);
+    va_end(arg);
+    event_log_state_put();
+    return ret;
+}
+
+/* event_log_index_enabled
+ * Same as event_log_enabled() for an event logged by its index.
+ *
+ * Returns TRUE if the event is to be logged, FALSE otherwise
+ */
+int
+event_log_index_enabled(int index, int event_id)
+{
+    struct event_log_state *es = NULL;
+    int ret = TRUE;
+    es = event_log_state_get();
+    if(event_index_valid(es, index, event_id)) {
+        ret = event_enabled(es, index);
+    }
+    event_log_state_put();
     return ret;
 }
+
+/* event_stats_read
+ * Reads the counters of the event at index of the catalog.
+ */
+static void
+event_stats_read(struct event_log_state *es, int index,
+                 struct event_log_stats *stats)
+{
+    struct event_counters *counters = &es->counters[index];
+    stats->emitted = __atomic_load_n(&counters->emitted, __ATOMIC_RELAXED);
+    stats->suppressed = __atomic_load_n(
+                        &es->ratelimit.events[index].suppressed,
+                        __ATOMIC_RELAXED);
+    stats->failed = __atomic_load_n(&counters->failed, __ATOMIC_RELAXED);
+    stats->coalesced = __atomic_load_n(&counters->coalesced, __ATOMIC_RELAXED);
+    stats->last_emitted = __atomic_load_n(&counters->last_emitted,
+                                          __ATOMIC_RELAXED);
+}
+
+/* event_log_stats
+ * Gets the counters of the event since the daemon started.
+ *
+ * Returns 0 on success & -1 if the event is not in the catalog
+ */
+int
+event_log_stats(char *ev_name, struct event_log_stats *stats)
+{
+    struct event_log_state *es = NULL;
+    int index = -1;
+    es = event_log_state_get();
+    if((es != NULL) && (ev_name != NULL)) {
+        index = event_catalog_find(es->catalog, ev_name);
+    }
+    if(index >= 0) {
+        event_stats_read(es, index, stats);
+    }
+    event_log_state_put();
+    return (index >= 0) ? 0 : -1;
+}
+
+/* event_log_unknown_events
+ * Returns the number of events logged with a name not in the catalog
+ * of this daemon.
+ */
+unsigned long
+event_log_unknown_events(void)
+{
+    return __atomic_load_n(&ev_unknown, __ATOMIC_RELAXED);
+}
+
+/* Event & its counters, as listed by eventlog/stats */
+struct event_stats_entry {
+    int index;
+    struct event_log_stats stats;
+};
+
+/* event_stats_compare
+ * qsort() comparator putting the events logged most first.
+ */
+static int
+event_stats_compare(const void *a, const void *b)
+{
+    const struct event_stats_entry *x = a, *y = b;
+    unsigned long nx = 0, ny = 0;
+    nx = x->stats.emitted + x->stats.suppressed + x->stats.failed +
+         x->stats.coalesced;
+    ny = y->stats.emitted + y->stats.suppressed + y->stats.failed +
+         y->stats.coalesced;
+    if(nx != ny) {
+        return (nx < ny) ? 1 : -1;
+    }
+    return x->index - y->index;
+}
+
+/* event_stats_print
+ * Prints a line of eventlog/stats for the event.
+ */
+static void
+event_stats_print(FILE *fp, const struct event_catalog *catalog,
+                  const struct event_stats_entry *entry)
+{
+    char last[EVENT_FIELD_SIZE] = "-";
+    time_t secs = entry->stats.last_emitted / 1000000;
+    struct tm tm;
+    if(entry->stats.last_emitted && localtime_r(&secs, &tm)) {
+        strftime(last, sizeof(last), "%Y-%m-%d %H:%M:%S", &tm);
+    }
+    fprintf(fp, "%-32s %6d %10lu %10lu %10lu %8lu  %s\n",
+            event_catalog_str(catalog, catalog->events[entry->index].name),
+            catalog->events[entry->index].event_id, entry->stats.emitted,
+            entry->stats.suppressed, entry->stats.coalesced,
+            entry->stats.failed, last);
+}
+
+/* eventlog_unixctl_stats
+ * unixctl handler of "eventlog/stats [EVENT]", lists the counters of
+ * the events this daemon logged, most logged first, or of the given
+ * event.
+ */
+static void
+eventlog_unixctl_stats(struct unixctl_conn *conn, int argc,
+                       const char *argv[], void *aux OVS_UNUSED)
+{
+    struct event_log_state *es = NULL;
+    struct event_stats_entry *entries = NULL;
+    struct event_log_async_stats async;
+    struct event_log_spool_stats spool;
+    char *reply = NULL;
+    size_t size = 0;
+    FILE *fp = NULL;
+    uint32_t i = 0, n = 0;
+    int index = -1;
+
+    /* Summaries due are logged first, so that they are counted */
+    event_log_run();
+    es = event_log_state_get();
+    if(argc > 1) {
+        index = event_catalog_find(es->catalog, argv[1]);
+        if(index < 0) {
+            unixctl_command_reply_error(conn, "Unknown event");
+            event_log_state_put();
+            return;
+        }
+    }
+    entries = (struct event_stats_entry*)calloc(es->catalog->hdr->n_events + 1,
+                                                sizeof(*entries));
+    fp = open_memstream(&reply, &size);
+    if((entries == NULL) || (fp == NULL)) {
+        free(entries);
+        if(fp) {
+            fclose(fp);
+            free(reply);
+        }
+        unixctl_command_reply_error(conn, "Out of memory");
+        event_log_state_put();
+        return;
+    }
+    for(i = 0; i < es->catalog->hdr->n_events; i++)
+    {
+        if((index >= 0) && ((int)i != index)) {
+            continue;
+        }
+        entries[n].index = i;
+        event_stats_read(es, i, &entries[n].stats);
+        if((index >= 0) || entries[n].stats.emitted ||
+           entries[n].stats.suppressed || entries[n].stats.failed ||
+           entries[n].stats.coalesced) {
+            n++;
+        }
+    }
+    qsort(entries, n, sizeof(*entries), event_stats_compare);
+    fprintf(fp, "Unknown event names: %lu\n", event_log_unknown_events());
+    event_log_async_stats(&async);
+    if(async.queued || async.dropped_new || async.spooled) {
+        fprintf(fp, "Async writer: %lu queued, %lu written, %lu failed, "
+                "%lu dropped, %lu spooled\n", async.queued, async.written,
+                async.failed, async.dropped_oldest + async.dropped_new,
+                async.spooled);
+    }
+    event_log_spool_stats(&spool);
+    if(spool.spooled || spool.dropped) {
+        fprintf(fp, "Spool: %lu spooled, %lu replayed, %lu dropped, "
+                "%lu rejected, %lu pending\n", spool.spooled,
+                spool.replayed, spool.dropped, spool.rejected,
+                spool.pending);
+    }
+    fprintf(fp, "%-32s %6s %10s %10s %10s %8s  %s\n", "Event", "ID",
+            "Emitted", "Suppressed", "Coalesced", "Failed", "Last emitted");
+    for(i = 0; i < n; i++)
+    {
+        event_stats_print(fp, es->catalog, &entries[i]);
+    }
+    event_log_state_put();
+    fclose(fp);
+    unixctl_command_reply(conn, reply);
+    free(reply);
+    free(entries);
+}
+
+/* event_log_diag_dump
+ * Renders the flight recorder of this daemon, the events it logged
+ * last, oldest first. It has the signature of the diag-dump basic
+ * callback, a daemon can register it with INIT_DIAG_DUMP_BASIC() or
+ * call it from its own. The buffer is freed by the caller.
+ */
+void
+event_log_diag_dump(const char *feature OVS_UNUSED, char **buf)
+{
+    struct event_log_state *es = NULL;
+    size_t size = 0;
+    FILE *fp = NULL;
+
+    *buf = NULL;
+    es = event_log_state_get();
+    if((es != NULL) && ((fp = open_memstream(buf, &size)) != NULL)) {
+        event_recorder_dump(fp, es->catalog);
+        fclose(fp);
+    }
+    event_log_state_put();
+}
+
+/* eventlog_unixctl_recorder
+ * unixctl handler of "eventlog/recorder", dumps the flight recorder.
+ */
+static void
+eventlog_unixctl_recorder(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                          const char *argv[] OVS_UNUSED, void *aux OVS_UNUSED)
+{
+    char *reply = NULL;
+    event_log_diag_dump(NULL, &reply);
+    if(reply == NULL) {
+        unixctl_command_reply_error(conn, "Out of memory");
+        return;
+    }
+    unixctl_command_reply(conn, reply);
+    free(reply);
+}
+
+/* eventlog_unixctl_drain
+ * unixctl handler of "eventlog/drain", replays the events spooled while
+ * journal didn't take them right away.
+ */
+static void
+eventlog_unixctl_drain(struct unixctl_conn *conn, int argc OVS_UNUSED,
+                       const char *argv[] OVS_UNUSED, void *aux OVS_UNUSED)
+{
+    struct event_log_spool_stats spool;
+    char reply[128];
+    int ret = event_log_spool_drain();
+    event_log_spool_stats(&spool);
+    snprintf(reply, sizeof(reply), "%lu events replayed, %lu pending%s",
+             spool.replayed, spool.pending,
+             ret ? ", journal is not taking events" : "");
+    unixctl_command_reply(conn, reply);
+}
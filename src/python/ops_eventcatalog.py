@@ -0,0 +1,527 @@
+#!/usr/bin/env python
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+# All Rights Reserved.
+#
+#    Licensed under the Apache License, Version 2.0 (the "License"); you may
+#    not use this file except in compliance with the License. You may obtain
+#    a copy of the License at
+#
+#         http://www.apache.org/licenses/LICENSE-2.0
+#
+#    Unless required by applicable law or agreed to in writing, software
+#    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+#    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+#    License for the specific language governing permissions and limitations
+#    under the License.
+
+# Compiles ops_events.yaml in to the binary event catalog which the
+# eventlog library maps read-only in event_log_init(). The layout must
+# match include/event_catalog.h, bump CATALOG_VERSION on both sides for
+# any change to it.
+
+import mmap
+import os
+import re
+import struct
+import sys
+import yaml
+
+CATALOG_MAGIC = b'OPSEVCAT'
+CATALOG_VERSION = 6
+
+# Limit the C library applies to the severity it loads
+MAX_SEV_NAME_SIZE = 10
+
+HEADER_FMT = '8sIIQIIIIIIIIII'
+EVENT_FMT = 'IIIiiIIIiIIIIIII'
+CATEGORY_FMT = 'IIII'
+SEGMENT_FMT = 'III'
+
+SEVERITIES = ['LOG_EMERG', 'LOG_ALERT', 'LOG_CRIT', 'LOG_ERR',
+              'LOG_WARN', 'LOG_NOTICE', 'LOG_INFO', 'LOG_DEBUG']
+CATEGORY_FIELD = 'OPS_EVENT_CATEGORY='
+# Shared memory segment the C library publishes a catalog built from the
+# yaml file in, same as EVENT_CATALOG_SHM_NAME
+SHM_PATH = '/dev/shm/ops_events.v%d.%016x'
+
+SEGMENT_LITERAL = 0
+SEGMENT_KEY = 1
+
+EV_CATEGORY = "event_category"
+EV_DEFINITION = "event_definitions"
+EV_NAME = "event_name"
+EV_ID = "event_ID"
+EV_SEVERITY = "severity"
+EV_KEYS = "keys"
+EV_DESCRIPTION_YAML = "event_description_template"
+EV_CATEGORIES = "categories"
+EV_RATE_LIMIT = "rate_limit"
+EV_RATE_BURST = "rate_burst"
+EV_COALESCE_WINDOW = "coalesce_window"
+EV_SAMPLE_RATE = "sample_rate"
+
+
+# Function          : fnv1a_32
+# Responsibility    : Hash of event names, same as event_name_hash() in C
+def fnv1a_32(data):
+    h = 2166136261
+    for c in bytearray(data):
+        h ^= c
+        h = (h * 16777619) & 0xffffffff
+    return h
+
+
+# Function          : fnv1a_64
+# Responsibility    : Hash of the yaml file used to detect a stale catalog
+def fnv1a_64(data):
+    h = 14695981039346656037
+    for c in bytearray(data):
+        h ^= c
+        h = (h * 1099511628211) & 0xffffffffffffffff
+    return h
+
+
+def _align(n):
+    return (n + 7) & ~7
+
+
+def _string(value):
+    return '' if value is None else str(value)
+
+
+def _bounded(value, limit):
+    # The C loader drops severities which don't fit its prefix field
+    value = '' if value is None else str(value)
+    if len(value.encode('utf-8')) >= limit:
+        return ''
+    return value
+
+
+def _count_keys(keys):
+    if keys is None:
+        return 0
+    return len([k for k in str(keys).split(',') if k != ''])
+
+
+def _key_names(keys):
+    # Events without keys say NA
+    if keys is None or str(keys).strip() == 'NA':
+        return []
+    return [k.strip() for k in str(keys).split(',') if k.strip() != '']
+
+
+def _rate(value):
+    try:
+        return max(int(value), 0)
+    except (TypeError, ValueError):
+        return 0
+
+
+# Function          : rate_limits
+# Responsibility    : Resolve the rate limit of an event, same as
+#                     rate_limits() in event_catalog.c. Settings of the
+#                     event override those of its category, the burst
+#                     defaults to the rate the event ends up with.
+def rate_limits(ev, category):
+    category = category or {}
+    rate = 0
+    if EV_RATE_LIMIT in ev:
+        rate = _rate(ev[EV_RATE_LIMIT])
+    elif EV_RATE_LIMIT in category:
+        rate = _rate(category[EV_RATE_LIMIT])
+    burst = rate
+    if EV_RATE_BURST in ev:
+        burst = _rate(ev[EV_RATE_BURST])
+    elif EV_RATE_LIMIT not in ev and EV_RATE_BURST in category:
+        burst = _rate(category[EV_RATE_BURST])
+    if rate == 0:
+        burst = 0
+    return rate, burst
+
+
+# Function          : coalesce_window
+# Responsibility    : Resolve the window duplicates of an event are
+#                     coalesced over, same as coalesce_window() in
+#                     event_catalog.c. The setting of the event overrides
+#                     that of its category.
+def coalesce_window(ev, category):
+    category = category or {}
+    if EV_COALESCE_WINDOW in ev:
+        return _rate(ev[EV_COALESCE_WINDOW])
+    if EV_COALESCE_WINDOW in category:
+        return _rate(category[EV_COALESCE_WINDOW])
+    return 0
+
+
+# Function          : sample_rate
+# Responsibility    : Resolve the sampling of an event, same as
+#                     sample_rate() in event_catalog.c. The setting of the
+#                     event overrides that of its category, N logs the
+#                     event 1 in N times.
+def sample_rate(ev, category):
+    category = category or {}
+    rate = 1
+    if EV_SAMPLE_RATE in ev:
+        rate = _rate(ev[EV_SAMPLE_RATE])
+    elif EV_SAMPLE_RATE in category:
+        rate = _rate(category[EV_SAMPLE_RATE])
+    return max(rate, 1)
+
+
+# Function          : load_events
+# Responsibility    : Parse the yaml file content in to event & category
+#                     lists ordered the same way as the C loader does
+def load_events(yaml_data):
+    doc = yaml.safe_load(yaml_data)
+    categories = []
+    by_category = {}
+    category_rates = {}
+    for cat in (doc or {}).get(EV_CATEGORIES) or []:
+        name = cat.get(EV_CATEGORY)
+        if name is not None and str(name) not in category_rates:
+            category_rates[str(name)] = cat
+    for ev in (doc or {}).get(EV_DEFINITION) or []:
+        cat = ev.get(EV_CATEGORY)
+        if cat is None:
+            continue
+        cat = str(cat)
+        if cat not in by_category:
+            by_category[cat] = []
+            categories.append(cat)
+        rate, burst = rate_limits(ev, category_rates.get(cat))
+        by_category[cat].append({
+            'name': _string(ev.get(EV_NAME)),
+            'id': int(ev.get(EV_ID) or 0),
+            'severity': _bounded(ev.get(EV_SEVERITY), MAX_SEV_NAME_SIZE),
+            'keys': _count_keys(ev.get(EV_KEYS)),
+            'key_names': _key_names(ev.get(EV_KEYS)),
+            'description': _string(ev.get(EV_DESCRIPTION_YAML)),
+            'rate_limit': rate,
+            'rate_burst': burst,
+            'coalesce_window': coalesce_window(ev, category_rates.get(cat)),
+            'sample_rate': sample_rate(ev, category_rates.get(cat)),
+        })
+    events = []
+    ranges = []
+    for cat in categories:
+        ranges.append((cat, len(events), len(by_category[cat])))
+        for ev in by_category[cat]:
+            ev['category'] = len(ranges) - 1
+            events.append(ev)
+    return events, ranges
+
+
+# Function          : compile_template
+# Responsibility    : Split the template at offset off of the string arena
+#                     in to literal & {key} placeholder segments, same as
+#                     compile_template() in event_catalog.c
+def compile_template(tmpl, off):
+    data = bytearray(tmpl.encode('utf-8'))
+    lbrace, rbrace = ord('{'), ord('}')
+    segs = []
+    i = literal = 0
+    while i < len(data):
+        if data[i] == lbrace:
+            j = i + 1
+            while j < len(data) and data[j] not in (lbrace, rbrace):
+                j += 1
+            if j < len(data) and data[j] == rbrace and j > i + 1:
+                if i > literal:
+                    segs.append((SEGMENT_LITERAL, off + literal, i - literal))
+                segs.append((SEGMENT_KEY, off + i + 1, j - (i + 1)))
+                i = literal = j + 1
+                continue
+        i += 1
+    if len(data) > literal:
+        segs.append((SEGMENT_LITERAL, off + literal, len(data) - literal))
+    return segs
+
+
+# Function          : event_fields
+# Responsibility    : Render the constant journal fields of an event, same
+#                     as event_fields() in event_catalog.c
+def event_fields(ev):
+    level = -1
+    if ev['severity'] in SEVERITIES:
+        level = SEVERITIES.index(ev['severity'])
+    prefix = 'MESSAGE=ops-evt|%d|%s|' % (ev['id'], ev['severity'])
+    priority = 'PRIORITY=%d' % level if level >= 0 else ''
+    return level, prefix, priority, 'OPS_EVENT_ID=%d' % ev['id']
+
+
+class _Strings(object):
+    def __init__(self):
+        self.data = bytearray(b'\0')
+
+    def add(self, s):
+        if not s:
+            return 0
+        off = len(self.data)
+        self.data += s.encode('utf-8') + b'\0'
+        return off
+
+
+# Function          : compile_catalog
+# Responsibility    : Build the binary catalog image from yaml file content
+def compile_catalog(yaml_data, byteorder='<'):
+    events, ranges = load_events(yaml_data)
+    strings = _Strings()
+    cat_recs = []
+    for name, first, count in ranges:
+        cat_recs.append((strings.add(name), first, count,
+                         strings.add(CATEGORY_FIELD + name)))
+    ev_recs = []
+    seg_recs = []
+    for ev in events:
+        name = strings.add(ev['name'])
+        severity = strings.add(ev['severity'])
+        description = strings.add(ev['description'])
+        segs = compile_template(ev['description'], description)
+        level, prefix, priority, id_field = event_fields(ev)
+        ev_recs.append((name, severity, description, ev['id'], ev['keys'],
+                        ev['category'], len(seg_recs), len(segs), level,
+                        strings.add(prefix), strings.add(priority),
+                        strings.add(id_field), ev['rate_limit'],
+                        ev['rate_burst'], ev['coalesce_window'],
+                        ev['sample_rate']))
+        seg_recs.extend(segs)
+
+    n_buckets = 16
+    while n_buckets < 2 * len(events):
+        n_buckets *= 2
+    buckets = [0] * n_buckets
+    for i, ev in enumerate(events):
+        if not ev['name']:
+            continue
+        name = ev['name'].encode('utf-8')
+        b = fnv1a_32(name) & (n_buckets - 1)
+        while buckets[b] != 0:
+            if events[buckets[b] - 1]['name'].encode('utf-8') == name:
+                break
+            b = (b + 1) & (n_buckets - 1)
+        if buckets[b] == 0:
+            buckets[b] = i + 1
+
+    events_off = _align(struct.calcsize(byteorder + HEADER_FMT))
+    categories_off = _align(events_off +
+                            len(ev_recs) * struct.calcsize(EVENT_FMT))
+    buckets_off = _align(categories_off +
+                         len(cat_recs) * struct.calcsize(CATEGORY_FMT))
+    segments_off = _align(buckets_off + 4 * n_buckets)
+    strings_off = _align(segments_off +
+                         len(seg_recs) * struct.calcsize(SEGMENT_FMT))
+    size = _align(strings_off + len(strings.data))
+
+    image = bytearray(size)
+    struct.pack_into(byteorder + HEADER_FMT, image, 0,
+                     CATALOG_MAGIC, CATALOG_VERSION, size,
+                     fnv1a_64(yaml_data), len(ev_recs), len(cat_recs),
+                     n_buckets, events_off, categories_off, buckets_off,
+                     segments_off, len(seg_recs), strings_off,
+                     len(strings.data))
+    off = events_off
+    for rec in ev_recs:
+        struct.pack_into(byteorder + EVENT_FMT, image, off, *rec)
+        off += struct.calcsize(EVENT_FMT)
+    off = categories_off
+    for rec in cat_recs:
+        struct.pack_into(byteorder + CATEGORY_FMT, image, off, *rec)
+        off += struct.calcsize(CATEGORY_FMT)
+    struct.pack_into(byteorder + '%dI' % n_buckets, image, buckets_off,
+                     *buckets)
+    off = segments_off
+    for rec in seg_recs:
+        struct.pack_into(byteorder + SEGMENT_FMT, image, off, *rec)
+        off += struct.calcsize(SEGMENT_FMT)
+    image[strings_off:strings_off + len(strings.data)] = strings.data
+    return bytes(image)
+
+
+def _c_str(image, strings_off, off):
+    end = image.find(b'\0', strings_off + off)
+    return image[strings_off + off:end].decode('utf-8')
+
+
+# Function          : read_catalog
+# Responsibility    : Read the events back from a catalog image, None if
+#                     it isn't a valid one for the yaml file hash given
+def read_catalog(image, yaml_hash, byteorder='<'):
+    hdr_size = struct.calcsize(byteorder + HEADER_FMT)
+    if len(image) < hdr_size:
+        return None
+    (magic, version, size, image_hash, n_events, n_categories, _,
+     events_off, categories_off, _, _, _, strings_off,
+     strings_size) = struct.unpack_from(byteorder + HEADER_FMT, image, 0)
+    if (magic != CATALOG_MAGIC or version != CATALOG_VERSION or
+            size != len(image) or image_hash != yaml_hash or
+            strings_off + strings_size > size):
+        return None
+    ev_size = struct.calcsize(byteorder + EVENT_FMT)
+    cat_size = struct.calcsize(byteorder + CATEGORY_FMT)
+    categories = []
+    for i in range(n_categories):
+        rec = struct.unpack_from(byteorder + CATEGORY_FMT, image,
+                                 categories_off + i * cat_size)
+        categories.append(_c_str(image, strings_off, rec[0]))
+    events = []
+    for i in range(n_events):
+        rec = struct.unpack_from(byteorder + EVENT_FMT, image,
+                                 events_off + i * ev_size)
+        events.append({
+            'name': _c_str(image, strings_off, rec[0]),
+            'severity': _c_str(image, strings_off, rec[1]),
+            'description': _c_str(image, strings_off, rec[2]),
+            'id': rec[3],
+            'keys': rec[4],
+            'category': categories[rec[5]],
+        })
+    return events
+
+
+# Function          : attach_catalog
+# Responsibility    : Read the events from the catalog a daemon published
+#                     in shared memory for this yaml file content, None
+#                     if there is none to use
+def attach_catalog(yaml_data):
+    yaml_hash = fnv1a_64(yaml_data)
+    try:
+        with open(SHM_PATH % (CATALOG_VERSION, yaml_hash), 'rb') as f:
+            st = os.fstat(f.fileno())
+            # Same checks as attach_catalog_shm() in event_catalog.c
+            if (st.st_uid not in (0, os.geteuid()) or
+                    st.st_mode & 0o022):
+                return None
+            image = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    except (IOError, OSError, ValueError):
+        return None
+    try:
+        return read_catalog(image, yaml_hash)
+    except (struct.error, IndexError, UnicodeDecodeError):
+        return None
+    finally:
+        image.close()
+
+
+C_IDENTIFIER = re.compile(r'^[A-Za-z_][A-Za-z0-9_]*$')
+# C & C++ keywords a key can't be named as a parameter
+C_KEYWORDS = frozenset([
+    'auto', 'bool', 'break', 'case', 'catch', 'char', 'class', 'const',
+    'continue', 'default', 'delete', 'do', 'double', 'else', 'enum',
+    'explicit', 'extern', 'false', 'float', 'for', 'friend', 'goto', 'if',
+    'inline', 'int', 'long', 'namespace', 'new', 'operator', 'private',
+    'protected', 'public', 'register', 'restrict', 'return', 'short',
+    'signed', 'sizeof', 'static', 'struct', 'switch', 'template', 'this',
+    'throw', 'true', 'try', 'typedef', 'typename', 'union', 'unsigned',
+    'using', 'virtual', 'void', 'volatile', 'while'])
+
+HEADER_PROLOGUE = """\
+/* Generated from %s by ops_eventcatalog.py, do not edit. */
+
+/************************************************************************//**
+ * @ingroup ops_supportability
+ *
+ * @file
+ * Typed event logging API.
+ *
+ * OPS_EV_<EVENT> is the index of the event in the event catalog and
+ * log_event_<EVENT>() takes one argument per key of the event, so an
+ * event is logged without looking its name up and a wrong number of
+ * keys fails to compile. The event category still has to be registered
+ * with event_log_init().
+ ***************************************************************************/
+
+#ifndef __OPS_EVENTS_H_
+#define __OPS_EVENTS_H_
+
+#include <stddef.h>
+#include "eventlog.h"
+
+"""
+
+
+def _c_string(value):
+    return '"%s"' % value.replace('\\', '\\\\').replace('"', '\\"')
+
+
+def _parameters(keys):
+    params = []
+    for key in keys:
+        name = re.sub('[^A-Za-z0-9_]', '_', key)
+        if not C_IDENTIFIER.match(name) or name in C_KEYWORDS:
+            name += '_'
+            if not C_IDENTIFIER.match(name):
+                name = '_' + name
+        while name in params:
+            name += '_'
+        params.append(name)
+    return params
+
+
+# Function          : compile_header
+# Responsibility    : Generate the typed event logging header from yaml
+#                     file content, the enum values are the indexes the
+#                     events have in the catalog compile_catalog() builds
+def compile_header(yaml_data, source):
+    events, ranges = load_events(yaml_data)
+    out = [HEADER_PROLOGUE % source, 'enum ops_event {\n']
+    seen = set()
+    typed = []
+    for i, ev in enumerate(events):
+        if not C_IDENTIFIER.match(ev['name']) or ev['name'] in seen:
+            continue
+        seen.add(ev['name'])
+        typed.append(ev)
+        out.append('    OPS_EV_%s = %d,\n' % (ev['name'], i))
+    out.append('    OPS_EV_MAX = %d\n};\n' % len(events))
+    for ev in typed:
+        params = _parameters(ev['key_names'])
+        func = 'log_event_%s(' % ev['name']
+        if params:
+            decl = (',\n' + ' ' * len(func)).join(
+                ['const char *%s' % p for p in params])
+        else:
+            decl = 'void'
+        index = 'OPS_EV_%s, %d' % (ev['name'], ev['id'])
+        out.append('\n/* %s */\n' % ev['description'].replace('*/', '* /'))
+        out.append('static inline int\n%s%s)\n{\n' % (func, decl))
+        out.append('    if(!event_log_index_enabled(%s)) {\n'
+                   '        return 0;\n    }\n' % index)
+        call = '    return log_event_index('
+        args = [index, '(char*)%s' % _c_string(ev['name'])]
+        for key, param in zip(ev['key_names'], params):
+            args.append('EV_KV((char*)%s, "%%s", %s)'
+                        % (_c_string(key), param))
+        args.append('NULL')
+        out.append(call + (',\n' + ' ' * len(call)).join(args) + ');\n}\n')
+    out.append('\n#endif /* __OPS_EVENTS_H_ */\n')
+    return ''.join(out)
+
+
+def main(argv):
+    args = list(argv[1:])
+    byteorder = '<'
+    header = False
+    if args and args[0] == '--big-endian':
+        byteorder = '>'
+        args = args[1:]
+    elif args and args[0] == '--header':
+        header = True
+        args = args[1:]
+    if len(args) != 2:
+        sys.stderr.write('usage: %s [--big-endian | --header] <events.yaml> '
+                         '<output>\n' % argv[0])
+        return 1
+    with open(args[0], 'rb') as f:
+        yaml_data = f.read()
+    if header:
+        with open(args[1], 'w') as f:
+            f.write(compile_header(yaml_data, args[0].split('/')[-1]))
+        return 0
+    image = compile_catalog(yaml_data, byteorder)
+    with open(args[1], 'wb') as f:
+        f.write(image)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
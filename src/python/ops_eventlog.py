@@ -14,9 +14,20 @@
 #    License for the specific language governing permissions and limitations
 #    under the License.
 
+# Python API of the eventlog library. Events are logged through
+# libsupportability, the same code C daemons log them with: the event
+# catalog, severity threshold, sampling, coalescing, rate limiting &
+# async send all apply. If the library can't be loaded events are
+# rendered & sent to journal by this module instead.
+
 from systemd import journal
+import ctypes
+import ctypes.util
+import re
 import yaml
+import ovs.unixctl
 import ovs.vlog
+import ops_eventcatalog
 
 content = []
 category = []
@@ -30,53 +41,211 @@ EV_ID = "event_ID"
 EV_SEVERITY = "severity"
 EV_DESCRIPTION = "description"
 EV_DESCRIPTION_YAML = "event_description_template"
+EV_KEY_FIELD = "OPS_EVT_KEY_"
+MAX_EVENT_KEYS = 16
+SEVERITY_NAMES = ["emer", "alert", "crit", "err",
+                  "warn", "notice", "info", "debug"]
+LIBRARY_NAME = "libsupportability.so"
+
+# Overflow policies of event_log_async_enable(), see eventlog.h
+EVENT_LOG_DROP_OLDEST = 0
+EVENT_LOG_DROP_NEW = 1
+EVENT_LOG_BLOCK = 2
+EVENT_LOG_SPOOL = 3
+EV_YAML_FILE = "/etc/openswitch/supportability/ops_events.yaml"
+MESSAGE_OPS_EVT = "50c0fa81c2a545ec982a54293f1b1945"
+
+# The C parser of libyaml when python-yaml was built with it
+YAML_LOADER = getattr(yaml, 'CSafeLoader', yaml.SafeLoader)
+# A {key} of an event description template, same as compile_template()
+TEMPLATE_KEY = re.compile(r'\{([^{}]+)\}')
+
+# Event definitions of the yaml file, read once
+definitions = None
+# Events of the registered categories by name, see compile_event()
+events = {}
+# Journal field name of each key name seen, see key_fields()
+key_field_names = {}
 
 
 # Logging.
 vlog = ovs.vlog.Vlog("ops-eventlog")
 
+# Utility API to pass a key, value or name to the library as a C string.
+
+
+def c_string(value):
+    if not isinstance(value, bytes):
+        value = (u'%s' % (value,)).encode('utf-8')
+    return value
+
+# Utility API to load libsupportability & declare the functions used.
+
+
+def load_library():
+    for name in (ctypes.util.find_library('supportability'), LIBRARY_NAME):
+        if name is None:
+            continue
+        try:
+            lib = ctypes.CDLL(name)
+        except OSError:
+            continue
+        # A scratch slot of the calling thread, passed back as is
+        lib.key_value_string.restype = ctypes.c_void_p
+        lib.event_log_init.argtypes = [ctypes.c_char_p]
+        lib.event_log_enabled.argtypes = [ctypes.c_char_p]
+        lib.event_log_set_severity.argtypes = [ctypes.c_int]
+        lib.event_log_get_severity.restype = ctypes.c_int
+        lib.event_log_async_enable.argtypes = [ctypes.c_int, ctypes.c_int]
+        lib.event_log_async_disable.restype = None
+        return lib
+    vlog.warn("Failed to load %s, logging events without it" % LIBRARY_NAME)
+    return None
+
+libsupportability = load_library()
+
+# Utility API to get all event definitions, from the catalog a daemon
+# published in shared memory if any, parsing the yaml file otherwise.
+
+
+def event_definitions(data):
+    catalog = ops_eventcatalog.attach_catalog(data)
+    if catalog is not None:
+        return [{
+            EV_CATEGORY: ev['category'],
+            EV_NAME: ev['name'],
+            EV_ID: ev['id'],
+            EV_SEVERITY: ev['severity'],
+            EV_DESCRIPTION: ev['description'],
+        } for ev in catalog]
+    doc = yaml.load(data, Loader=YAML_LOADER)
+    return [{
+        EV_CATEGORY: ev[EV_CATEGORY],
+        EV_NAME: ev[EV_NAME],
+        EV_ID: ev[EV_ID],
+        EV_SEVERITY: ev[EV_SEVERITY],
+        EV_DESCRIPTION: ev[EV_DESCRIPTION_YAML],
+    } for ev in doc[EV_DEFINITION]]
+
+# Utility API to read the event definitions once for all categories.
+
+
+def load_definitions():
+    global definitions
+    if definitions is None:
+        with open(EV_YAML_FILE, 'rb') as f:
+            definitions = event_definitions(f.read())
+    return definitions
+
+# Utility API to split the description template of an event in to the
+# literal text & the keys, message parts at even indexes & key names at
+# odd ones, along with its constant journal fields.
+
+
+def compile_event(mydic):
+    ev_id = str(mydic[EV_ID])
+    severity = mydic[EV_SEVERITY]
+    parts = TEMPLATE_KEY.split(mydic[EV_DESCRIPTION])
+    fields = {
+        'MESSAGE_ID': MESSAGE_OPS_EVT,
+        'OPS_EVENT_ID': ev_id,
+        'OPS_EVENT_CATEGORY': mydic[EV_CATEGORY],
+    }
+    # PRIORITY is the syslog level as the C library sends it
+    if severity in ops_eventcatalog.SEVERITIES:
+        fields['PRIORITY'] = str(ops_eventcatalog.SEVERITIES.index(severity))
+    return {
+        'parts': parts,
+        'prefix': 'ops-evt|' + ev_id + '|' + severity + '|',
+        'fields': fields,
+    }
+
+# unixctl handlers of the eventlog/* commands of the library. Those the
+# library registers are served by the unixctl server of C daemons only,
+# a python daemon serves these through its ovs.unixctl server instead.
+
+
+def unixctl_severity(conn, argv, unused_aux):
+    lib = libsupportability
+    if argv:
+        if argv[0] not in SEVERITY_NAMES:
+            conn.reply_error("Invalid severity level, expected "
+                             + "|".join(SEVERITY_NAMES))
+            return
+        lib.event_log_set_severity(SEVERITY_NAMES.index(argv[0]))
+    conn.reply(SEVERITY_NAMES[lib.event_log_get_severity()])
+
+
+def unixctl_reload(conn, unused_argv, unused_aux):
+    ret = libsupportability.event_log_reload()
+    if ret < 0:
+        conn.reply_error("Event catalog reload failed")
+    elif ret > 0:
+        conn.reply("Event catalog reloaded")
+    else:
+        conn.reply("Event catalog unchanged")
+
+
+def unixctl_drain(conn, unused_argv, unused_aux):
+    if libsupportability.event_log_spool_drain() != 0:
+        conn.reply("Events left in the spool, journal is not taking events")
+    else:
+        conn.reply("Event spool empty")
+
+# Utility API to register the eventlog/* unixctl commands once
+
+
+def unixctl_register():
+    ovs.unixctl.command_register("eventlog/severity", "[level]", 0, 1,
+                                 unixctl_severity, None)
+    ovs.unixctl.command_register("eventlog/reload", "", 0, 0,
+                                 unixctl_reload, None)
+    ovs.unixctl.command_register("eventlog/drain", "", 0, 0,
+                                 unixctl_drain, None)
+
 # Initialization API for event Log category
 
 
 def event_log_init(cat):
-    global content
-    global category
-    found = 0
 # Search whether category is already initialised
-    for i in range(len(category)):
-        if cat in category[i]:
+    if cat in category:
 # Already initialised, so return.
-            return FAIL
-    try:
-        with open('/etc/openswitch/supportability/ops_events.yaml', 'r') as f:
-            doc = yaml.load(f)
-            f.close()
-            for txt in range(len(doc[EV_DEFINITION])):
-                yaml_cat = doc[EV_DEFINITION][txt][EV_CATEGORY]
-                if yaml_cat == cat:
-                    mydic = {
-                        EV_CATEGORY: yaml_cat,
-                        EV_NAME: doc[EV_DEFINITION][txt][EV_NAME],
-                        EV_ID: doc[EV_DEFINITION][txt][EV_ID],
-                        EV_SEVERITY: doc[EV_DEFINITION][txt][EV_SEVERITY],
-                        EV_DESCRIPTION: doc[EV_DEFINITION][
-                            txt][EV_DESCRIPTION_YAML],
-                    }
-# Now add it to global event list
-                    content.append(mydic)
-                    found = 1
-
-            if found is NOT_FOUND:
+        return FAIL
+    if libsupportability is None:
+        return py_event_log_init(cat)
+    ret = libsupportability.event_log_init(c_string(cat))
+    if ret == 0:
 # This means supplied category name is not there in YAML, so return.
-                vlog.err("Event Category not Found")
-                return FAIL
-            else:
+        vlog.err("Event Category not Found")
+        return FAIL
+    if ret < 0:
+        vlog.err("Event Log Initialization Failed")
+        return FAIL
+    if not category:
+        unixctl_register()
 # Add category to global category list
-                category.append(cat)
+    category.append(cat)
 
+# Initialization API for event Log category without libsupportability
+
+
+def py_event_log_init(cat):
+    try:
+        found = [mydic for mydic in load_definitions()
+                 if mydic[EV_CATEGORY] == cat]
     except:
         vlog.err("Event Log Initialization Failed")
         return FAIL
+    if not found:
+# This means supplied category name is not there in YAML, so return.
+        vlog.err("Event Category not Found")
+        return FAIL
+# Now add it to global event list & index
+    for mydic in found:
+        content.append(mydic)
+        events.setdefault(mydic[EV_NAME], compile_event(mydic))
+# Add category to global category list
+    category.append(cat)
 
 # Utility API used to replace key with value provided.
 
@@ -89,27 +258,121 @@ def replace_str(keys, desc):
         desc = desc.replace(str(key), str(value))
     return desc
 
-# API to log events from a python daemon
+# Utility API to render the description of a compiled event with the
+# values of the keys given, in a single join. Keys without a value are
+# left as {key}.
+
+
+def render(parts, values):
+    out = parts[:]
+    for j in range(1, len(out), 2):
+        if out[j] in values:
+            out[j] = str(values[out[j]])
+        else:
+            out[j] = '{' + out[j] + '}'
+    return ''.join(out)
+
+# Utility API to form the journal field of every key, same as the C
+# library does: OPS_EVT_KEY_<KEY>=value
+
+
+def key_fields(keys, fields=None):
+    if fields is None:
+        fields = {}
+    for key, value in keys:
+        name = key_field_names.get(key)
+        if name is None:
+            name = EV_KEY_FIELD + re.sub('[^A-Z0-9]', '_', str(key).upper())
+            key_field_names[key] = name
+        fields[name] = str(value)
+    return fields
+
+# API to log events from a python daemon. Every argument is a
+# (key, value) pair, values are formed in to "key=value" strings by the
+# library only if the event is to be logged.
 
 
 def log_event(name, *arg):
-    found = 0
-    for i in range(len(content)):
-        if name == content[i][EV_NAME]:
-# Found the event in list!
-            ev_id = str(content[i][EV_ID])
-            severity = content[i][EV_SEVERITY]
-            desc = content[i][EV_DESCRIPTION]
-            categ = content[i][EV_CATEGORY]
-            if len(arg):
-                desc = replace_str(arg, desc)
-            found = 1
-            break;
-    if found is NOT_FOUND:
+    if libsupportability is None:
+        return py_log_event(name, *arg)
+    lib = libsupportability
+    c_name = c_string(name)
+    if not lib.event_log_enabled(c_name):
+        return
+    kv = []
+    for key, value in arg[:MAX_EVENT_KEYS]:
+        kv_pair = lib.key_value_string(c_string(key), b'%s', c_string(value))
+        # NULL for a key the library can't take, passed on it would end
+        # the arguments early. The strings formed so far are in scratch
+        # slots of the library, there is nothing to free.
+        if kv_pair is None:
+            return py_log_event(name, *arg)
+        kv.append(ctypes.c_void_p(kv_pair))
+    kv.append(None)
+    if lib.log_event(c_name, *kv) < 0:
+        return FAIL
+
+# Utility API to find a compiled event of the registered categories.
+# With libsupportability loaded events are only compiled here when
+# py_log_event() has to log one.
+
+
+def lookup_event(name):
+    ev = events.get(name)
+    if (ev is not None) or (libsupportability is None):
+        return ev
+    try:
+        defs = load_definitions()
+    except:
+        return None
+    for mydic in defs:
+        if (mydic[EV_NAME] == name) and (mydic[EV_CATEGORY] in category):
+            return events.setdefault(name, compile_event(mydic))
+    return None
+
+# API to log events without libsupportability
+
+
+def py_log_event(name, *arg):
+    ev = lookup_event(name)
+    if ev is None:
 # This means supplied event name is not there in YAML, so return.
         vlog.err("Event not Found")
         return FAIL
-    mesg = 'ops-evt|' + ev_id + '|' + severity + '|' + desc
-    journal.send(
-        mesg, MESSAGE_ID='50c0fa81c2a545ec982a54293f1b1945', PRIORITY=severity,
-        OPS_EVENT_ID=ev_id, OPS_EVENT_CATEGORY=categ)
+    values = {}
+    for key, value in arg:
+        values.setdefault(str(key), value)
+    mesg = ev['prefix'] + render(ev['parts'], values)
+    fields = key_fields(arg, dict(ev['fields']))
+    journal.send(mesg, **fields)
+
+# API to set the least severe level of the events logged, a syslog
+# level from 0 (LOG_EMERG) to 7 (LOG_DEBUG)
+
+
+def event_log_set_severity(level):
+    if libsupportability is None:
+        return FAIL
+    return libsupportability.event_log_set_severity(level)
+
+# API to hand events to a writer thread of the library through a ring
+# of capacity events, policy is one of the EVENT_LOG_* policies
+
+
+def event_log_async_enable(capacity, policy=EVENT_LOG_DROP_NEW):
+    if libsupportability is None:
+        return FAIL
+    return libsupportability.event_log_async_enable(capacity, policy)
+
+
+def event_log_async_disable():
+    if libsupportability is not None:
+        libsupportability.event_log_async_disable()
+
+# API to reload the event catalog after ops_events.yaml changed
+
+
+def event_log_reload():
+    if libsupportability is None:
+        return FAIL
+    return libsupportability.event_log_reload()
@@ -0,0 +1,129 @@
+#!/usr/bin/env python
+# (c) Copyright 2016 Hewlett Packard Enterprise Development LP
+# All Rights Reserved.
+#
+#    Licensed under the Apache License, Version 2.0 (the "License"); you may
+#    not use this file except in compliance with the License. You may obtain
+#    a copy of the License at
+#
+#         http://www.apache.org/licenses/LICENSE-2.0
+#
+#    Unless required by applicable law or agreed to in writing, software
+#    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+#    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+#    License for the specific language governing permissions and limitations
+#    under the License.
+
+# Pulls the event flight recorder of the eventlog library out of a core
+# file of a daemon & prints the events it logged last, oldest first.
+# The layout must match include/event_recorder.h, bump RECORDER_VERSION
+# on both sides for any change to it.
+
+import mmap
+import struct
+import sys
+import time
+
+import ops_eventcatalog
+
+RECORDER_MAGIC = b'OPSEVREC'
+RECORDER_VERSION = 1
+
+HEADER_FMT = '8sIIIIQ'
+RECORD_FMT = 'QQiHH'
+DATA_SIZE = 104
+
+
+# Function          : find_recorders
+# Responsibility    : Yield the offset of each flight recorder in the
+#                     image, its header is 8 byte aligned
+def find_recorders(image, byteorder='<'):
+    header_size = struct.calcsize(byteorder + HEADER_FMT)
+    record_size = struct.calcsize(byteorder + RECORD_FMT) + DATA_SIZE
+    off = image.find(RECORDER_MAGIC)
+    while off >= 0:
+        if off % 8 == 0 and off + header_size <= len(image):
+            _, version, size, n_records, _, _ = struct.unpack_from(
+                byteorder + HEADER_FMT, image, off)
+            if (version == RECORDER_VERSION and size == record_size and
+                    n_records and
+                    off + header_size + n_records * size <= len(image)):
+                yield off
+        off = image.find(RECORDER_MAGIC, off + 1)
+
+
+# Function          : read_recorder
+# Responsibility    : Return the pid of the daemon & its records as
+#                     (timestamp, event ID, "key=value" list), oldest first
+def read_recorder(image, off, byteorder='<'):
+    header_size = struct.calcsize(byteorder + HEADER_FMT)
+    _, _, size, n_records, pid, nxt = struct.unpack_from(
+        byteorder + HEADER_FMT, image, off)
+    records = []
+    for seq in range(max(nxt - n_records, 0), nxt):
+        rec = off + header_size + (seq % n_records) * size
+        seq1, stamp, event_id, n_keys, used = struct.unpack_from(
+            byteorder + RECORD_FMT, image, rec)
+        # Overwritten, or being written when the core was taken
+        if seq1 != seq + 1 or used > DATA_SIZE:
+            continue
+        data = image[rec + size - DATA_SIZE:rec + size - DATA_SIZE + used]
+        kv = [s.decode('utf-8', 'replace') for s in data.split(b'\0')]
+        records.append((stamp, event_id, kv[:n_keys]))
+    return pid, records
+
+
+# Function          : render
+# Responsibility    : Render a record the way log_event() does
+def render(stamp, event_id, kv, events):
+    when = time.strftime('%Y-%m-%d %H:%M:%S', time.localtime(stamp // 1000000))
+    when = '%s.%06d' % (when, stamp % 1000000)
+    ev = events.get(event_id)
+    if ev is None:
+        return '%s ops-evt|%d|%s' % (when, event_id, ' '.join(kv))
+    values = dict(k.split('=', 1) for k in kv if '=' in k)
+    tmpl = ev['description']
+    out = []
+    for kind, off, length in ops_eventcatalog.compile_template(tmpl, 0):
+        text = tmpl.encode('utf-8')[off:off + length].decode('utf-8')
+        if kind == ops_eventcatalog.SEGMENT_KEY:
+            text = values.get(text, '{%s}' % text).split('=')[0]
+        out.append(text)
+    return '%s ops-evt|%d|%s|%s' % (when, event_id, ev['severity'],
+                                    ''.join(out))
+
+
+def main(argv):
+    args = list(argv[1:])
+    byteorder = '<'
+    if args and args[0] == '--big-endian':
+        byteorder = '>'
+        args = args[1:]
+    if len(args) not in (1, 2):
+        sys.stderr.write('usage: %s [--big-endian] <core file> '
+                         '[<events.yaml>]\n' % argv[0])
+        return 1
+    events = {}
+    if len(args) == 2:
+        with open(args[1], 'rb') as f:
+            for ev in ops_eventcatalog.load_events(f.read())[0]:
+                events.setdefault(ev['id'], ev)
+    with open(args[0], 'rb') as f:
+        image = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        found = False
+        for off in find_recorders(image, byteorder):
+            found = True
+            pid, records = read_recorder(image, off, byteorder)
+            print('Flight recorder of pid %d, last %d events:' %
+                  (pid, len(records)))
+            for stamp, event_id, kv in records:
+                print(render(stamp, event_id, kv, events))
+        image.close()
+    if not found:
+        sys.stderr.write('No flight recorder in %s\n' % args[0])
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))
@@ -17,7 +17,8 @@ from setuptools import setup
 setup(
     name='ops_supportability',
     version='1.0',
-    py_modules=['ops_diagdump', 'ops_eventlog', 'ops_supportability'],
+    py_modules=['ops_diagdump', 'ops_eventcatalog', 'ops_eventlog',
+                'ops_eventrecorder', 'ops_supportability'],
     entry_points={
         'console_scripts': ['ops_supportability = ops_supportability:main']
     }
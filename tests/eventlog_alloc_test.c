@@ -0,0 +1,155 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*
+ * Checks that log_event() does no heap allocation per event.
+ *
+ * malloc & friends are replaced here with versions counting calls in to
+ * glibc.
+ *
+ * Usage: eventlog_alloc_test <ops_events.yaml>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "eventlog.h"
+#include "eventlog_test_util.h"
+
+#define TEST_EVENTS 1000
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void __libc_free(void *ptr);
+
+static int counting = 0;
+static unsigned long allocs = 0;
+static int last_has_key_field = FALSE;
+
+void *
+malloc(size_t size)
+{
+    if(counting) {
+        allocs++;
+    }
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t nmemb, size_t size)
+{
+    if(counting) {
+        allocs++;
+    }
+    return __libc_calloc(nmemb, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    if(counting) {
+        allocs++;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+void
+free(void *ptr)
+{
+    __libc_free(ptr);
+}
+
+/* Notes whether the event sent had a journal field of its own for the
+ * speedval key */
+static int
+key_field_hook(const struct iovec *iov, int n)
+{
+    const char *key_field = "OPS_EVT_KEY_SPEEDVAL=3";
+    int i = 0;
+    last_has_key_field = FALSE;
+    for(i = 1; i < n; i++)
+    {
+        if((iov[i].iov_len == strlen(key_field)) &&
+           !memcmp(iov[i].iov_base, key_field, iov[i].iov_len)) {
+            last_has_key_field = TRUE;
+        }
+    }
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    char root[64];
+    int i = 0;
+    const char *expected = "MESSAGE=ops-evt|2002|LOG_INFO|subsystem base "
+                           "setting fan speed control register to 3: 255";
+
+    if(argc != 2) {
+        fprintf(stderr, "usage: %s <ops_events.yaml>\n", argv[0]);
+        return 2;
+    }
+    if(test_setup_install_path(argv[1], root, sizeof(root)) < 0) {
+        perror("setup");
+        return 2;
+    }
+    test_journal_hook = key_field_hook;
+    if((event_log_init("FAN") != 1) || (event_log_init("LLDP") != 1)) {
+        fprintf(stderr, "FAIL: event_log_init\n");
+        test_cleanup_install_path(root);
+        return 1;
+    }
+    test_cleanup_install_path(root);
+    /* Warm up, first use may set up thread local storage */
+    log_event("LLDP_ENABLED", NULL);
+
+    counting = 1;
+    for(i = 0; i < TEST_EVENTS; i++)
+    {
+        log_event("FAN_SPEED", EV_KV("subsystem", "%s", "base"),
+                  EV_KV("speedval", "%d", 3), EV_KV("value", "%d", 255));
+        log_event("LLDP_TX_TIMER", EV_KV("value", "%d", i));
+        log_event("LLDP_DISABLED", NULL);
+    }
+    counting = 0;
+
+    if(test_n_messages != (3*TEST_EVENTS + 1)) {
+        fprintf(stderr, "FAIL: %d events reached journal\n", test_n_messages);
+        return 1;
+    }
+    if(allocs != 0) {
+        fprintf(stderr, "FAIL: %lu heap allocations for %d events\n",
+                allocs, 3*TEST_EVENTS);
+        return 1;
+    }
+    log_event("FAN_SPEED", EV_KV("subsystem", "%s", "base"),
+              EV_KV("speedval", "%d", 3), EV_KV("value", "%d", 255));
+    if(strcmp(test_last_message, expected)) {
+        fprintf(stderr, "FAIL: unexpected message '%s'\n", test_last_message);
+        return 1;
+    }
+    if(!last_has_key_field) {
+        fprintf(stderr, "FAIL: no journal field for key speedval\n");
+        return 1;
+    }
+    printf("PASS: no heap allocation in %d events\n", 3*TEST_EVENTS);
+    return 0;
+}
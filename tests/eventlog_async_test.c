@@ -0,0 +1,284 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*
+ * Checks the async mode of log_event() and its overflow policies, & that
+ * a child forked in async mode logs synchronously.
+ *
+ * The journal stub sink can be held closed, stalling the writer thread
+ * the way a slow journald does, and records the value of every
+ * LLDP_TX_TIMER event it receives.
+ *
+ * Usage: eventlog_async_test <ops_events.yaml>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/uio.h>
+#include "eventlog.h"
+#include "eventlog_test_util.h"
+
+#define RING_SIZE 4
+#define MAX_RECEIVED 2048
+
+static pthread_mutex_t sink_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t sink_cond = PTHREAD_COND_INITIALIZER;
+static int sink_open = TRUE;
+static int sink_waiting = FALSE;
+static int received[MAX_RECEIVED];
+static int n_received = 0;
+
+/* Holds the writer thread while the sink is closed & records the value
+ * of every LLDP_TX_TIMER event */
+static int
+sink_hook(const struct iovec *iov, int n)
+{
+    const char *prefix = "MESSAGE=ops-evt|1003|LOG_INFO|"
+                         "Configured LLDP tx-timer with ";
+    char message[MAX_LOG_STR + MAX_EVENT_NAME_SIZE];
+    size_t len = iov[0].iov_len;
+    if(len >= sizeof(message)) {
+        len = sizeof(message) - 1;
+    }
+    memcpy(message, iov[0].iov_base, len);
+    message[len] = '\0';
+
+    pthread_mutex_lock(&sink_mutex);
+    while(!sink_open) {
+        sink_waiting = TRUE;
+        pthread_cond_broadcast(&sink_cond);
+        pthread_cond_wait(&sink_cond, &sink_mutex);
+    }
+    sink_waiting = FALSE;
+    if(!strncmp(message, prefix, strlen(prefix)) &&
+       (n_received < MAX_RECEIVED)) {
+        received[n_received++] = atoi(message + strlen(prefix));
+    }
+    pthread_mutex_unlock(&sink_mutex);
+    return 0;
+}
+
+/* Stalls the sink and waits for the writer thread to get stuck in it */
+static void
+sink_close_on(int value)
+{
+    pthread_mutex_lock(&sink_mutex);
+    sink_open = FALSE;
+    pthread_mutex_unlock(&sink_mutex);
+    log_event("LLDP_TX_TIMER", EV_KV("value", "%d", value));
+    pthread_mutex_lock(&sink_mutex);
+    while(!sink_waiting) {
+        pthread_cond_wait(&sink_cond, &sink_mutex);
+    }
+    pthread_mutex_unlock(&sink_mutex);
+}
+
+static void
+sink_reopen(void)
+{
+    pthread_mutex_lock(&sink_mutex);
+    sink_open = TRUE;
+    n_received = 0;
+    pthread_cond_broadcast(&sink_cond);
+    pthread_mutex_unlock(&sink_mutex);
+}
+
+/* Checks the values the sink received once async mode is off */
+static int
+check_received(const char *test, const int *expected, int n_expected)
+{
+    int i = 0;
+    if(n_received != n_expected) {
+        fprintf(stderr, "FAIL: %s: %d events reached journal, expected %d\n",
+                test, n_received, n_expected);
+        return -1;
+    }
+    for(i = 0; i < n_expected; i++)
+    {
+        if(received[i] != expected[i]) {
+            fprintf(stderr, "FAIL: %s: event %d has value %d, expected %d\n",
+                    test, i, received[i], expected[i]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* With the writer stalled on event 0, events 1..10 are logged in to a
+ * ring of RING_SIZE records */
+static int
+test_overflow(const char *test, int policy, const int *expected,
+              unsigned long dropped)
+{
+    struct event_log_async_stats before, after;
+    int i = 0, ret = 0;
+
+    event_log_async_stats(&before);
+    if(event_log_async_enable(RING_SIZE, policy) != 0) {
+        fprintf(stderr, "FAIL: %s: event_log_async_enable\n", test);
+        return -1;
+    }
+    sink_close_on(0);
+    for(i = 1; i <= 10; i++)
+    {
+        log_event("LLDP_TX_TIMER", EV_KV("value", "%d", i));
+    }
+    event_log_async_stats(&after);
+    if(after.pending != RING_SIZE) {
+        fprintf(stderr, "FAIL: %s: %lu events pending\n", test, after.pending);
+        ret = -1;
+    }
+    pthread_mutex_lock(&sink_mutex);
+    sink_open = TRUE;
+    pthread_cond_broadcast(&sink_cond);
+    pthread_mutex_unlock(&sink_mutex);
+    event_log_async_disable();
+
+    event_log_async_stats(&after);
+    if(((after.dropped_new - before.dropped_new) +
+        (after.dropped_oldest - before.dropped_oldest)) != dropped) {
+        fprintf(stderr, "FAIL: %s: dropped counters\n", test);
+        ret = -1;
+    }
+    if((policy == EVENT_LOG_DROP_NEW) &&
+       ((after.dropped_new - before.dropped_new) != dropped)) {
+        fprintf(stderr, "FAIL: %s: dropped_new counter\n", test);
+        ret = -1;
+    }
+    if((after.written - before.written) != (RING_SIZE + 1)) {
+        fprintf(stderr, "FAIL: %s: %lu events written\n", test,
+                after.written - before.written);
+        ret = -1;
+    }
+    if(check_received(test, expected, RING_SIZE + 1) < 0) {
+        ret = -1;
+    }
+    sink_reopen();
+    return ret;
+}
+
+/* Nothing is lost when callers wait for room in the ring */
+static int
+test_block(void)
+{
+    static int expected[1000];
+    int i = 0;
+
+    if(event_log_async_enable(RING_SIZE, EVENT_LOG_BLOCK) != 0) {
+        fprintf(stderr, "FAIL: block: event_log_async_enable\n");
+        return -1;
+    }
+    if(event_log_async_enable(RING_SIZE, EVENT_LOG_BLOCK) != -1) {
+        fprintf(stderr, "FAIL: block: async mode enabled twice\n");
+        return -1;
+    }
+    for(i = 0; i < 1000; i++)
+    {
+        expected[i] = i;
+        log_event("LLDP_TX_TIMER", EV_KV("value", "%d", i));
+    }
+    event_log_async_disable();
+    if(check_received("block", expected, 1000) < 0) {
+        return -1;
+    }
+    sink_reopen();
+    return 0;
+}
+
+/* A child forked with the writer stalled & events queued has neither,
+ * it sends its events itself & may turn async mode on again */
+static int
+test_fork(void)
+{
+    struct event_log_async_stats stats;
+    int i = 0, status = 0;
+    pid_t pid = 0;
+
+    if(event_log_async_enable(RING_SIZE, EVENT_LOG_DROP_NEW) != 0) {
+        fprintf(stderr, "FAIL: fork: event_log_async_enable\n");
+        return -1;
+    }
+    sink_close_on(0);
+    for(i = 1; i <= 2; i++)
+    {
+        log_event("LLDP_TX_TIMER", EV_KV("value", "%d", i));
+    }
+    pid = fork();
+    if(pid == 0) {
+        sink_open = TRUE;
+        event_log_async_stats(&stats);
+        if((stats.pending != 0) ||
+           (log_event("LLDP_TX_TIMER", EV_KV("value", "%d", 42)) != 0) ||
+           (n_received != 1) || (received[0] != 42) ||
+           (event_log_async_enable(RING_SIZE, EVENT_LOG_BLOCK) != 0)) {
+            fprintf(stderr, "FAIL: fork: child still in async mode\n");
+            exit(1);
+        }
+        event_log_async_disable();
+        exit(0);
+    }
+    sink_reopen();
+    event_log_async_disable();
+    if((pid < 0) || (waitpid(pid, &status, 0) != pid) ||
+       !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+        fprintf(stderr, "FAIL: fork: child failed\n");
+        return -1;
+    }
+    sink_reopen();
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    const int drop_new[] = { 0, 1, 2, 3, 4 };
+    const int drop_oldest[] = { 0, 7, 8, 9, 10 };
+    char root[64];
+    int ret = 0;
+
+    if(argc != 2) {
+        fprintf(stderr, "usage: %s <ops_events.yaml>\n", argv[0]);
+        return 2;
+    }
+    if(test_setup_install_path(argv[1], root, sizeof(root)) < 0) {
+        perror("setup");
+        return 2;
+    }
+    test_journal_hook = sink_hook;
+    if(event_log_init("LLDP") != 1) {
+        fprintf(stderr, "FAIL: event_log_init\n");
+        test_cleanup_install_path(root);
+        return 1;
+    }
+    test_cleanup_install_path(root);
+
+    if((test_overflow("drop-new", EVENT_LOG_DROP_NEW, drop_new, 6) < 0) ||
+       (test_overflow("drop-oldest", EVENT_LOG_DROP_OLDEST, drop_oldest,
+                      6) < 0) ||
+       (test_block() < 0) || (test_fork() < 0)) {
+        ret = 1;
+    }
+    if(ret == 0) {
+        printf("PASS: async mode overflow policies\n");
+    }
+    return ret;
+}
@@ -0,0 +1,135 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*
+ * Checks that the event catalog has no fixed limit on the number of
+ * events or on the length of their names & descriptions, by loading a
+ * yaml file with more events than the old 500 entry table could hold,
+ * & logging one of them whole, & that the catalog built from it is
+ * published in shared memory, in place of a segment abandoned by a
+ * publisher which died.
+ *
+ * Usage: eventlog_catalog_test
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "eventlog.h"
+#include "event_catalog.h"
+#include "eventlog_test_util.h"
+
+#define TEST_EVENTS 1200
+#define TEST_DESCRIPTION_SIZE 1000
+
+/* Leaves a segment sized but without magic, as a publisher dying before
+ * it was done would */
+static int
+abandon_segment(const char *name)
+{
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0444);
+    if(fd < 0) {
+        return -1;
+    }
+    if(ftruncate(fd, 4096) < 0) {
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    return close(fd);
+}
+
+/* Writes a yaml file of TEST_EVENTS events with long names &
+ * descriptions */
+static int
+write_yaml(const char *path)
+{
+    char description[TEST_DESCRIPTION_SIZE];
+    FILE *fp = fopen(path, "w");
+    int i = 0;
+    if(fp == NULL) {
+        return -1;
+    }
+    memset(description, 'x', sizeof(description) - 1);
+    description[sizeof(description) - 1] = '\0';
+    fprintf(fp, "---\nevent_definitions:\n");
+    for(i = 0; i < TEST_EVENTS; i++)
+    {
+        fprintf(fp, "  - event_name: TEST_EVENT_WITH_A_NAME_LONGER_THAN_"
+                    "SIXTY_FOUR_CHARACTERS_%d\n"
+                    "    event_category: TEST\n"
+                    "    event_ID: %d\n"
+                    "    severity: LOG_INFO\n"
+                    "    keys: value\n"
+                    "    event_description_template: 'Event {value} %s'\n",
+                i, 100000 + i, description);
+    }
+    return fclose(fp);
+}
+
+int
+main(void)
+{
+    char root[64], path[512], name[EVENT_CATALOG_SHM_NAME_SIZE];
+    char expected[sizeof(test_last_message)];
+    char magic[EVENT_CATALOG_MAGIC_SIZE];
+    int fd = 0, len = 0;
+
+    if(test_setup_install_path(NULL, root, sizeof(root)) < 0) {
+        perror("setup");
+        return 2;
+    }
+    test_yaml_path(root, path, sizeof(path));
+    if((write_yaml(path) < 0) ||
+       (event_catalog_shm_name(path, name, sizeof(name)) < 0) ||
+       (abandon_segment(name) < 0) || (event_log_init("TEST") != 1)) {
+        fprintf(stderr, "FAIL: event_log_init\n");
+        test_cleanup_install_path(root);
+        return 1;
+    }
+    test_cleanup_install_path(root);
+    fd = shm_open(name, O_RDONLY, 0);
+    if((fd < 0) || (read(fd, magic, sizeof(magic)) != sizeof(magic)) ||
+       memcmp(magic, EVENT_CATALOG_MAGIC, sizeof(magic))) {
+        fprintf(stderr, "FAIL: catalog not published in %s\n", name);
+        shm_unlink(name);
+        return 1;
+    }
+    close(fd);
+    shm_unlink(name);
+
+    /* The whole description is logged, however long */
+    len = snprintf(expected, sizeof(expected),
+                   "MESSAGE=ops-evt|%d|LOG_INFO|Event 42 ",
+                   100000 + TEST_EVENTS - 1);
+    memset(expected + len, 'x', TEST_DESCRIPTION_SIZE - 1);
+    expected[len + TEST_DESCRIPTION_SIZE - 1] = '\0';
+    if((log_event("TEST_EVENT_WITH_A_NAME_LONGER_THAN_SIXTY_FOUR_"
+                  "CHARACTERS_1199", EV_KV("value", "%d", 42)) < 0) ||
+       strcmp(test_last_message, expected)) {
+        fprintf(stderr, "FAIL: last event sent '%.80s'\n", test_last_message);
+        return 1;
+    }
+    printf("PASS: %d events with long names & descriptions loaded & "
+           "shared\n", TEST_EVENTS);
+    return 0;
+}
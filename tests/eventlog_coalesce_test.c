@@ -0,0 +1,159 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*
+ * Checks that repeats of an event with the same key values are
+ * coalesced within the window of its category, & reported with their
+ * count once the window has closed.
+ *
+ * Usage: eventlog_coalesce_test
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "eventlog.h"
+#include "event_catalog.h"
+#include "eventlog_test_util.h"
+
+static const char *test_yaml =
+    "---\n"
+    "categories:\n"
+    "- event_category: FAN\n"
+    "  coalesce_window: 1\n"
+    "event_definitions:\n"
+    "- event_name: FAN_FAULT\n"
+    "  event_category: FAN\n"
+    "  event_ID: 2001\n"
+    "  severity: LOG_ERR\n"
+    "  keys: fan\n"
+    "  event_description_template: 'Fan {fan} failed'\n"
+    "- event_name: FAN_OK\n"
+    "  event_category: FAN\n"
+    "  event_ID: 2002\n"
+    "  severity: LOG_INFO\n"
+    "  keys: fan\n"
+    "  coalesce_window: 0\n"
+    "  event_description_template: 'Fan {fan} ok'\n"
+    "- event_name: SUPPORTABILITY_EVENT_REPEATED\n"
+    "  event_category: SUPPORTABILITY\n"
+    "  event_ID: 14003\n"
+    "  severity: LOG_INFO\n"
+    "  keys: event, event_id, count, interval\n"
+    "  event_description_template: 'Last {event} event repeated {count} "
+    "times in {interval} seconds'\n";
+
+/* Checks the messages sent since the last check */
+static int
+expect_messages(const char **expected, int n)
+{
+    int i = 0;
+    if(test_n_messages != n) {
+        fprintf(stderr, "FAIL: %d messages sent, expected %d\n",
+                test_n_messages, n);
+        for(i = 0; i < test_n_messages; i++)
+        {
+            fprintf(stderr, "  %s\n", test_messages[i]);
+        }
+        return -1;
+    }
+    for(i = 0; i < n; i++)
+    {
+        if(strcmp(test_messages[i], expected[i])) {
+            fprintf(stderr, "FAIL: message %d is '%s'\n", i, test_messages[i]);
+            return -1;
+        }
+    }
+    test_n_messages = 0;
+    return 0;
+}
+
+int
+main(void)
+{
+    struct event_log_stats stats;
+    char root[64], path[512], name[EVENT_CATALOG_SHM_NAME_SIZE];
+    const char *first[] = {
+        "MESSAGE=ops-evt|2001|LOG_ERR|Fan 1 failed",
+        "MESSAGE=ops-evt|2001|LOG_ERR|Fan 2 failed",
+    };
+    const char *after[] = {
+        "MESSAGE=ops-evt|14003|LOG_INFO|Last FAN_FAULT event repeated 9 "
+        "times in 1 seconds",
+        "MESSAGE=ops-evt|2001|LOG_ERR|Fan 1 failed",
+        "MESSAGE=ops-evt|14003|LOG_INFO|Last FAN_FAULT event repeated 2 "
+        "times in 1 seconds",
+    };
+    int i = 0;
+
+    if(test_setup_install_path(NULL, root, sizeof(root)) < 0) {
+        perror("setup");
+        return 2;
+    }
+    test_yaml_path(root, path, sizeof(path));
+    if((test_write_yaml(root, test_yaml) < 0) ||
+       (event_catalog_shm_name(path, name, sizeof(name)) < 0) ||
+       (event_log_init("FAN") != 1)) {
+        fprintf(stderr, "FAIL: event_log_init\n");
+        test_cleanup_install_path(root);
+        return 1;
+    }
+    test_cleanup_install_path(root);
+    shm_unlink(name);
+
+    for(i = 0; i < 10; i++)
+    {
+        log_event("FAN_FAULT", EV_KV("fan", "%d", 1));
+        if(i < 3) {
+            log_event("FAN_FAULT", EV_KV("fan", "%d", 2));
+        }
+    }
+    if(expect_messages(first, 2) < 0) {
+        return 1;
+    }
+    /* Events without a window are never coalesced */
+    for(i = 0; i < 5; i++)
+    {
+        log_event("FAN_OK", EV_KV("fan", "%d", 1));
+    }
+    if(test_n_messages != 5) {
+        fprintf(stderr, "FAIL: FAN_OK coalesced\n");
+        return 1;
+    }
+    test_n_messages = 0;
+
+    /* Once the window has closed the next repeat is logged after the
+     * count of those coalesced, the other window is reported next */
+    usleep(1100000);
+    log_event("FAN_FAULT", EV_KV("fan", "%d", 1));
+    if(expect_messages(after, 3) < 0) {
+        return 1;
+    }
+    if((event_log_stats("FAN_FAULT", &stats) != 0) ||
+       (stats.emitted != 3) || (stats.coalesced != 11)) {
+        fprintf(stderr, "FAIL: FAN_FAULT %lu emitted, %lu coalesced\n",
+                stats.emitted, stats.coalesced);
+        return 1;
+    }
+    printf("PASS: repeated events coalesced\n");
+    return 0;
+}
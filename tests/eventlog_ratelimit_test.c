@@ -0,0 +1,145 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*
+ * Checks the per event rate limit of log_event().
+ *
+ * INTERFACE events are limited to 50 per second with a burst of 200 in
+ * ops_events.yaml, a storm of them must be cut down to about the burst
+ * while every event keeps a bucket of its own, counting the events
+ * the journal stub sink gets per event ID. LOG_EVENT() must not format
+ * the keys of the events the limit suppresses.
+ *
+ * Usage: eventlog_ratelimit_test <ops_events.yaml>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "eventlog.h"
+#include "eventlog_test_util.h"
+
+#define STORM_EVENTS 5000
+#define RATE_BURST 200
+
+static unsigned long interface_up = 0;
+static unsigned long interface_down = 0;
+static unsigned long lldp = 0;
+static int formatted = 0;
+
+/* Counts the keys formatted by LOG_EVENT() */
+static int
+format_key(int value)
+{
+    formatted++;
+    return value;
+}
+
+/* Counts the events sent per event ID */
+static int
+count_hook(const struct iovec *iov, int n)
+{
+    int i = 0;
+    for(i = 0; i < n; i++)
+    {
+        if(!strncmp(iov[i].iov_base, "OPS_EVENT_ID=4001", iov[i].iov_len)) {
+            interface_up++;
+        }
+        else if(!strncmp(iov[i].iov_base, "OPS_EVENT_ID=4002",
+                         iov[i].iov_len)) {
+            interface_down++;
+        }
+        else if(!strncmp(iov[i].iov_base, "OPS_EVENT_ID=1003",
+                         iov[i].iov_len)) {
+            lldp++;
+        }
+    }
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct event_log_stats before, after;
+    char root[64];
+    int i = 0;
+
+    if(argc != 2) {
+        fprintf(stderr, "usage: %s <ops_events.yaml>\n", argv[0]);
+        return 2;
+    }
+    if(test_setup_install_path(argv[1], root, sizeof(root)) < 0) {
+        perror("setup");
+        return 2;
+    }
+    test_journal_hook = count_hook;
+    if((event_log_init("INTERFACE") != 1) || (event_log_init("LLDP") != 1)) {
+        fprintf(stderr, "FAIL: event_log_init\n");
+        test_cleanup_install_path(root);
+        return 1;
+    }
+    test_cleanup_install_path(root);
+
+    for(i = 0; i < STORM_EVENTS; i++)
+    {
+        log_event("INTERFACE_UP", EV_KV("interface", "%d", i));
+        log_event("LLDP_TX_TIMER", EV_KV("value", "%d", i));
+    }
+    for(i = 0; i < 10; i++)
+    {
+        log_event("INTERFACE_DOWN", EV_KV("interface", "%d", i));
+    }
+
+    /* The storm shouldn't have taken long enough to refill more than
+     * a second worth of tokens */
+    if((interface_up < RATE_BURST) || (interface_up > (RATE_BURST + 50))) {
+        fprintf(stderr, "FAIL: %lu of %d INTERFACE_UP events logged\n",
+                interface_up, STORM_EVENTS);
+        return 1;
+    }
+    if(interface_down != 10) {
+        fprintf(stderr, "FAIL: %lu of 10 INTERFACE_DOWN events logged\n",
+                interface_down);
+        return 1;
+    }
+    if(lldp != STORM_EVENTS) {
+        fprintf(stderr, "FAIL: %lu of %d unlimited events logged\n",
+                lldp, STORM_EVENTS);
+        return 1;
+    }
+
+    /* Still within the second, LOG_EVENT() counts the events suppressed
+     * without formatting their keys */
+    event_log_stats("INTERFACE_UP", &before);
+    for(i = 0; i < 100; i++)
+    {
+        LOG_EVENT("INTERFACE_UP", EV_KV("interface", "%d", format_key(i)));
+    }
+    event_log_stats("INTERFACE_UP", &after);
+    if((formatted > 50) ||
+       (after.suppressed - before.suppressed != 100 - formatted)) {
+        fprintf(stderr, "FAIL: %d suppressed events formatted, %lu "
+                "counted\n", formatted, after.suppressed - before.suppressed);
+        return 1;
+    }
+    printf("PASS: %lu of %d events let through the rate limit\n",
+           interface_up, STORM_EVENTS);
+    return 0;
+}
@@ -0,0 +1,129 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*
+ * Checks that the flight recorder keeps the last events logged, in the
+ * layout an offline tool expects, & that the diag-dump hook renders
+ * them oldest first.
+ *
+ * Usage: eventlog_recorder_test <ops_events.yaml>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "eventlog.h"
+#include "event_recorder.h"
+#include "eventlog_test_util.h"
+
+#define TEST_EVENTS (EVENT_RECORDER_RECORDS + 100)
+
+/* Returns the line after the first line of buf */
+static const char *
+next_line(const char *buf)
+{
+    const char *nl = strchr(buf, '\n');
+    return nl ? nl + 1 : "";
+}
+
+int
+main(int argc, char *argv[])
+{
+    const struct event_recorder *rec = &ops_event_recorder;
+    const char *fan = "ops-evt|2002|LOG_INFO|subsystem base setting fan "
+                      "speed control register to 3: 255\n";
+    char expected[128];
+    char root[64];
+    char *buf = NULL;
+    const char *line = NULL;
+    int i = 0;
+
+    if(argc != 2) {
+        fprintf(stderr, "usage: %s <ops_events.yaml>\n", argv[0]);
+        return 2;
+    }
+    if(test_setup_install_path(argv[1], root, sizeof(root)) < 0) {
+        perror("setup");
+        return 2;
+    }
+    if((event_log_init("FAN") != 1) || (event_log_init("LLDP") != 1)) {
+        fprintf(stderr, "FAIL: event_log_init\n");
+        test_cleanup_install_path(root);
+        return 1;
+    }
+    test_cleanup_install_path(root);
+
+    if(memcmp(rec->magic, EVENT_RECORDER_MAGIC, EVENT_RECORDER_MAGIC_SIZE) ||
+       (rec->version != EVENT_RECORDER_VERSION) ||
+       (rec->record_size != sizeof(struct event_recorder_record)) ||
+       (rec->n_records != EVENT_RECORDER_RECORDS) ||
+       (rec->pid != getpid())) {
+        fprintf(stderr, "FAIL: flight recorder header\n");
+        return 1;
+    }
+
+    log_event("FAN_SPEED", EV_KV("subsystem", "%s", "base"),
+              EV_KV("speedval", "%d", 3), EV_KV("value", "%d", 255));
+    log_event("LLDP_TX_TIMER", EV_KV("value", "%d", 30));
+    event_log_diag_dump("eventlog", &buf);
+    line = buf ? next_line(buf) : "";
+    if((strstr(line, fan) == NULL) || (strstr(line, fan) > next_line(line)) ||
+       (strstr(next_line(line), "ops-evt|1003|LOG_INFO|") == NULL)) {
+        fprintf(stderr, "FAIL: unexpected dump\n%s", buf ? buf : "");
+        return 1;
+    }
+    free(buf);
+
+    /* Only the last EVENT_RECORDER_RECORDS are kept, oldest first */
+    for(i = 0; i < TEST_EVENTS; i++)
+    {
+        log_event("LLDP_TX_TIMER", EV_KV("value", "%d", i));
+    }
+    if(rec->next != (TEST_EVENTS + 2)) {
+        fprintf(stderr, "FAIL: %llu events recorded\n",
+                (unsigned long long)rec->next);
+        return 1;
+    }
+    for(i = 0; i < EVENT_RECORDER_RECORDS; i++)
+    {
+        const struct event_recorder_record *r = &rec->records[
+                (TEST_EVENTS + 2 - EVENT_RECORDER_RECORDS + i) %
+                EVENT_RECORDER_RECORDS];
+        snprintf(expected, sizeof(expected), "value=%d",
+                 TEST_EVENTS - EVENT_RECORDER_RECORDS + i);
+        if((r->event_id != 1003) || (r->n_keys != 1) ||
+           strcmp(r->data, expected)) {
+            fprintf(stderr, "FAIL: record %d is %d %s\n", i, r->event_id,
+                    r->data);
+            return 1;
+        }
+    }
+    event_log_diag_dump("eventlog", &buf);
+    snprintf(expected, sizeof(expected), "%d events logged, last %d:",
+             TEST_EVENTS + 2, EVENT_RECORDER_RECORDS);
+    if((buf == NULL) || (strstr(buf, expected) == NULL) ||
+       (strstr(buf, fan) != NULL)) {
+        fprintf(stderr, "FAIL: unexpected dump after wrap\n");
+        return 1;
+    }
+    free(buf);
+    printf("PASS: flight recorder\n");
+    return 0;
+}
@@ -0,0 +1,275 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*
+ * Checks that event_log_reload() picks up changes to the yaml file for
+ * the categories the daemon registered, while other threads keep
+ * logging events, that a thread held in journal keeps the catalog it
+ * picked up however long it is held, & that the events logged on a
+ * replaced catalog are still counted once it is freed.
+ *
+ * Usage: eventlog_reload_test
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "eventlog.h"
+#include "event_catalog.h"
+#include "eventlog_test_util.h"
+
+#define TEST_THREADS 4
+#define TEST_RELOADS 20
+#define VERSION_1_MESSAGE "MESSAGE=ops-evt|90001|LOG_INFO|Version 1 7"
+#define VERSION_2_MESSAGE "MESSAGE=ops-evt|90001|LOG_INFO|Version 2 7"
+
+static int stop = 0;
+static int bad_messages = 0;
+static unsigned long logged = 0;
+static int hold_next = FALSE;
+static int held = FALSE;
+static int released = FALSE;
+static int changed_fields = 0;
+
+/* Writes the yaml file, version 2 changes the description of an event
+ * & adds one */
+static int
+write_yaml(const char *path, int version)
+{
+    FILE *fp = fopen(path, "w");
+    if(fp == NULL) {
+        return -1;
+    }
+    fprintf(fp, "---\nevent_definitions:\n"
+                "  - event_name: RELOAD_EVENT\n"
+                "    event_category: TEST\n"
+                "    event_ID: 90001\n"
+                "    severity: LOG_INFO\n"
+                "    keys: value\n"
+                "    event_description_template: 'Version %d {value}'\n",
+            version);
+    if(version == 2) {
+        fprintf(fp, "  - event_name: RELOAD_NEW_EVENT\n"
+                    "    event_category: TEST\n"
+                    "    event_ID: 90002\n"
+                    "    severity: LOG_INFO\n"
+                    "    keys: NA\n"
+                    "    event_description_template: 'New event'\n");
+    }
+    fprintf(fp, "  - event_name: RELOAD_OTHER_EVENT\n"
+                "    event_category: OTHER\n"
+                "    event_ID: 90003\n"
+                "    severity: LOG_INFO\n"
+                "    keys: NA\n"
+                "    event_description_template: 'Other event'\n");
+    return fclose(fp);
+}
+
+/* Logs the event till told to stop, whichever catalog is in use */
+static void *
+log_thread(void *arg)
+{
+    while(!__atomic_load_n(&stop, __ATOMIC_RELAXED))
+    {
+        if(log_event("RELOAD_EVENT", EV_KV("value", "%d", 7)) == 0) {
+            __atomic_add_fetch(&logged, 1, __ATOMIC_RELAXED);
+        }
+        if(strcmp(test_last_message, VERSION_1_MESSAGE) &&
+           strcmp(test_last_message, VERSION_2_MESSAGE)) {
+            __atomic_add_fetch(&bad_messages, 1, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+/* Holds the next event sent in journal till released, checking that
+ * the fields it was handed, some in the catalog, didn't change */
+static int
+hold_hook(const struct iovec *iov, int n)
+{
+    char fields[4096];
+    size_t off = 0;
+    int i = 0, hold = TRUE;
+    if(!__atomic_compare_exchange_n(&hold_next, &hold, FALSE, FALSE,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    for(i = 0; (i < n) && (off + iov[i].iov_len <= sizeof(fields)); i++)
+    {
+        memcpy(fields + off, iov[i].iov_base, iov[i].iov_len);
+        off += iov[i].iov_len;
+    }
+    __atomic_store_n(&held, TRUE, __ATOMIC_RELEASE);
+    while(!__atomic_load_n(&released, __ATOMIC_ACQUIRE))
+    {
+        usleep(1000);
+    }
+    for(i = 0, off = 0; (i < n) && (off + iov[i].iov_len <= sizeof(fields));
+        i++)
+    {
+        if(memcmp(fields + off, iov[i].iov_base, iov[i].iov_len)) {
+            changed_fields++;
+        }
+        off += iov[i].iov_len;
+    }
+    return 0;
+}
+
+/* Logs the event once, the journal hook holds it */
+static void *
+held_thread(void *arg)
+{
+    if(log_event("RELOAD_EVENT", EV_KV("value", "%d", 7)) == 0) {
+        __atomic_add_fetch(&logged, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+/* Switches the yaml file to the version & reloads, naming the shared
+ * memory segment published for it */
+static int
+reload(const char *path, int version, char *name)
+{
+    if((write_yaml(path, version) < 0) ||
+       (event_catalog_shm_name(path, name, EVENT_CATALOG_SHM_NAME_SIZE) < 0)) {
+        return -1;
+    }
+    return event_log_reload();
+}
+
+/* Checks whether the shared memory segment exists */
+static int
+shm_exists(const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if(fd < 0) {
+        return FALSE;
+    }
+    close(fd);
+    return TRUE;
+}
+
+int
+main(void)
+{
+    pthread_t threads[TEST_THREADS];
+    struct event_log_stats stats;
+    char root[64], path[512];
+    char old[EVENT_CATALOG_SHM_NAME_SIZE], name[EVENT_CATALOG_SHM_NAME_SIZE];
+    int i = 0, failed = 0;
+
+    if(test_setup_install_path(NULL, root, sizeof(root)) < 0) {
+        perror("setup");
+        return 2;
+    }
+    test_yaml_path(root, path, sizeof(path));
+    if((write_yaml(path, 1) < 0) || (event_log_init("TEST") != 1) ||
+       (reload(path, 1, old) != 0)) {
+        fprintf(stderr, "FAIL: event_log_init\n");
+        test_cleanup_install_path(root);
+        return 1;
+    }
+    if((log_event("RELOAD_NEW_EVENT", NULL) != -1) ||
+       (reload(path, 2, name) != 1) ||
+       (log_event("RELOAD_NEW_EVENT", NULL) != 0) ||
+       strcmp(test_last_message, "MESSAGE=ops-evt|90002|LOG_INFO|New event") ||
+       (log_event("RELOAD_EVENT", EV_KV("value", "%d", 7)) != 0) ||
+       strcmp(test_last_message, VERSION_2_MESSAGE)) {
+        fprintf(stderr, "FAIL: reloaded catalog not used, last '%s'\n",
+                test_last_message);
+        failed = 1;
+    }
+    /* The segment of the replaced catalog is removed, not the new one */
+    if(shm_exists(old) || !shm_exists(name)) {
+        fprintf(stderr, "FAIL: %s left or %s removed by the reload\n",
+                old, name);
+        failed = 1;
+    }
+    /* Categories the daemon didn't register stay unregistered */
+    if(log_event("RELOAD_OTHER_EVENT", NULL) != -1) {
+        fprintf(stderr, "FAIL: event of an unregistered category logged\n");
+        failed = 1;
+    }
+    for(i = 0; i < TEST_THREADS; i++)
+    {
+        pthread_create(&threads[i], NULL, log_thread, NULL);
+    }
+    for(i = 0; i < TEST_RELOADS; i++)
+    {
+        if(reload(path, (i % 2) + 1, name) != 1) {
+            fprintf(stderr, "FAIL: reload %d\n", i);
+            failed = 1;
+        }
+    }
+    __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+    for(i = 0; i < TEST_THREADS; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    /* Reloads while a thread is held in journal, for longer than any
+     * timer would give it, don't free the catalog it uses */
+    __atomic_store_n(&hold_next, TRUE, __ATOMIC_RELEASE);
+    test_journal_hook = hold_hook;
+    pthread_create(&threads[0], NULL, held_thread, NULL);
+    while(!__atomic_load_n(&held, __ATOMIC_ACQUIRE))
+    {
+        usleep(1000);
+    }
+    if(reload(path, (TEST_RELOADS % 2) + 1, name) != 1) {
+        failed = 1;
+    }
+    sleep(3);
+    if(reload(path, ((TEST_RELOADS + 1) % 2) + 1, name) != 1) {
+        failed = 1;
+    }
+    __atomic_store_n(&released, TRUE, __ATOMIC_RELEASE);
+    pthread_join(threads[0], NULL);
+    test_journal_hook = NULL;
+    if(changed_fields) {
+        fprintf(stderr, "FAIL: %d fields changed while held in journal\n",
+                changed_fields);
+        failed = 1;
+    }
+    /* Nobody reads them any more, the next reload frees the replaced
+     * states */
+    if((reload(path, (TEST_RELOADS % 2) + 1, name) != 1) ||
+       (event_log_stats("RELOAD_EVENT", &stats) < 0) ||
+       (stats.emitted != logged + 1)) {
+        fprintf(stderr, "FAIL: %lu of %lu events counted\n", stats.emitted,
+                logged + 1);
+        failed = 1;
+    }
+    test_cleanup_install_path(root);
+    shm_unlink(name);
+    if(bad_messages) {
+        fprintf(stderr, "FAIL: %d unexpected messages while reloading\n",
+                bad_messages);
+        failed = 1;
+    }
+    if(failed) {
+        return 1;
+    }
+    printf("PASS: %d reloads while %d threads logged events\n",
+           TEST_RELOADS + 3, TEST_THREADS);
+    return 0;
+}
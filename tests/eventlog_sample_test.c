@@ -0,0 +1,186 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*
+ * Checks that an event with a sample_rate is logged about 1 in that many
+ * times, tagged with the rate, whether logged through log_event() or
+ * LOG_EVENT(), that a pick of event_log_enabled() is only used by the
+ * log_event() right after it, & that the rate can be changed at run
+ * time.
+ *
+ * The journal stub sink counts the sampled events.
+ *
+ * Usage: eventlog_sample_test
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "eventlog.h"
+#include "event_catalog.h"
+#include "eventlog_test_util.h"
+
+#define TEST_CALLS 20000
+
+static const char *test_yaml =
+    "---\n"
+    "categories:\n"
+    "- event_category: PKT\n"
+    "  sample_rate: 10\n"
+    "event_definitions:\n"
+    "- event_name: PKT_RX\n"
+    "  event_category: PKT\n"
+    "  event_ID: 3001\n"
+    "  severity: LOG_INFO\n"
+    "  keys: port\n"
+    "  event_description_template: 'Packet on {port}'\n"
+    "- event_name: PKT_DROP\n"
+    "  event_category: PKT\n"
+    "  event_ID: 3002\n"
+    "  severity: LOG_INFO\n"
+    "  keys: port\n"
+    "  sample_rate: 1\n"
+    "  event_description_template: 'Packet dropped on {port}'\n";
+
+static int n_sampled = 0;
+
+/* Counts the events sent tagged with a sample rate of 10 */
+static int
+sampled_hook(const struct iovec *iov, int n)
+{
+    int i = 0;
+    for(i = 0; i < n; i++)
+    {
+        if((iov[i].iov_len == strlen(EVENT_SAMPLE_RATE_FIELD "10")) &&
+           !memcmp(iov[i].iov_base, EVENT_SAMPLE_RATE_FIELD "10",
+                   iov[i].iov_len)) {
+            n_sampled++;
+        }
+    }
+    return 0;
+}
+
+/* Checks that the calls logged are about 1 in rate, the sampling
+ * being random */
+static int
+expect_sampled(const char *how, int rate)
+{
+    int expected = TEST_CALLS / rate;
+    if((test_n_messages < expected - expected / 4) ||
+       (test_n_messages > expected + expected / 4)) {
+        fprintf(stderr, "FAIL: %s logged %d of %d, expected about %d\n",
+                how, test_n_messages, TEST_CALLS, expected);
+        return -1;
+    }
+    if(n_sampled != ((rate == 10) ? test_n_messages : 0)) {
+        fprintf(stderr, "FAIL: %s %d of %d tagged with the rate\n",
+                how, n_sampled, test_n_messages);
+        return -1;
+    }
+    test_n_messages = 0;
+    n_sampled = 0;
+    return 0;
+}
+
+int
+main(void)
+{
+    struct event_log_stats stats;
+    char root[64], path[512], name[EVENT_CATALOG_SHM_NAME_SIZE];
+    int i = 0;
+
+    if(test_setup_install_path(NULL, root, sizeof(root)) < 0) {
+        perror("setup");
+        return 2;
+    }
+    test_journal_hook = sampled_hook;
+    test_yaml_path(root, path, sizeof(path));
+    if((test_write_yaml(root, test_yaml) < 0) ||
+       (event_catalog_shm_name(path, name, sizeof(name)) < 0) ||
+       (event_log_init("PKT") != 1)) {
+        fprintf(stderr, "FAIL: event_log_init\n");
+        test_cleanup_install_path(root);
+        return 1;
+    }
+    test_cleanup_install_path(root);
+    shm_unlink(name);
+
+    for(i = 0; i < TEST_CALLS; i++)
+    {
+        log_event("PKT_RX", EV_KV("port", "%d", i));
+    }
+    if(expect_sampled("log_event", 10) < 0) {
+        return 1;
+    }
+    /* The pick made by event_log_enabled() holds for log_event() */
+    for(i = 0; i < TEST_CALLS; i++)
+    {
+        LOG_EVENT("PKT_RX", EV_KV("port", "%d", i));
+    }
+    if(expect_sampled("LOG_EVENT", 10) < 0) {
+        return 1;
+    }
+    /* The event overrides the rate of its category */
+    for(i = 0; i < TEST_CALLS; i++)
+    {
+        log_event("PKT_DROP", EV_KV("port", "%d", i));
+    }
+    if(expect_sampled("PKT_DROP", 1) < 0) {
+        return 1;
+    }
+    /* A pick of event_log_enabled() no log_event() of the event
+     * followed doesn't carry over to a later one */
+    for(i = 0; i < TEST_CALLS; i++)
+    {
+        event_log_enabled("PKT_RX");
+        log_event("PKT_DROP", EV_KV("port", "%d", i));
+        log_event("PKT_RX", EV_KV("port", "%d", i));
+    }
+    if((n_sampled < (TEST_CALLS / 10) - (TEST_CALLS / 40)) ||
+       (n_sampled > (TEST_CALLS / 10) + (TEST_CALLS / 40))) {
+        fprintf(stderr, "FAIL: PKT_RX after unused picks logged %d of %d, "
+                "expected about %d\n", n_sampled, TEST_CALLS,
+                TEST_CALLS / 10);
+        return 1;
+    }
+    test_n_messages = 0;
+    n_sampled = 0;
+    if((event_log_set_sample_rate("PKT_RX", 100) != 0) ||
+       (event_log_set_sample_rate("PKT_NONE", 100) != -1)) {
+        fprintf(stderr, "FAIL: event_log_set_sample_rate\n");
+        return 1;
+    }
+    for(i = 0; i < TEST_CALLS; i++)
+    {
+        log_event("PKT_RX", EV_KV("port", "%d", i));
+    }
+    if(expect_sampled("PKT_RX at 100", 100) < 0) {
+        return 1;
+    }
+    /* Sampled out events are not counted as failed or dropped */
+    if((event_log_stats("PKT_RX", &stats) != 0) || (stats.failed != 0)) {
+        fprintf(stderr, "FAIL: PKT_RX stats\n");
+        return 1;
+    }
+    printf("PASS: events sampled\n");
+    return 0;
+}
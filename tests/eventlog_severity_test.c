@@ -0,0 +1,102 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*
+ * Checks the severity threshold of log_event() & that LOG_EVENT() doesn't
+ * format the keys of the events it filters.
+ *
+ * Usage: eventlog_severity_test <ops_events.yaml>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <syslog.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "eventlog.h"
+#include "eventlog_test_util.h"
+
+static unsigned long formatted = 0;
+
+/* Stands for a costly key value */
+static int
+key_value(int value)
+{
+    formatted++;
+    return value;
+}
+
+/* Logs an info & a critical event both ways */
+static void
+log_events(void)
+{
+    log_event("LLDP_TX_TIMER", EV_KV("value", "%d", key_value(30)));
+    LOG_EVENT("LLDP_TX_TIMER", EV_KV("value", "%d", key_value(30)));
+    LOG_EVENT("SUPPORTABILITY_DAEMON_CRASH",
+              EV_KV("process", "%s", "ops-foo"),
+              EV_KV("signal", "%d", key_value(11)),
+              EV_KV("timestamp", "%s", "now"));
+}
+
+int
+main(int argc, char *argv[])
+{
+    char root[64];
+
+    if(argc != 2) {
+        fprintf(stderr, "usage: %s <ops_events.yaml>\n", argv[0]);
+        return 2;
+    }
+    if(test_setup_install_path(argv[1], root, sizeof(root)) < 0) {
+        perror("setup");
+        return 2;
+    }
+    if((event_log_init("LLDP") != 1) ||
+       (event_log_init("SUPPORTABILITY") != 1)) {
+        fprintf(stderr, "FAIL: event_log_init\n");
+        test_cleanup_install_path(root);
+        return 1;
+    }
+    test_cleanup_install_path(root);
+
+    log_events();
+    if((test_n_messages != 3) || (formatted != 3)) {
+        fprintf(stderr, "FAIL: %d events logged, %lu formatted by default\n",
+                test_n_messages, formatted);
+        return 1;
+    }
+    if((event_log_set_severity(MAX_SEV_LEVELS) != -1) ||
+       (event_log_set_severity(LOG_WARNING) != 0) ||
+       (event_log_get_severity() != LOG_WARNING)) {
+        fprintf(stderr, "FAIL: event_log_set_severity\n");
+        return 1;
+    }
+    test_n_messages = 0;
+    formatted = 0;
+    log_events();
+    /* Only the critical event gets through, & only log_event() formats
+     * the keys of the filtered one */
+    if((test_n_messages != 1) || (formatted != 2)) {
+        fprintf(stderr, "FAIL: %d events logged, %lu formatted at warn\n",
+                test_n_messages, formatted);
+        return 1;
+    }
+    printf("PASS: events below the severity threshold filtered\n");
+    return 0;
+}
@@ -0,0 +1,336 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*
+ * Checks that events journal refuses are spooled under
+ * /var/diagnostics/logs, in order & counted as emitted, that the spool
+ * is replayed once journal takes events again, & that events which
+ * don't fit in the spool are counted as dropped. Processes of the same
+ * name spooling at once share the spool file without corrupting it.
+ * Events journal rejects for good are neither spooled nor retried.
+ * event_log_run() replays the spool without any event being logged.
+ *
+ * The journal stub sink can be made to refuse events.
+ *
+ * Usage: eventlog_spool_test
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/uio.h>
+#include "eventlog.h"
+#include "event_catalog.h"
+#include "event_spool.h"
+#include "eventlog_test_util.h"
+
+#define TEST_EVENTS 100
+#define TEST_PROCS 4
+#define TEST_PROC_EVENTS 500
+
+static const char *test_yaml =
+    "---\n"
+    "categories:\n"
+    "- event_category: FAN\n"
+    "event_definitions:\n"
+    "- event_name: FAN_SPEED\n"
+    "  event_category: FAN\n"
+    "  event_ID: 2003\n"
+    "  severity: LOG_INFO\n"
+    "  keys: fan, speed\n"
+    "  event_description_template: 'Fan {fan} at {speed}'\n";
+
+static int n_timed = 0;         /* Replayed with the time logged */
+static int journal_down = FALSE;
+static char rejected[MAX_LOG_STR];  /* Message refused for good */
+
+/* Refuses the events while journal_down & the rejected one, counts the
+ * replayed ones */
+static int
+spool_hook(const struct iovec *iov, int n)
+{
+    int i = 0;
+    if(journal_down) {
+        return -EAGAIN;
+    }
+    if((iov[0].iov_len == strlen(rejected)) &&
+       !memcmp(iov[0].iov_base, rejected, iov[0].iov_len)) {
+        return -EINVAL;
+    }
+    for(i = 0; i < n; i++)
+    {
+        if(!strncmp(iov[i].iov_base, EVENT_SPOOL_TIME_FIELD,
+                    strlen(EVENT_SPOOL_TIME_FIELD))) {
+            n_timed++;
+        }
+    }
+    return 0;
+}
+
+/* Checks the spool counters */
+static int
+expect_spool(const char *test, unsigned long spooled,
+             unsigned long replayed, unsigned long pending)
+{
+    struct event_log_spool_stats stats;
+    event_log_spool_stats(&stats);
+    if((stats.spooled != spooled) || (stats.replayed != replayed) ||
+       (stats.pending != pending)) {
+        fprintf(stderr, "FAIL: %s: %lu spooled, %lu replayed, %lu pending\n",
+                test, stats.spooled, stats.replayed, stats.pending);
+        return -1;
+    }
+    return 0;
+}
+
+/* Checks that the messages sent are the events logged, in order */
+static int
+expect_messages(const char *test, int first, int n, int timed)
+{
+    char expected[MAX_LOG_STR];
+    int i = 0;
+    if((test_n_messages != n) || (n_timed != timed)) {
+        fprintf(stderr, "FAIL: %s: %d messages sent, %d timed\n",
+                test, test_n_messages, n_timed);
+        return -1;
+    }
+    for(i = 0; i < n; i++)
+    {
+        snprintf(expected, sizeof(expected),
+                 "MESSAGE=ops-evt|2003|LOG_INFO|Fan 1 at %d", first + i);
+        if(strcmp(test_messages[i], expected)) {
+            fprintf(stderr, "FAIL: %s: message %d is '%s'\n",
+                    test, i, test_messages[i]);
+            return -1;
+        }
+    }
+    test_n_messages = 0;
+    n_timed = 0;
+    return 0;
+}
+
+/* Logs events while journal is down */
+static void
+spool_events(int n)
+{
+    int i = 0;
+    for(i = 0; i < n; i++)
+    {
+        log_event("FAN_SPEED", EV_KV("fan", "%d", getpid()),
+                  EV_KV("speed", "%d", i));
+    }
+}
+
+int
+main(void)
+{
+    struct event_log_spool_stats spool, before;
+    struct event_log_stats stats;
+    char root[64], path[512], name[EVENT_CATALOG_SHM_NAME_SIZE];
+    char big[KEY_VALUE_SIZE];
+    int i = 0, status = 0, ret = 1, start[2];
+    pid_t pids[TEST_PROCS];
+
+    if((test_setup_install_path(NULL, root, sizeof(root)) < 0) ||
+       (test_setup_spool_dir(root) < 0)) {
+        perror("setup");
+        return 2;
+    }
+    test_journal_hook = spool_hook;
+    test_yaml_path(root, path, sizeof(path));
+    if((test_write_yaml(root, test_yaml) < 0) ||
+       (event_catalog_shm_name(path, name, sizeof(name)) < 0) ||
+       (event_log_init("FAN") != 1)) {
+        fprintf(stderr, "FAIL: event_log_init\n");
+        goto out;
+    }
+    shm_unlink(name);
+
+    /* Events journal refuses are spooled, & so are the ones logged
+     * after them until the spool is replayed */
+    journal_down = TRUE;
+    for(i = 0; i < TEST_EVENTS; i++)
+    {
+        log_event("FAN_SPEED", EV_KV("fan", "%d", 1),
+                  EV_KV("speed", "%d", i));
+    }
+    journal_down = FALSE;
+    log_event("FAN_SPEED", EV_KV("fan", "%d", 1),
+              EV_KV("speed", "%d", TEST_EVENTS));
+    if((expect_messages("journal down", 0, 0, 0) < 0) ||
+       (expect_spool("journal down", TEST_EVENTS + 1, 0,
+                     TEST_EVENTS + 1) < 0)) {
+        goto out;
+    }
+    if((event_log_stats("FAN_SPEED", &stats) != 0) ||
+       (stats.emitted != TEST_EVENTS + 1) || (stats.failed != 0)) {
+        fprintf(stderr, "FAIL: %lu emitted, %lu failed\n",
+                stats.emitted, stats.failed);
+        goto out;
+    }
+    snprintf(path, sizeof(path), "%s%s/%s%s", root, EVENT_SPOOL_DIR,
+             program_invocation_short_name, EVENT_SPOOL_SUFFIX);
+    if(access(path, R_OK) != 0) {
+        fprintf(stderr, "FAIL: no spool file %s\n", path);
+        goto out;
+    }
+
+    /* The spool is replayed in order, with the time of each event */
+    if((event_log_spool_drain() != 0) ||
+       (expect_messages("replay", 0, TEST_EVENTS + 1,
+                        TEST_EVENTS + 1) < 0) ||
+       (expect_spool("replay", TEST_EVENTS + 1, TEST_EVENTS + 1, 0) < 0)) {
+        goto out;
+    }
+    log_event("FAN_SPEED", EV_KV("fan", "%d", 1), EV_KV("speed", "%d", 7));
+    if(expect_messages("journal up", 7, 1, 0) < 0) {
+        goto out;
+    }
+
+    /* Events which don't fit are dropped, the spool is never
+     * overwritten */
+    memset(big, 'x', sizeof(big) - 8);
+    big[sizeof(big) - 8] = '\0';
+    journal_down = TRUE;
+    for(i = 0; i < (EVENT_SPOOL_SIZE / 256) + 100; i++)
+    {
+        log_event("FAN_SPEED", EV_KV("fan", "%s", big),
+                  EV_KV("speed", "%d", i));
+    }
+    event_log_spool_stats(&spool);
+    if((spool.dropped == 0) || (spool.pending + spool.dropped !=
+                                (unsigned long)i)) {
+        fprintf(stderr, "FAIL: spool full: %lu pending, %lu dropped\n",
+                spool.pending, spool.dropped);
+        goto out;
+    }
+    if(event_log_spool_drain() == 0) {
+        fprintf(stderr, "FAIL: spool drained with journal down\n");
+        goto out;
+    }
+    journal_down = FALSE;
+    test_n_messages = n_timed = 0;
+    if((event_log_spool_drain() != 0) ||
+       (n_timed != (int)spool.pending)) {
+        fprintf(stderr, "FAIL: %d of %lu replayed\n", n_timed,
+                spool.pending);
+        goto out;
+    }
+
+    /* Processes spooling at once, forked ones here, take turns. They
+     * start together once the pipe is closed */
+    journal_down = TRUE;
+    if(pipe(start) < 0) {
+        perror("pipe");
+        goto out;
+    }
+    for(i = 0; i < TEST_PROCS; i++)
+    {
+        pids[i] = fork();
+        if(pids[i] == 0) {
+            close(start[1]);
+            if(read(start[0], &status, 1) < 0) {
+                exit(1);
+            }
+            spool_events(TEST_PROC_EVENTS);
+            exit(0);
+        }
+    }
+    close(start[0]);
+    close(start[1]);
+    spool_events(TEST_PROC_EVENTS);
+    for(i = 0; i < TEST_PROCS; i++)
+    {
+        if((pids[i] < 0) || (waitpid(pids[i], &status, 0) != pids[i])) {
+            fprintf(stderr, "FAIL: process %d\n", i);
+            goto out;
+        }
+    }
+    journal_down = FALSE;
+    test_n_messages = n_timed = 0;
+    event_log_spool_stats(&spool);
+    if((event_log_spool_drain() != 0) ||
+       (n_timed != (TEST_PROCS + 1) * TEST_PROC_EVENTS) ||
+       (spool.pending != (TEST_PROCS + 1) * TEST_PROC_EVENTS)) {
+        fprintf(stderr, "FAIL: processes: %lu spooled, %d replayed\n",
+                spool.pending, n_timed);
+        goto out;
+    }
+
+    /* An event journal rejects on replay is dropped, the ones behind it
+     * are replayed, & one it rejects right away is not spooled */
+    journal_down = TRUE;
+    for(i = 0; i < 3; i++)
+    {
+        log_event("FAN_SPEED", EV_KV("fan", "%d", 1),
+                  EV_KV("speed", "%d", 1000 + i));
+    }
+    journal_down = FALSE;
+    snprintf(rejected, sizeof(rejected),
+             "MESSAGE=ops-evt|2003|LOG_INFO|Fan 1 at %d", 1001);
+    test_n_messages = n_timed = 0;
+    event_log_spool_stats(&before);
+    if((event_log_spool_drain() != 0) || (n_timed != 2) ||
+       (test_n_messages != 2) || !strstr(test_messages[1], "at 1002")) {
+        fprintf(stderr, "FAIL: rejected: %d of 2 replayed\n", n_timed);
+        goto out;
+    }
+    log_event("FAN_SPEED", EV_KV("fan", "%d", 1), EV_KV("speed", "%d", 1001));
+    event_log_spool_stats(&spool);
+    if((spool.rejected - before.rejected != 1) || (spool.pending != 0) ||
+       (spool.spooled != before.spooled)) {
+        fprintf(stderr, "FAIL: rejected: %lu rejected, %lu pending, %lu "
+                "spooled\n", spool.rejected - before.rejected,
+                spool.pending, spool.spooled - before.spooled);
+        goto out;
+    }
+
+    /* A daemon logging nothing more replays the spool from its main
+     * loop, once the back off after journal refused events is over */
+    journal_down = TRUE;
+    for(i = 0; i < 3; i++)
+    {
+        log_event("FAN_SPEED", EV_KV("fan", "%d", 1),
+                  EV_KV("speed", "%d", 2000 + i));
+    }
+    journal_down = FALSE;
+    test_n_messages = n_timed = 0;
+    for(i = 0; (i < 100) && (n_timed < 3); i++)
+    {
+        usleep(20000);
+        event_log_run();
+    }
+    event_log_spool_stats(&spool);
+    if((expect_messages("main loop replay", 2000, 3, 3) < 0) ||
+       (spool.pending != 0)) {
+        fprintf(stderr, "FAIL: main loop replay: %lu pending\n",
+                spool.pending);
+        goto out;
+    }
+    printf("PASS: events spooled while journal was down & replayed\n");
+    ret = 0;
+
+out:
+    test_cleanup_install_path(root);
+    return ret;
+}
@@ -0,0 +1,110 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*
+ * Checks the per event counters kept by the event log library.
+ *
+ * The journal stub sink fails every fifth event.
+ *
+ * Usage: eventlog_stats_test <ops_events.yaml>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "eventlog.h"
+#include "eventlog_test_util.h"
+
+#define TEST_EVENTS 300
+
+static unsigned long journal_calls = 0;
+
+/* Refuses every 5th event */
+static int
+failing_hook(const struct iovec *iov, int n)
+{
+    if((++journal_calls % 5) == 0) {
+        return -5;
+    }
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    struct event_log_stats stats;
+    char root[64];
+    time_t start = time(NULL);
+    int i = 0;
+
+    if(argc != 2) {
+        fprintf(stderr, "usage: %s <ops_events.yaml>\n", argv[0]);
+        return 2;
+    }
+    if(test_setup_install_path(argv[1], root, sizeof(root)) < 0) {
+        perror("setup");
+        return 2;
+    }
+    test_journal_hook = failing_hook;
+    if((event_log_init("LLDP") != 1) || (event_log_init("INTERFACE") != 1)) {
+        fprintf(stderr, "FAIL: event_log_init\n");
+        test_cleanup_install_path(root);
+        return 1;
+    }
+    test_cleanup_install_path(root);
+
+    for(i = 0; i < 10; i++)
+    {
+        log_event("LLDP_ENABLED", NULL);
+    }
+    /* INTERFACE events are rate limited in ops_events.yaml */
+    for(i = 0; i < TEST_EVENTS; i++)
+    {
+        log_event("INTERFACE_UP", EV_KV("interface", "%d", i));
+    }
+    log_event("NOT_AN_EVENT", NULL);
+
+    if((event_log_stats("LLDP_ENABLED", &stats) != 0) ||
+       (stats.emitted != 8) || (stats.failed != 2) ||
+       (stats.suppressed != 0) ||
+       ((stats.last_emitted / 1000000) < (unsigned long long)start)) {
+        fprintf(stderr, "FAIL: LLDP_ENABLED %lu emitted, %lu failed, "
+                "%lu suppressed\n", stats.emitted, stats.failed,
+                stats.suppressed);
+        return 1;
+    }
+    if((event_log_stats("INTERFACE_UP", &stats) != 0) ||
+       (stats.suppressed == 0) ||
+       ((stats.emitted + stats.failed + stats.suppressed) != TEST_EVENTS)) {
+        fprintf(stderr, "FAIL: INTERFACE_UP %lu emitted, %lu failed, "
+                "%lu suppressed\n", stats.emitted, stats.failed,
+                stats.suppressed);
+        return 1;
+    }
+    if((event_log_stats("FAN_SPEED", &stats) != 0) || stats.emitted ||
+       stats.last_emitted || (event_log_stats("NOT_AN_EVENT", &stats) != -1) ||
+       (event_log_unknown_events() != 1)) {
+        fprintf(stderr, "FAIL: counters of events not logged\n");
+        return 1;
+    }
+    printf("PASS: per event counters\n");
+    return 0;
+}
@@ -15,6 +15,7 @@
 #
 
 import re
+import time
 from opstestfw import testEnviron, LogOutput
 
 
@@ -302,6 +303,204 @@ def evtlogfeature_cli(dut01):
             return False
 
 
+# Runs a show events command in vtysh, returns its output or None
+def evtlogShowEvents(dut01, command):
+    retStruct = dut01.VtyshShell(enter=True)
+    returnCode = retStruct.returnCode()
+    if returnCode != 0:
+        LogOutput('error',"Failed to enter vtysh prompt")
+        LogOutput('info',str(retStruct.buffer()))
+        return None
+    returnDevInt = dut01.DeviceInteract(command=command)
+    retStruct = dut01.VtyshShell(enter=False)
+    returnCode = retStruct.returnCode()
+    if returnCode != 0:
+        LogOutput('error',"Failed to exit vtysh prompt")
+        LogOutput('info',str(retStruct.buffer()))
+        return None
+    if returnDevInt['returnCode'] != 0:
+        LogOutput('error',
+                "Failed to run " + command +
+                " on device" + str(dut01))
+        return None
+    LogOutput('info',str(returnDevInt['buffer']))
+    return returnDevInt['buffer']
+
+# Logs one LLDP_TX_TIMER event (1003) per value, in order
+def evtlogTxTimerEvents(dut01, values):
+    retStruct = dut01.VtyshShell(enter=True)
+    if retStruct.returnCode() != 0:
+        LogOutput('error',"Failed to enter vtysh prompt")
+        return False
+    dut01.DeviceInteract(command="configure terminal")
+    for value in values:
+        dut01.DeviceInteract(command="lldp timer " + str(value))
+    dut01.DeviceInteract(command="end")
+    retStruct = dut01.VtyshShell(enter=False)
+    return retStruct.returnCode() == 0
+
+# Local time of the device, as show events prints it less microseconds
+def evtlogDeviceTime(dut01):
+    returnDevInt = dut01.DeviceInteract(command="date +%Y-%m-%d:%H:%M:%S")
+    match = re.search(r"\d{4}-\d\d-\d\d:\d\d:\d\d:\d\d",
+                      returnDevInt['buffer'])
+    if match is None:
+        LogOutput('error',"Failed to read the device time")
+        return None
+    return match.group(0)
+
+# show events lines as (time, event id, severity, message) tuples
+evtlogEntryRe = re.compile(r"^(\d{4}-\d\d-\d\d:\d\d:\d\d:\d\d\.\d+)\|"
+                           r"[^|]*\|(\d+)\|([^|]*)\|(.*?)\r?$", re.M)
+
+def evtlogEntries(buffer):
+    return evtlogEntryRe.findall(buffer)
+
+# show events since/until with absolute times, relative ones & a
+# malformed one
+def evtlogTimeRange_cli(dut01):
+    LogOutput('info', "\n############################################")
+    LogOutput('info', " Running Event Log since/until Test Script")
+    LogOutput('info', "############################################\n")
+
+    if not evtlogTxTimerEvents(dut01, [150]):
+        return False
+    time.sleep(2)
+    mark = evtlogDeviceTime(dut01)
+    if mark is None:
+        return False
+    time.sleep(1)
+    if not evtlogTxTimerEvents(dut01, [151]):
+        return False
+
+    # Absolute since, only the event logged after the mark
+    buffer = evtlogShowEvents(dut01, "show events event-id 1003 since " +
+                              mark)
+    if buffer is None:
+        return False
+    entries = evtlogEntries(buffer)
+    if (not entries or
+            [e for e in entries if e[0] < mark] or
+            "tx-timer with 151" not in entries[-1][3] or
+            [e for e in entries if "tx-timer with 150" in e[3]]):
+        LogOutput('error',"since " + mark + " failed")
+        return False
+
+    # Absolute until, only the events logged before the mark
+    buffer = evtlogShowEvents(dut01, "show events event-id 1003 until " +
+                              mark)
+    if buffer is None:
+        return False
+    entries = evtlogEntries(buffer)
+    if (not entries or
+            [e for e in entries if e[0][:19] > mark] or
+            "tx-timer with 150" not in entries[-1][3] or
+            [e for e in entries if "tx-timer with 151" in e[3]]):
+        LogOutput('error',"until " + mark + " failed")
+        return False
+
+    # Relative, both events are from the last minute, none from
+    # before the last hour
+    buffer = evtlogShowEvents(dut01, "show events event-id 1003 since 1m")
+    if buffer is None:
+        return False
+    entries = evtlogEntries(buffer)
+    if (len(entries) < 2 or
+            "tx-timer with 150" not in entries[-2][3] or
+            "tx-timer with 151" not in entries[-1][3]):
+        LogOutput('error',"since 1m failed")
+        return False
+    buffer = evtlogShowEvents(dut01,
+                              "show events event-id 1003 since 1w until 1h")
+    if buffer is None:
+        return False
+    if [e for e in evtlogEntries(buffer) if "tx-timer with 15" in e[3]]:
+        LogOutput('error',"since 1w until 1h failed")
+        return False
+
+    # Malformed times & an empty range are refused
+    for arg, error in [("since yesterday", "Invalid time"),
+                       ("since 2016-13-01", "Invalid time"),
+                       ("until 5x", "Invalid time"),
+                       ("since 1m until 1h",
+                        "since must not be later than until")]:
+        buffer = evtlogShowEvents(dut01, "show events " + arg)
+        if buffer is None or error not in buffer or evtlogEntries(buffer):
+            LogOutput('error',"show events " + arg + " not refused")
+            return False
+    LogOutput('info', "Test Case passed")
+    return True
+
+
+# show events last N with the event-id, severity & category filters,
+# oldest first & with reverse
+def evtlogLast_cli(dut01):
+    LogOutput('info', "\n############################################")
+    LogOutput('info', " Running Event Log last N Test Script")
+    LogOutput('info', "############################################\n")
+
+    if not evtlogTxTimerEvents(dut01, [201, 202, 203, 204, 205]):
+        return False
+
+    # The last 3 events matching, oldest first
+    buffer = evtlogShowEvents(dut01, "show events event-id 1003 last 3")
+    if buffer is None:
+        return False
+    entries = evtlogEntries(buffer)
+    if ([e[3][-3:] for e in entries] != ["203", "204", "205"] or
+            [e for e in entries if e[1] != "1003"]):
+        LogOutput('error',"event-id 1003 last 3 failed")
+        return False
+
+    # Newest first with reverse
+    buffer = evtlogShowEvents(dut01,
+                              "show events event-id 1003 last 3 reverse")
+    if buffer is None:
+        return False
+    entries = evtlogEntries(buffer)
+    if [e[3][-3:] for e in entries] != ["205", "204", "203"]:
+        LogOutput('error',"event-id 1003 last 3 reverse failed")
+        return False
+
+    # With the severity & category filters, N entries all matching,
+    # the LLDP ones ending with the last tx-timer event
+    for arg in ["severity info last 4", "category LLDP last 4",
+                "category LLDP severity info last 4"]:
+        buffer = evtlogShowEvents(dut01, "show events " + arg)
+        if buffer is None:
+            return False
+        entries = evtlogEntries(buffer)
+        if (len(entries) != 4 or
+                [e for e in entries if e[2] == "LOG_DEBUG"] or
+                [e[0] for e in entries] != sorted(e[0] for e in entries) or
+                ("LLDP" in arg and
+                 ([e for e in entries if not e[1].startswith("100")] or
+                  entries[-1][3][-3:] != "205"))):
+            LogOutput('error',"show events " + arg + " failed")
+            return False
+    LogOutput('info', "Test Case passed")
+    return True
+
+
+# show events follow refused with reverse or until, rather than left
+# waiting for events
+def evtlogFollow_cli(dut01):
+    LogOutput('info', "\n############################################")
+    LogOutput('info', " Running Event Log follow Test Script")
+    LogOutput('info', "############################################\n")
+
+    for arg in ["follow reverse", "reverse follow", "follow until 1h",
+                "follow since 1h until 1m", "follow last 10 reverse"]:
+        buffer = evtlogShowEvents(dut01, "show events " + arg)
+        if (buffer is None or
+                "follow can not be used with reverse or until" not in buffer
+                or evtlogEntries(buffer)):
+            LogOutput('error',"show events " + arg + " not refused")
+            return False
+    LogOutput('info', "Test Case passed")
+    return True
+
+
 class Test_ft_evtlog_feature:
     def setup_class(cls):
         # Create Topology object and connect to devices
@@ -356,3 +555,33 @@ class Test_ft_evtlog_feature:
             LogOutput('info', "Event log category filter  CLI -passed")
         else:
             LogOutput('info', "Event log category filter CLI -failed")
+
+    # Test show events since/until, absolute & relative times
+    def test_show_events_time_range(self):
+        dut01Obj = self.topoObj.deviceObjGet(device="dut01")
+        retValue = evtlogTimeRange_cli(dut01Obj)
+        if retValue:
+            LogOutput('info', "Event log since/until CLI -passed")
+        else:
+            LogOutput('error', "Event log since/until CLI -failed")
+        assert retValue
+
+    # Test show events last N, with filters & reverse
+    def test_show_events_last(self):
+        dut01Obj = self.topoObj.deviceObjGet(device="dut01")
+        retValue = evtlogLast_cli(dut01Obj)
+        if retValue:
+            LogOutput('info', "Event log last N CLI -passed")
+        else:
+            LogOutput('error', "Event log last N CLI -failed")
+        assert retValue
+
+    # Test show events follow is refused with reverse or until
+    def test_show_events_follow(self):
+        dut01Obj = self.topoObj.deviceObjGet(device="dut01")
+        retValue = evtlogFollow_cli(dut01Obj)
+        if retValue:
+            LogOutput('info', "Event log follow CLI -passed")
+        else:
+            LogOutput('error', "Event log follow CLI -failed")
+        assert retValue
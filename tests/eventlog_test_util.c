@@ -0,0 +1,168 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*
+ * Fixtures shared by the eventlog library tests, see
+ * eventlog_test_util.h. Nothing here allocates, eventlog_alloc_test
+ * counts heap allocations around it.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "eventlog.h"
+#include "event_spool.h"
+#include "eventlog_test_util.h"
+
+int (*test_journal_hook)(const struct iovec *iov, int n) = NULL;
+char test_messages[TEST_MESSAGES][TEST_MESSAGE_SIZE];
+int test_n_messages = 0;
+__thread char test_last_message[TEST_MESSAGE_SIZE];
+
+/* Directories laid out under the scratch install path, parents first */
+static const char *test_dirs[] = {
+    "/etc", "/etc/openswitch", "/etc/openswitch/supportability",
+    "/var", "/var/diagnostics", EVENT_SPOOL_DIR,
+};
+#define TEST_ETC_DIRS 3
+
+int
+sd_journal_sendv(const struct iovec *iov, int n)
+{
+    size_t len = iov[0].iov_len;
+    int ret = 0, index = 0;
+    if((test_journal_hook != NULL) &&
+       ((ret = test_journal_hook(iov, n)) != 0)) {
+        return ret;
+    }
+    if(len >= TEST_MESSAGE_SIZE) {
+        len = TEST_MESSAGE_SIZE - 1;
+    }
+    memcpy(test_last_message, iov[0].iov_base, len);
+    test_last_message[len] = '\0';
+    index = __atomic_fetch_add(&test_n_messages, 1, __ATOMIC_RELAXED);
+    if((index >= 0) && (index < TEST_MESSAGES)) {
+        memcpy(test_messages[index], test_last_message, len + 1);
+    }
+    return 0;
+}
+
+/* test_setup_install_path
+ * Lays out a scratch OPENSWITCH_INSTALL_PATH in root, with the yaml
+ * file linked to yaml unless it is NULL, for the test to write it with
+ * test_write_yaml().
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int
+test_setup_install_path(const char *yaml, char *root, size_t size)
+{
+    char path[512];
+    unsigned int i = 0;
+    snprintf(root, size, "/tmp/eventlog_test.XXXXXX");
+    if(mkdtemp(root) == NULL) {
+        return -1;
+    }
+    for(i = 0; i < TEST_ETC_DIRS; i++)
+    {
+        snprintf(path, sizeof(path), "%s%s", root, test_dirs[i]);
+        mkdir(path, 0755);
+    }
+    if(yaml != NULL) {
+        test_yaml_path(root, path, sizeof(path));
+        if(symlink(yaml, path) < 0) {
+            return -1;
+        }
+    }
+    return setenv("OPENSWITCH_INSTALL_PATH", root, 1);
+}
+
+/* test_setup_spool_dir
+ * Makes the spool directory under the scratch install path, events are
+ * not spooled without it.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int
+test_setup_spool_dir(const char *root)
+{
+    char path[512];
+    unsigned int i = 0;
+    for(i = TEST_ETC_DIRS; i < sizeof(test_dirs)/sizeof(test_dirs[0]); i++)
+    {
+        snprintf(path, sizeof(path), "%s%s", root, test_dirs[i]);
+        if((mkdir(path, 0755) < 0) && (errno != EEXIST)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* test_yaml_path
+ * Fills in the path of the yaml file under the scratch install path.
+ */
+void
+test_yaml_path(const char *root, char *path, size_t size)
+{
+    snprintf(path, size, "%s%s", root, EVENT_YAML_FILE);
+}
+
+/* test_write_yaml
+ * Writes the yaml file under the scratch install path.
+ *
+ * Returns 0 on success, -1 on failure.
+ */
+int
+test_write_yaml(const char *root, const char *yaml)
+{
+    char path[512];
+    FILE *fp = NULL;
+    test_yaml_path(root, path, sizeof(path));
+    unlink(path);
+    fp = fopen(path, "w");
+    if(fp == NULL) {
+        return -1;
+    }
+    fputs(yaml, fp);
+    return (fclose(fp) == 0) ? 0 : -1;
+}
+
+/* test_cleanup_install_path
+ * Removes what test_setup_install_path() & test_setup_spool_dir()
+ * created, the yaml file & the spool file of the test if any.
+ */
+void
+test_cleanup_install_path(const char *root)
+{
+    char path[512];
+    int i = 0;
+    test_yaml_path(root, path, sizeof(path));
+    unlink(path);
+    snprintf(path, sizeof(path), "%s%s/%s%s", root, EVENT_SPOOL_DIR,
+             program_invocation_short_name, EVENT_SPOOL_SUFFIX);
+    unlink(path);
+    for(i = (int)(sizeof(test_dirs)/sizeof(test_dirs[0])) - 1; i >= 0; i--)
+    {
+        snprintf(path, sizeof(path), "%s%s", root, test_dirs[i]);
+        rmdir(path);
+    }
+    rmdir(root);
+}
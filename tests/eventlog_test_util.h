@@ -0,0 +1,57 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*
+ * Fixtures shared by the eventlog library tests, linked in to each of
+ * them.
+ *
+ * sd_journal_sendv() is replaced with a stub sink so that the tests do
+ * not depend on journald. It keeps the MESSAGE field of the events sent
+ * & hands every event to test_journal_hook first, when set, which may
+ * refuse it by returning a negative errno.
+ *
+ * The library is pointed at a scratch OPENSWITCH_INSTALL_PATH holding
+ * the yaml file of the test, & the spool directory for tests spooling
+ * events.
+ */
+
+#ifndef __EVENTLOG_TEST_UTIL_H_
+#define __EVENTLOG_TEST_UTIL_H_
+
+#include <stddef.h>
+#include <sys/uio.h>
+#include "eventlog.h"
+
+#define TEST_MESSAGE_SIZE 2048
+#define TEST_MESSAGES 256
+
+/* Called for every event sent, returns 0 to take it or negative errno */
+extern int (*test_journal_hook)(const struct iovec *iov, int n);
+/* The first TEST_MESSAGES messages taken, test_n_messages counts all */
+extern char test_messages[TEST_MESSAGES][TEST_MESSAGE_SIZE];
+extern int test_n_messages;
+/* The last message taken on the calling thread */
+extern __thread char test_last_message[TEST_MESSAGE_SIZE];
+
+extern int test_setup_install_path(const char *yaml, char *root,
+                                   size_t size);
+extern void test_yaml_path(const char *root, char *path, size_t size);
+extern int test_write_yaml(const char *root, const char *yaml);
+extern int test_setup_spool_dir(const char *root);
+extern void test_cleanup_install_path(const char *root);
+
+#endif /* __EVENTLOG_TEST_UTIL_H_ */
@@ -0,0 +1,146 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*
+ * Stress test for log_event() called from several threads at once.
+ *
+ * Every thread logs events with values of its own and checks that the
+ * message it gets to the journal carries exactly those values, while
+ * other threads keep calling event_log_init(), from the last message
+ * the journal stub sink kept for the thread.
+ *
+ * Usage: eventlog_thread_test <ops_events.yaml>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "eventlog.h"
+#include "eventlog_test_util.h"
+
+#define TEST_THREADS 8
+#define TEST_EVENTS 20000
+
+static unsigned long failures = 0;
+
+static void
+check_message(const char *expected)
+{
+    if(strcmp(test_last_message, expected)) {
+        if(__atomic_add_fetch(&failures, 1, __ATOMIC_RELAXED) == 1) {
+            fprintf(stderr, "FAIL: expected '%s', got '%s'\n",
+                    expected, test_last_message);
+        }
+    }
+}
+
+static void *
+logger_thread(void *arg)
+{
+    long id = (long)arg;
+    char subsystem[16];
+    char expected[MAX_LOG_STR + MAX_EVENT_NAME_SIZE];
+    int i = 0;
+
+    snprintf(subsystem, sizeof(subsystem), "thread%ld", id);
+    for(i = 0; i < TEST_EVENTS; i++)
+    {
+        log_event("FAN_SPEED", EV_KV("subsystem", "%s", subsystem),
+                  EV_KV("speedval", "%ld", id), EV_KV("value", "%d", i));
+        snprintf(expected, sizeof(expected),
+                 "MESSAGE=ops-evt|2002|LOG_INFO|subsystem %s setting fan "
+                 "speed control register to %ld: %d", subsystem, id, i);
+        check_message(expected);
+
+        log_event("LLDP_TX_TIMER", EV_KV("value", "%d", i));
+        snprintf(expected, sizeof(expected),
+                 "MESSAGE=ops-evt|1003|LOG_INFO|Configured LLDP tx-timer "
+                 "with %d", i);
+        check_message(expected);
+    }
+    return NULL;
+}
+
+static void *
+init_thread(void *arg)
+{
+    int i = 0;
+    for(i = 0; i < 1000; i++)
+    {
+        event_log_init("FAN");
+        event_log_init("LLDP");
+    }
+    return NULL;
+}
+
+int
+main(int argc, char *argv[])
+{
+    pthread_t loggers[TEST_THREADS];
+    pthread_t initer;
+    char root[64];
+    long i = 0;
+
+    if(argc != 2) {
+        fprintf(stderr, "usage: %s <ops_events.yaml>\n", argv[0]);
+        return 2;
+    }
+    if(test_setup_install_path(argv[1], root, sizeof(root)) < 0) {
+        perror("setup");
+        return 2;
+    }
+    if((event_log_init("FAN") != 1) || (event_log_init("LLDP") != 1)) {
+        fprintf(stderr, "FAIL: event_log_init\n");
+        test_cleanup_install_path(root);
+        return 1;
+    }
+    if(pthread_create(&initer, NULL, init_thread, NULL)) {
+        perror("pthread_create");
+        test_cleanup_install_path(root);
+        return 2;
+    }
+    for(i = 0; i < TEST_THREADS; i++)
+    {
+        if(pthread_create(&loggers[i], NULL, logger_thread, (void*)i)) {
+            perror("pthread_create");
+            test_cleanup_install_path(root);
+            return 2;
+        }
+    }
+    for(i = 0; i < TEST_THREADS; i++)
+    {
+        pthread_join(loggers[i], NULL);
+    }
+    pthread_join(initer, NULL);
+    test_cleanup_install_path(root);
+
+    if(failures != 0) {
+        fprintf(stderr, "FAIL: %lu corrupted messages\n", failures);
+        return 1;
+    }
+    if(test_n_messages != (2*TEST_THREADS*TEST_EVENTS)) {
+        fprintf(stderr, "FAIL: %d events reached journal\n", test_n_messages);
+        return 1;
+    }
+    printf("PASS: %d threads logged %d events each\n",
+           TEST_THREADS, 2*TEST_EVENTS);
+    return 0;
+}
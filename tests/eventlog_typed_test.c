@@ -0,0 +1,89 @@
+/*
+ Copyright (C) 2016 Hewlett-Packard Development Company, L.P.
+ All Rights Reserved.
+
+    Licensed under the Apache License, Version 2.0 (the "License"); you may
+    not use this file except in compliance with the License. You may obtain
+    a copy of the License at
+
+         http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+    License for the specific language governing permissions and limitations
+    under the License.
+*/
+
+/*
+ * Checks the typed event logging API generated in ops_events.h against
+ * log_event(), including the fallback when the catalog the header was
+ * generated from doesn't match the one loaded.
+ *
+ * Usage: eventlog_typed_test <ops_events.yaml>
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "ops_events.h"
+#include "eventlog_test_util.h"
+
+int
+main(int argc, char *argv[])
+{
+    char root[64];
+    char expected[sizeof(test_last_message)];
+    const char *fan_speed = "MESSAGE=ops-evt|2002|LOG_INFO|subsystem base "
+                            "setting fan speed control register to 3: 255";
+
+    if(argc != 2) {
+        fprintf(stderr, "usage: %s <ops_events.yaml>\n", argv[0]);
+        return 2;
+    }
+    if(test_setup_install_path(argv[1], root, sizeof(root)) < 0) {
+        perror("setup");
+        return 2;
+    }
+    if(event_log_init("FAN") != 1) {
+        fprintf(stderr, "FAIL: event_log_init\n");
+        test_cleanup_install_path(root);
+        return 1;
+    }
+    test_cleanup_install_path(root);
+
+    if((log_event_FAN_SPEED("base", "3", "255") < 0) ||
+       strcmp(test_last_message, fan_speed)) {
+        fprintf(stderr, "FAIL: typed event sent '%s'\n", test_last_message);
+        return 1;
+    }
+    log_event("FAN_SPEED", EV_KV("subsystem", "%s", "base"),
+              EV_KV("speedval", "%d", 3), EV_KV("value", "%d", 255));
+    strcpy(expected, test_last_message);
+    /* A stale index, or one of another event, falls back to the name */
+    if((log_event_index(OPS_EV_MAX, 2002, "FAN_SPEED",
+                        EV_KV("subsystem", "%s", "base"),
+                        EV_KV("speedval", "%s", "3"),
+                        EV_KV("value", "%s", "255"), NULL) < 0) ||
+       strcmp(test_last_message, expected) ||
+       (log_event_index(OPS_EV_FAN_COUNT, 2002, "FAN_SPEED",
+                        EV_KV("subsystem", "%s", "base"),
+                        EV_KV("speedval", "%s", "3"),
+                        EV_KV("value", "%s", "255"), NULL) < 0) ||
+       strcmp(test_last_message, expected)) {
+        fprintf(stderr, "FAIL: index fallback sent '%s'\n", test_last_message);
+        return 1;
+    }
+    /* LLDP isn't registered by this daemon, same as for log_event() */
+    if((log_event_LLDP_TX_TIMER("30") != -1) ||
+       strcmp(test_last_message, "MESSAGE=ops-evt|Unknown Event Name "
+                            "LLDP_TX_TIMER")) {
+        fprintf(stderr, "FAIL: event of an unregistered category logged\n");
+        return 1;
+    }
+    printf("PASS: typed events match log_event()\n");
+    return 0;
+}
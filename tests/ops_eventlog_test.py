@@ -0,0 +1,112 @@
+#!/usr/bin/env python
+# (c) Copyright [2016] Hewlett Packard Enterprise Development LP
+# All Rights Reserved.
+#
+#    Licensed under the Apache License, Version 2.0 (the "License"); you may
+#    not use this file except in compliance with the License. You may obtain
+#    a copy of the License at
+#
+#         http://www.apache.org/licenses/LICENSE-2.0
+#
+#    Unless required by applicable law or agreed to in writing, software
+#    distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+#    WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+#    License for the specific language governing permissions and limitations
+#    under the License.
+
+# Checks that ops_eventlog logs an event with the same message & journal
+# fields through libsupportability as it does without it, & that an
+# event with a key the library can't take is logged without it.
+#
+# The library is run with journal stubbed out by the shared build of
+# eventlog_test_util.c, loaded before ops_eventlog loads the library so
+# that its sd_journal_sendv() is the one the library calls.
+#
+# Usage: ops_eventlog_test.py <eventlog_test_util library> <yaml file>
+
+import ctypes
+import os
+import sys
+
+util = ctypes.CDLL(sys.argv[1], ctypes.RTLD_GLOBAL)
+yaml_file = os.path.abspath(sys.argv[2])
+root = ctypes.create_string_buffer(64)
+if util.test_setup_install_path(yaml_file.encode('utf-8'), root,
+                                ctypes.sizeof(root)) < 0:
+    print("FAIL: setup")
+    sys.exit(2)
+
+import ops_eventlog
+
+
+class iovec(ctypes.Structure):
+    _fields_ = [('iov_base', ctypes.c_void_p), ('iov_len', ctypes.c_size_t)]
+
+JOURNAL_HOOK = ctypes.CFUNCTYPE(ctypes.c_int, ctypes.POINTER(iovec),
+                                ctypes.c_int)
+
+# Journal fields of the events sent by the library & by ops_eventlog
+c_sent = []
+py_sent = []
+
+
+def c_journal_hook(iov, n):
+    fields = {}
+    for i in range(n):
+        data = ctypes.string_at(iov[i].iov_base, iov[i].iov_len)
+        name, value = data.decode('utf-8').split('=', 1)
+        fields[name] = value
+    c_sent.append(fields)
+    return 0
+
+
+class py_journal(object):
+    @staticmethod
+    def send(mesg, **fields):
+        fields['MESSAGE'] = mesg
+        py_sent.append(dict((k, str(v)) for k, v in fields.items()))
+
+hook = JOURNAL_HOOK(c_journal_hook)
+ctypes.c_void_p.in_dll(util, 'test_journal_hook').value = \
+    ctypes.cast(hook, ctypes.c_void_p).value
+ops_eventlog.journal = py_journal
+ops_eventlog.EV_YAML_FILE = yaml_file
+
+
+def fail(msg):
+    print("FAIL: " + msg)
+    print("  library: %s" % (c_sent,))
+    print("  python:  %s" % (py_sent,))
+    util.test_cleanup_install_path(root)
+    sys.exit(1)
+
+if ops_eventlog.libsupportability is None:
+    fail("libsupportability not loaded")
+if ops_eventlog.event_log_init('SUPPORTABILITY') is not None:
+    fail("event_log_init")
+
+# The same event through the library & without it, with all its keys &
+# with one of them left out
+for keys in [(('process', 'ops-sysd'), ('signal', 11),
+              ('timestamp', '2016-01-01 10:00:00')),
+             (('process', 'ops-lldpd'), ('timestamp', '2016-01-01'))]:
+    del c_sent[:], py_sent[:]
+    if ops_eventlog.log_event('SUPPORTABILITY_DAEMON_CRASH', *keys) is not None:
+        fail("log_event through the library")
+    ops_eventlog.py_log_event('SUPPORTABILITY_DAEMON_CRASH', *keys)
+    if (len(c_sent) != 1) or (c_sent != py_sent):
+        fail("fields differ with keys %s" % (keys,))
+
+# A key too long for key_value_string(), logged without the library
+del c_sent[:], py_sent[:]
+ops_eventlog.log_event('SUPPORTABILITY_DAEMON_CRASH', ('process', 'ops-sysd'),
+                       ('signal', 11), ('k' * 200, 'v'))
+if (c_sent or (len(py_sent) != 1) or
+        (py_sent[0]['MESSAGE'] !=
+         'ops-evt|14001|LOG_CRIT|ops-sysd crashed due to 11,{timestamp}') or
+        (py_sent[0]['OPS_EVT_KEY_SIGNAL'] != '11') or
+        (py_sent[0]['OPS_EVT_KEY_' + 'K' * 200] != 'v')):
+    fail("key the library can't take")
+
+util.test_cleanup_install_path(root)
+print("PASS: events logged alike with & without the library")